@@ -0,0 +1,170 @@
+// Embedding API of the interpreter : compile a script once, run it in any
+// number of contexts. Only what is declared here is exported from the
+// shared library, everything else is built with hidden visibility.
+//
+//   interp::Program program = interp::Compile( "x = x * 2;", { "x" } );
+//   interp::Context ctx;
+//   ctx.Set( "x", 5 );
+//   interp::Value result = program.Run( ctx ); // result.AsInt() == 10
+//
+// A context initialized by a prelude can be frozen once and every request
+// started from the snapshot, which costs a pointer copy. Scripts compiled
+// against the snapshot use the names of the prelude without listing them :
+//
+//   interp::Snapshot ready = prelude.Freeze();
+//   interp::Program handler = interp::Compile( "reply = base * 2;", ready, { "reply" } );
+//   interp::Context request( ready );
+//   handler.Run( request );
+//
+// An expression can be evaluated over many rows at once, the column names
+// are globals of the program :
+//
+//   interp::Columns rows;
+//   rows.AddFloat( "price", prices );
+//   rows.AddInt( "qty", quantities );
+//   interp::Program score = interp::Compile( "price * qty;", { "price", "qty" } );
+//   std::vector< interp::Value > scores = score.Evaluate( ctx, rows );
+# ifndef INTERPRETER_HPP
+# define INTERPRETER_HPP
+
+# include <memory>
+# include <string>
+# include <vector>
+
+# define INTERP_API __attribute__ ( ( visibility( "default" ) ) )
+
+namespace interp {
+
+// A script value copied into or out of the interpreter
+class INTERP_API Value {
+public:
+  enum Kind {
+    NONE,
+    INT,
+    FLOAT,
+    BOOL,
+    CHAR,
+    STRING
+  };
+
+  Value( ) ;
+  Value( int value ) ;
+  Value( double value ) ;
+  Value( bool value ) ;
+  Value( const char *value ) ;
+  Value( const std::string &value ) ;
+  static Value Char( char value ) ;
+
+  Kind GetKind( ) const {
+    return mKind;
+  } // GetKind()
+
+  int AsInt( ) const ;
+  double AsFloat( ) const ;
+  bool AsBool( ) const ;
+  std::string AsString( ) const ;
+
+private:
+  Kind mKind;
+  int mInt; // INT, BOOL and CHAR
+  double mFloat;
+  std::string mString;
+};
+
+struct ContextState;
+struct ProgramState;
+struct SnapshotState;
+struct ColumnsState;
+class Program;
+class Context;
+
+// The globals of a context at the time it was frozen. Contexts made
+// from it share them until they assign, it can be used from any thread.
+class INTERP_API Snapshot {
+public:
+  Snapshot( ) ;
+
+private:
+  std::shared_ptr< SnapshotState > mState;
+  friend class Context;
+  friend Program Compile( const std::string &source, const Snapshot &snapshot,
+                          const std::vector< std::string > &globals ) ;
+};
+
+// The globals and the printed output of the runs made in it. A context
+// is used by one thread at a time. It owns the values and call frames of
+// its runs, each run frees those its globals and the snapshots still
+// alive no longer reach.
+class INTERP_API Context {
+public:
+  Context( ) ;
+  explicit Context( const Snapshot &snapshot ) ;
+  ~Context( ) ;
+  Context( const Context & ) = delete;
+  Context &operator=( const Context & ) = delete;
+
+  void Set( const std::string &name, const Value &value ) ;
+  Value Get( const std::string &name ) const ; // NONE if unset
+  std::string Output( ) const ;
+  void ClearOutput( ) ;
+  Snapshot Freeze( ) const ;
+
+private:
+  std::shared_ptr< ContextState > mState;
+  friend class Program;
+};
+
+// Named int and float columns of the same length. Copies share the rows.
+class INTERP_API Columns {
+public:
+  Columns( ) ;
+
+  // false if the name is taken or the length differs from the columns
+  // added before
+  bool AddInt( const std::string &name, const std::vector< int > &rows ) ;
+  bool AddFloat( const std::string &name, const std::vector< float > &rows ) ;
+  size_t Rows( ) const ;
+
+private:
+  std::shared_ptr< ColumnsState > mState;
+  friend class Program;
+};
+
+// A compiled script. Copies share it, and it can run in several contexts
+// on several threads at once.
+class INTERP_API Program {
+public:
+  Program( ) ;
+
+  bool Ok( ) const ;
+  std::vector< std::string > Errors( ) const ;
+  // The value of the last statement, NONE if a statement failed
+  Value Run( Context &ctx ) const ;
+  // The value of the last statement for every row of columns, the
+  // statements before it run once in ctx. NONE for the rows without a
+  // number, their messages go to the output of ctx.
+  std::vector< Value > Evaluate( Context &ctx, const Columns &columns ) const ;
+
+private:
+  std::shared_ptr< ProgramState > mState;
+  friend Program Compile( const std::string &source,
+                          const std::vector< std::string > &globals ) ;
+  friend Program Compile( const std::string &source, const Snapshot &snapshot,
+                          const std::vector< std::string > &globals ) ;
+};
+
+// globals are the names the host will Set before running the program,
+// the script may use them without declaring them
+INTERP_API Program Compile( const std::string &source,
+                            const std::vector< std::string > &globals =
+                              std::vector< std::string >() ) ;
+
+// For the contexts made from snapshot : the names of its globals may be
+// used as well as those of globals
+INTERP_API Program Compile( const std::string &source, const Snapshot &snapshot,
+                            const std::vector< std::string > &globals =
+                              std::vector< std::string >() ) ;
+
+} // namespace interp
+
+# endif
@@ -1,17 +1,72 @@
+# include <algorithm>
+# include <atomic>
 # include <cctype>
+# include <chrono>
+# include <climits>
 # include <cmath>
+# include <cerrno>
+# include <condition_variable>
+# include <cstdio>
 # include <cstring>
+# include <deque>
 # include <ctype.h>
+# include <fcntl.h>
 # include <iostream>
+# include <fstream>
+# include <list>
 # include <map>
+# include <memory>
+# include <mutex>
+# include <set>
+# include <new>
+# include <signal.h>
 # include <sstream>
 # include <stdlib.h>
 # include <string>
+# include <thread>
 # include <vector>
 # include <iomanip> 
+# include <limits>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/time.h>
+# include <sys/uio.h>
+# include <unistd.h>
+
+# include "interpreter.hpp"
+# include "json.hpp"
 
 using namespace std;
 
+typedef nlohmann::ordered_json Json; // Keeps fields in the order nodes write them
+
+// The operator new / delete pairs defined here stay out of line : GCC
+// checks the pair it sees after inlining, and one side inlined into what
+// it wraps reads as a mismatched new and delete
+# define ALLOC_FN __attribute__(( noinline ))
+
+# ifdef COUNT_ALLOCS
+// Every allocation of the process, for the allocs/op figure of --bench
+size_t gAllocs = 0;
+
+ALLOC_FN void *operator new( size_t size ) {
+  ++gAllocs;
+  void *mem = malloc( size == 0 ? 1 : size );
+  if ( mem == NULL )
+    throw bad_alloc();
+  return mem;
+} // operator new()
+
+ALLOC_FN void operator delete( void *mem ) noexcept {
+  free( mem );
+} // operator delete()
+# endif
+
+// Everything but the embedding API is internal, out of the way of the
+// names of the programs the libraries are linked into
+namespace interp {
+namespace detail {
+
 typedef enum {
   ILLEGAL,
   EOFF,
@@ -71,24 +126,366 @@ typedef enum {
   KEY_RETURN,
   KEY_DO,
   KEY_WHILE,
-  KEY_CHAR
+  KEY_CHAR,
+  TOKEN_TYPE_COUNT
 } TokenType
 ;
 
+typedef enum {
+  INT_KIND,
+  FLOAT_KIND,
+  STRING_KIND,
+  CHAR_KIND,
+  BOOL_KIND,
+  NULL_KIND,
+  FUNCTION_KIND,
+  RETURN_KIND,
+  BUILTIN_KIND,
+  KIND_COUNT
+} ObjKind
+;
+
+class AstPool;
+class Node;
+
 struct Token {
   TokenType type;
   string value;
+  int line; // 1-based, 0 when unknown
+  int column;
+  size_t integer; // Value of an INT literal
+  float real; // Value of a FLOAT literal
+
+  Token( ) {
+    type = ILLEGAL;
+    line = 0;
+    column = 0;
+    integer = 0;
+    real = 0;
+  } // Token()
+
+  static void *operator new( size_t size ) ;
+  static void operator delete( void *mem ) ;
+};
+
+class AstPool;
+
+// Told when a pool it holds grows, see FunctionDeclaration::Body()
+class PoolOwner {
+public:
+  virtual ~PoolOwner( ) { } // ~PoolOwner()
+  virtual void Grew( AstPool *pool, size_t bytes ) = 0;
+};
+
+// Owns the nodes and tokens built while it is the current pool, so a
+// compiled program can be dropped as a whole
+class AstPool {
+  vector< Node * > mNodes;
+  vector< Token * > mTokens;
+  size_t mBytes;
+  size_t mChargedNodes; // Nodes and tokens whose heap is in mBytes
+  size_t mChargedTokens;
+  PoolOwner *mOwner;
+
+public:
+  AstPool( ) {
+    mBytes = 0;
+    mChargedNodes = 0;
+    mChargedTokens = 0;
+    mOwner = NULL;
+  } // AstPool()
+
+  ~AstPool( ) ;
+
+  void AdoptNode( Node *node, size_t size ) ;
+  void AdoptToken( Token *tok, size_t size ) ;
+  size_t Bytes( ) ;
+
+  void SetOwner( PoolOwner *owner ) {
+    mOwner = owner;
+  } // SetOwner()
+
+  PoolOwner *Owner( ) {
+    return mOwner;
+  } // Owner()
+};
+
+thread_local AstPool *gAstPool = NULL; // NULL : allocations are not tracked
+
+ALLOC_FN void *Token::operator new( size_t size ) {
+  void *mem = ::operator new( size );
+  if ( gAstPool != NULL )
+    gAstPool -> AdoptToken( ( Token * ) mem, size );
+  return mem;
+} // Token::operator new()
+
+ALLOC_FN void Token::operator delete( void *mem ) {
+  ::operator delete( mem );
+} // Token::operator delete()
+
+void AstPool::AdoptToken( Token *tok, size_t size ) {
+  mTokens.push_back( tok );
+  mBytes += size + sizeof( Token * );
+} // AstPool::AdoptToken()
+
+void AstPool::AdoptNode( Node *node, size_t size ) {
+  mNodes.push_back( node );
+  mBytes += size + sizeof( Node * );
+} // AstPool::AdoptNode()
+
+// Heap bytes of the characters of str, 0 while they fit in the string
+size_t GHeapBytes( const string &str ) {
+  return str.capacity() > string().capacity() ? str.capacity() + 1 : 0;
+} // GHeapBytes()
+
+template < class T >
+size_t GHeapBytes( const vector< T > &items ) {
+  return items.capacity() * sizeof( T );
+} // GHeapBytes()
+
+// ---------------------------- Runtime statistics -------------------
+// Counters on the hot paths of the lexer, parser and evaluator. They are
+// compiled in unless ENABLE_STATS is 0 and only count while
+// gStatsEnabled is set ( --no-stats clears it ). Each thread counts in
+// its own gStats. The stats() builtin prints them, --stats prints them
+// to stderr at exit.
+# ifndef ENABLE_STATS
+# define ENABLE_STATS 1
+# endif
+
+# if ENABLE_STATS
+# define STAT( expr ) do { if ( gStatsEnabled ) { expr; } } while ( 0 )
+# else
+# define STAT( expr ) do { } while ( 0 )
+# endif
+
+const char *const kObjKindNames[] = {
+  "Integer", "Float", "String", "Char", "Boolean", "Null", "Function", 
+  "Return", "Builtin"
+};
+
+static_assert( sizeof( kObjKindNames ) / sizeof( kObjKindNames[ 0 ] ) == KIND_COUNT,
+               "kObjKindNames must name every ObjKind" );
+
+struct RuntimeStats {
+  size_t tokens; // Tokens lexed
+  size_t nodes; // AST nodes built, parsed or loaded
+  size_t lookups; // Environment::Get calls
+  size_t hops; // Outer environments walked by those calls
+  size_t objects[ KIND_COUNT ]; // Obj allocated per kind
+  size_t calls; // Function calls
+  size_t callMisses; // Calls that looked their callee up, see CallCache
+  int depth; // Calls in progress
+  int maxDepth;
+
+  RuntimeStats( ) {
+    tokens = nodes = lookups = hops = calls = callMisses = 0;
+    for ( int i = 0; i < KIND_COUNT; ++i )
+      objects[ i ] = 0;
+    depth = maxDepth = 0;
+  } // RuntimeStats()
+
+  void Add( const RuntimeStats &other ) ;
+  void Print( ostream &out ) ;
+};
+
+bool gStatsEnabled = true; // Only changed before any thread starts
+thread_local RuntimeStats gStats;
+
+void RuntimeStats::Add( const RuntimeStats &other ) {
+  tokens += other.tokens;
+  nodes += other.nodes;
+  lookups += other.lookups;
+  hops += other.hops;
+  for ( int i = 0; i < KIND_COUNT; ++i )
+    objects[ i ] += other.objects[ i ];
+  calls += other.calls;
+  callMisses += other.callMisses;
+  maxDepth = max( maxDepth, other.maxDepth );
+} // RuntimeStats::Add()
+
+void RuntimeStats::Print( ostream &out ) {
+  out << "tokens lexed     " << tokens << "\n";
+  out << "nodes built      " << nodes << "\n";
+  out << "env lookups      " << lookups << "\n";
+  out << "env hops         " << hops << "\n";
+  out << "calls            " << calls << "\n";
+  out << "call cache misses " << callMisses << "\n";
+  out << "max call depth   " << maxDepth << "\n";
+  for ( int i = 0; i < KIND_COUNT; ++i ) {
+    if ( objects[ i ] > 0 )
+      out << "objects " << left << setw( 9 ) << kObjKindNames[ i ] << right 
+          << objects[ i ] << "\n";
+  } // for
+} // RuntimeStats::Print()
+
+// ---------------------------- Output -------------------
+// Program output on stdout collects in a large buffer and goes out with
+// write(2) / writev(2) once it passes the threshold, before input is
+// read, at exit and when the process dies of a signal. endl only ends
+// the line : sync() does not reach the file.
+class OutputSink : public streambuf {
+  int mFd;
+  vector< char > mBuf;
+
+  bool WriteAll( struct iovec *parts, int count ) ;
+
+public:
+  OutputSink( int fd, size_t threshold ) {
+    mFd = fd;
+    SetThreshold( threshold );
+  } // OutputSink()
+
+  ~OutputSink( ) {
+    Flush();
+  } // ~OutputSink()
+
+  void SetThreshold( size_t threshold ) ;
+  bool Flush( ) ;
+
+protected:
+  int overflow( int ch ) ;
+  streamsize xsputn( const char *str, streamsize count ) ;
+
+  int sync( ) {
+    return 0;
+  } // sync()
+};
+
+const size_t kOutputThreshold = 64 * 1024; // Default, --output-buffer
+
+// Write every byte of parts, only calls async-signal-safe functions
+bool OutputSink::WriteAll( struct iovec *parts, int count ) {
+  while ( count > 0 ) {
+    ssize_t done = writev( mFd, parts, count );
+    if ( done < 0 && errno == EINTR )
+      continue;
+    if ( done < 0 )
+      return false;
+
+    while ( count > 0 && ( size_t ) done >= parts -> iov_len ) {
+      done -= parts -> iov_len;
+      ++parts;
+      --count;
+    } // while
+
+    if ( count > 0 ) {
+      parts -> iov_base = ( char * ) parts -> iov_base + done;
+      parts -> iov_len -= done;
+    } // if
+  } // while
+
+  return true;
+} // OutputSink::WriteAll()
+
+void OutputSink::SetThreshold( size_t threshold ) {
+  Flush();
+  mBuf.resize( max( threshold, ( size_t ) 1 ) );
+  setp( &mBuf[ 0 ], &mBuf[ 0 ] + mBuf.size() );
+} // OutputSink::SetThreshold()
+
+bool OutputSink::Flush( ) {
+  if ( pptr() == pbase() )
+    return true;
+
+  struct iovec part;
+  part.iov_base = pbase();
+  part.iov_len = pptr() - pbase();
+  setp( &mBuf[ 0 ], &mBuf[ 0 ] + mBuf.size() );
+  return WriteAll( &part, 1 );
+} // OutputSink::Flush()
+
+int OutputSink::overflow( int ch ) {
+  if ( ! Flush() )
+    return EOF;
+  if ( ch != EOF ) {
+    *pptr() = ch;
+    pbump( 1 );
+  } // if
+
+  return ch == EOF ? 0 : ch;
+} // OutputSink::overflow()
+
+// What does not fit goes out with the buffer in one writev
+streamsize OutputSink::xsputn( const char *str, streamsize count ) {
+  if ( count <= epptr() - pptr() ) {
+    memcpy( pptr(), str, count );
+    pbump( count );
+    return count;
+  } // if
+
+  struct iovec parts[ 2 ];
+  parts[ 0 ].iov_base = pbase();
+  parts[ 0 ].iov_len = pptr() - pbase();
+  parts[ 1 ].iov_base = ( void * ) str;
+  parts[ 1 ].iov_len = count;
+  setp( &mBuf[ 0 ], &mBuf[ 0 ] + mBuf.size() );
+  return WriteAll( parts, 2 ) ? count : 0;
+} // OutputSink::xsputn()
+
+OutputSink gStdoutSink( STDOUT_FILENO, kOutputThreshold );
+ostream gStdout( &gStdoutSink );
+
+// Where programs write, an Interpreter points it at its own buffer
+thread_local ostream *gOut = &gStdout;
+
+void GFlushOutput( ) {
+  gStdoutSink.Flush();
+} // GFlushOutput()
+
+// cerr is tied to it : what the program printed goes out before an error
+// that follows it, as it did when every endl flushed
+class StdoutFlusher : public streambuf {
+protected:
+  int sync( ) {
+    return gStdoutSink.Flush() ? 0 : -1;
+  } // sync()
 };
 
-string GetLine() {
+StdoutFlusher gStdoutFlusher;
+ostream gStdoutTie( &gStdoutFlusher );
+
+// A script that crashes still shows what it printed before
+void GFlushAndDie( int sig ) {
+  gStdoutSink.Flush();
+  signal( sig, SIG_DFL );
+  raise( sig );
+} // GFlushAndDie()
+
+void GFlushOnFatalSignals( ) {
+  signal( SIGFPE, GFlushAndDie );
+  signal( SIGSEGV, GFlushAndDie );
+  signal( SIGABRT, GFlushAndDie );
+} // GFlushOnFatalSignals()
+
+string GetLine( istream &in ) {
   string line;
   char ch; 
-  while ( cin.get( ch ) && ch != '\n' )
+  while ( in.get( ch ) && ch != '\n' )
     line += ch; 
 
   return line;
 } // GetLine()
 
+// A float as it reads back from its Value() : six significant digits.
+// Operators always read float operands this way, every evaluator has to
+// round them here so they print the same.
+float GReadBack( float value ) {
+  if ( ! isfinite( value ) || ( fabs( value ) < 1e6 && value == truncf( value ) ) )
+    return value;
+
+  char buf[ 32 ];
+  snprintf( buf, sizeof( buf ), "%.5e", value );
+  return strtof( buf, NULL );
+} // GReadBack()
+
+int GStringToInt( string str ) {
+  int result;
+  stringstream ss( str ) ;
+  ss >> result;
+  return result;
+} // GStringToInt()
+
 float GStringToFloat( string str ) {
   float result;
   stringstream ss( str ) ;
@@ -96,78 +493,399 @@ float GStringToFloat( string str ) {
   return result;
 } // GStringToFloat()
 
-int GStringToInt( string str ) {
-  int result;
-  stringstream ss( str ) ;
-  ss >> result;
+// --------------------------------------- Number parsing ------------------
+// The lexer builds the value of a literal while it scans the digits. Up to
+// kMantissaDigits significant digits are kept in an integer, the literal
+// is then the mantissa divided by a power of ten.
+const int kMantissaDigits = 19;
+
+struct DecimalScan {
+  unsigned long long mantissa;
+  int kept; // Significant digits in mantissa
+  int scale; // Fraction digits in mantissa
+  bool dropped; // Digits past kMantissaDigits were seen
+  size_t integer; // The integer part, SIZE_MAX once it overflows
+
+  DecimalScan( ) {
+    mantissa = 0;
+    kept = scale = 0;
+    dropped = false;
+    integer = 0;
+  } // DecimalScan()
+
+  void AddDigit( char ch, bool fraction ) ;
+  float ToFloat( const string &text ) const ;
+};
+
+void DecimalScan::AddDigit( char ch, bool fraction ) {
+  int digit = ch - '0';
+  if ( ! fraction ) {
+    if ( integer > ( SIZE_MAX - digit ) / 10 )
+      integer = SIZE_MAX; // As istream >> size_t does on overflow
+    else
+      integer = integer * 10 + digit;
+  } // if
+
+  if ( kept == kMantissaDigits ) {
+    dropped = dropped || digit != 0 || ! fraction;
+    return;
+  } // if
+
+  mantissa = mantissa * 10 + digit;
+  if ( mantissa > 0 )
+    ++kept;
+  if ( fraction )
+    ++scale;
+} // DecimalScan::AddDigit()
+
+// Correctly rounded like strtof. Both operands are exact doubles below
+// 2^53 and 10^22, so the division rounds once. Only a quotient sitting
+// exactly halfway between two floats could round the wrong way on the
+// way to float, that and over long literals go to strtof.
+float DecimalScan::ToFloat( const string &text ) const {
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  if ( ! dropped && mantissa <= ( 1ULL << 53 ) && scale <= 22 ) {
+    double exact = mantissa / kPow10[ scale ];
+    float result = ( float ) exact;
+    double below = result, above = result;
+    if ( below > exact )
+      below = nextafterf( result, 0.0f );
+    else
+      above = nextafterf( result, HUGE_VALF );
+    if ( exact - below != above - exact )
+      return result;
+  } // if
+
+  float result = strtof( text.c_str(), NULL );
+  if ( isinf( result ) )
+    result = numeric_limits< float >::max(); // As istream >> float does
   return result;
-} // GStringToInt()
+} // DecimalScan::ToFloat()
 
 float GRound( float num ) {
   float result = round( num * 1000.0 ) / 1000.0;
   return result;
 } // GRound()
 
-bool GCompareFloats( float left_value, float right_value, float epsilon, TokenType type ) {
+// --------------------------------------- Number formatting ---------------
+// Numbers are printed into a caller's char array and written to the
+// stream in one piece : no stringstream, no heap, no stream flags left
+// behind. Output is the same as ostream's default format ( Value() ) and
+// fixed with setprecision( 3 ) after GRound ( Inspect() ).
+const int kNumberChars = 64; // Longest any GFormat* writes, with the '\0'
+
+const char kDigitPairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536"
+  "37383940414243444546474849505152535455565758596061626364656667686970717273"
+  "7475767778798081828384858687888990919293949596979899";
+
+// Two digits at a time from the right, returns the length
+int GFormatUnsigned( unsigned long long value, char *buf ) {
+  char tmp[ 24 ];
+  char *end = tmp + sizeof( tmp );
+  char *at = end;
+  while ( value >= 100 ) {
+    int pair = ( int ) ( value % 100 ) * 2;
+    value /= 100;
+    *--at = kDigitPairs[ pair + 1 ];
+    *--at = kDigitPairs[ pair ];
+  } // while
 
-  bool result = false; 
-  if ( type == LT ) 
-    result = left_value < ( right_value - epsilon );
-  else if ( type == GT )
-    result = left_value > ( right_value + epsilon );
-  else if ( type == EQ )
-    result = fabs( left_value - right_value ) < epsilon;
-  else if ( type == LTEQ ) {
-    if ( left_value < right_value + epsilon || 
-         fabs( left_value - right_value ) < epsilon )
-      result = true; 
-  } // else if
-  else if ( type == GTEQ ) {
-    if ( left_value > right_value + epsilon || 
-         fabs( left_value - right_value ) < epsilon )
-      result = true; 
-  } // else if
+  if ( value >= 10 ) {
+    *--at = kDigitPairs[ value * 2 + 1 ];
+    *--at = kDigitPairs[ value * 2 ];
+  } // if
+  else
+    *--at = '0' + ( char ) value;
+
+  memcpy( buf, at, end - at );
+  return end - at;
+} // GFormatUnsigned()
+
+int GFormatInt( long long value, char *buf ) {
+  if ( value >= 0 )
+    return GFormatUnsigned( value, buf );
+
+  buf[ 0 ] = '-';
+  return 1 + GFormatUnsigned( 0ULL - ( unsigned long long ) value, buf + 1 );
+} // GFormatInt()
+
+// Like "%.3f". value * 1000 is exact for a float widened to double, so
+// nearbyint rounds half to even on the true value the way printf does.
+int GFormatFixed3( double value, char *buf ) {
+  double scaled = nearbyint( fabs( value ) * 1000.0 );
+  if ( ! ( scaled < 1e18 ) )
+    return snprintf( buf, kNumberChars, "%.3f", value );
+
+  unsigned long long units = ( unsigned long long ) scaled;
+  int len = 0;
+  if ( signbit( value ) )
+    buf[ len++ ] = '-';
+  len += GFormatUnsigned( units / 1000, buf + len );
+  int frac = ( int ) ( units % 1000 );
+  buf[ len++ ] = '.';
+  buf[ len++ ] = '0' + frac / 100;
+  buf[ len++ ] = kDigitPairs[ frac % 100 * 2 ];
+  buf[ len++ ] = kDigitPairs[ frac % 100 * 2 + 1 ];
+  return len;
+} // GFormatFixed3()
+
+// Like "%g" ( six significant digits ), whole numbers below a million skip
+// printf since %g prints them as plain integers
+int GFormatGeneral( double value, char *buf ) {
+  if ( fabs( value ) < 1e6 && value == trunc( value ) ) {
+    if ( signbit( value ) ) {
+      buf[ 0 ] = '-';
+      return 1 + GFormatUnsigned( ( unsigned long long ) -value, buf + 1 );
+    } // if
 
-  else if ( type == NOT_EQ ) 
-    result = fabs( left_value - right_value ) >= epsilon;
-  
+    return GFormatUnsigned( ( unsigned long long ) value, buf );
+  } // if
 
-  return result;
-} // GCompareFloats()
+  return snprintf( buf, kNumberChars, "%g", value );
+} // GFormatGeneral()
 
-bool GCompareInts( int left_value, int right_value, TokenType type ) {
+// ---------------------------- Input -------------------
+// Standard input is read in large read(2) chunks into one buffer. The
+// REPL reads its lines through it as a streambuf and cin >> scans
+// numbers and words straight out of it, so both see the input in order.
+// Pending output is flushed before the reader may block.
+class InputReader : public streambuf {
+  int mFd;
+  vector< char > mBuf;
 
-  bool result = false; 
-  if ( type == LT ) 
-    result = left_value < right_value;
-  else if ( type == GT )
-    result = left_value > right_value;
-  else if ( type == EQ )
-    result = left_value == right_value;
-  else if ( type == LTEQ ) 
-    result = left_value <=  right_value;
-  else if ( type == GTEQ ) 
-    result = left_value >=  right_value;
-  else if ( type == NOT_EQ ) 
-    result = left_value != right_value;
+  bool Refill( ) ;
+  bool SkipSpace( ) ;
+  bool ReadDigits( string &text, DecimalScan *scan, bool fraction ) ;
 
-  return result;
-} // GCompareInts()
+public:
+  InputReader( int fd, size_t size ) {
+    mFd = fd;
+    mBuf.resize( size );
+    setg( &mBuf[ 0 ], &mBuf[ 0 ], &mBuf[ 0 ] );
+  } // InputReader()
+
+  // Like istream >>, false at the end of the input or when what follows
+  // is not a value of the type. Nothing past the value is consumed.
+  bool ReadInt( int &value ) ;
+  bool ReadFloat( float &value ) ;
+  bool ReadBool( bool &value ) ;
+  bool ReadChar( char &value ) ;
+  bool ReadWord( string &value ) ;
+  bool ReadLine( const char *&data, size_t &size ) ;
+
+protected:
+  int underflow( ) ;
+};
+
+const size_t kInputChunk = 64 * 1024;
+
+// Keep the unread bytes, moved to the front, and read more after them.
+// The buffer grows when they fill it. False at the end of the input.
+bool InputReader::Refill( ) {
+  size_t at = gptr() - eback();
+  size_t kept = egptr() - gptr();
+  if ( kept == mBuf.size() )
+    mBuf.resize( mBuf.size() * 2 );
+  memmove( &mBuf[ 0 ], &mBuf[ at ], kept );
+
+  GFlushOutput();
+  ssize_t got;
+  do {
+    got = read( mFd, &mBuf[ kept ], mBuf.size() - kept );
+  } while ( got < 0 && errno == EINTR );
+
+  setg( &mBuf[ 0 ], &mBuf[ 0 ], &mBuf[ 0 ] + kept + max( got, ( ssize_t ) 0 ) );
+  return got > 0;
+} // InputReader::Refill()
+
+int InputReader::underflow( ) {
+  if ( gptr() == egptr() && ! Refill() )
+    return traits_type::eof();
+  return traits_type::to_int_type( *gptr() );
+} // InputReader::underflow()
+
+// The next line without its '\n', left in the buffer : data is valid
+// until the reader is used again. False at the end of the input.
+bool InputReader::ReadLine( const char *&data, size_t &size ) {
+  size_t scanned = 0;
+  while ( true ) {
+    const char *end = ( const char * ) memchr( gptr() + scanned, '\n', 
+                                              egptr() - gptr() - scanned );
+    if ( end != NULL ) {
+      data = gptr();
+      size = end - gptr();
+      gbump( size + 1 );
+      return true;
+    } // if
+
+    scanned = egptr() - gptr();
+    if ( ! Refill() ) {
+      data = gptr();
+      size = egptr() - gptr();
+      gbump( size );
+      return size > 0;
+    } // if
+  } // while
+} // InputReader::ReadLine()
+
+bool InputReader::SkipSpace( ) {
+  int ch = sgetc();
+  while ( ch != EOF && isspace( ch ) )
+    ch = snextc();
+  return ch != EOF;
+} // InputReader::SkipSpace()
+
+// Digits into text and scan, false if there was none
+bool InputReader::ReadDigits( string &text, DecimalScan *scan, bool fraction ) {
+  size_t start = text.size();
+  int ch = sgetc();
+  while ( ch != EOF && isdigit( ch ) ) {
+    text += ( char ) ch;
+    if ( scan != NULL )
+      scan -> AddDigit( ch, fraction );
+    ch = snextc();
+  } // while
+
+  return text.size() > start;
+} // InputReader::ReadDigits()
+
+bool InputReader::ReadInt( int &value ) {
+  if ( ! SkipSpace() )
+    return false;
+
+  bool negative = sgetc() == '-';
+  if ( negative || sgetc() == '+' )
+    sbumpc();
+
+  long long result = 0;
+  int ch = sgetc();
+  if ( ch == EOF || ! isdigit( ch ) )
+    return false;
+  while ( ch != EOF && isdigit( ch ) ) {
+    result = result * 10 + ( ch - '0' );
+    if ( result > ( long long ) INT_MAX + 1 )
+      return false;
+    ch = snextc();
+  } // while
+
+  if ( negative )
+    result = -result;
+  if ( result > INT_MAX )
+    return false;
+  value = ( int ) result;
+  return true;
+} // InputReader::ReadInt()
+
+// [sign] digits [. digits] [e [sign] digits], the exponent form is left
+// to strtof
+bool InputReader::ReadFloat( float &value ) {
+  if ( ! SkipSpace() )
+    return false;
+
+  bool negative = sgetc() == '-';
+  if ( negative || sgetc() == '+' )
+    sbumpc();
+
+  string text;
+  DecimalScan scan;
+  bool digits = ReadDigits( text, &scan, false );
+  if ( sgetc() == '.' ) {
+    text += ( char ) sbumpc();
+    digits = ReadDigits( text, &scan, true ) || digits;
+  } // if
+
+  if ( ! digits )
+    return false;
+
+  bool exponent = sgetc() == 'e' || sgetc() == 'E';
+  if ( exponent ) {
+    text += ( char ) sbumpc();
+    if ( sgetc() == '-' || sgetc() == '+' )
+      text += ( char ) sbumpc();
+    if ( ! ReadDigits( text, NULL, false ) )
+      return false;
+  } // if
+
+  float result = exponent ? strtof( text.c_str(), NULL ) : scan.ToFloat( text );
+  if ( isinf( result ) )
+    return false;
+  value = negative ? -result : result;
+  return true;
+} // InputReader::ReadFloat()
+
+// 0 or 1, as istream >> bool reads them
+bool InputReader::ReadBool( bool &value ) {
+  int number;
+  if ( ! ReadInt( number ) || ( number != 0 && number != 1 ) )
+    return false;
+  value = number == 1;
+  return true;
+} // InputReader::ReadBool()
+
+bool InputReader::ReadChar( char &value ) {
+  if ( ! SkipSpace() )
+    return false;
+  value = ( char ) sbumpc();
+  return true;
+} // InputReader::ReadChar()
+
+bool InputReader::ReadWord( string &value ) {
+  if ( ! SkipSpace() )
+    return false;
+
+  value.clear();
+  int ch = sgetc();
+  while ( ch != EOF && ! isspace( ch ) ) {
+    value += ( char ) ch;
+    ch = snextc();
+  } // while
+
+  return true;
+} // InputReader::ReadWord()
+
+InputReader gStdinReader( STDIN_FILENO, kInputChunk );
+istream gStdin( &gStdinReader );
+
+// Where cin reads, NULL inside an Interpreter which has no input
+thread_local InputReader *gIn = &gStdinReader;
 
 // --------------------------------------- Lexer ---------------------------
 class Lexer {
   string mStr;
   size_t mCurrent;
   size_t mPeek;
+  size_t mStart; // Where the token being read starts
+  int mLine;
   char mCh;
+  const vector< Token * > *mReplay; // Tokens read again instead of mStr
+  size_t mNext; // Next token of mReplay
 
 public:
-  Lexer( string str ) {
+  Lexer( string str, int line = 0 ) {
     mStr = str;
     mPeek = 0;
+    mStart = 0;
+    mLine = line;
+    mReplay = NULL;
+    mNext = 0;
     ReadChar( ) ;
   } // Lexer()
 
+  // Hand out tokens read before, then EOFF, see Parser::SkipBody()
+  Lexer( const vector< Token * > *tokens ) {
+    mPeek = 0;
+    mStart = 0;
+    mLine = 0;
+    mReplay = tokens;
+    mNext = 0;
+    mCh = '\0';
+  } // Lexer()
+
   void ReadChar( ) ;
   void AppendStr( string str ) ;
   bool HasMoreToken( ) ;
@@ -334,6 +1052,7 @@ Token *Lexer::ReadDivide( ) {
 Token *Lexer::ReadNumber( ) {
   Token *tok = NULL;
   string number = "";
+  DecimalScan scan;
   // if it start with an.
   // .122 .22122 .5125.2512 .2124.helloworld
   number += mCh;
@@ -341,17 +1060,21 @@ Token *Lexer::ReadNumber( ) {
     ReadChar( ) ;
     while ( isdigit( mCh ) ) {
       number += mCh;
+      scan.AddDigit( mCh, true );
       ReadChar( ) ;
     } // while
 
     if ( number.length( ) == 1 )
       tok = SetNewToken( number, ILLEGAL ) ;
-    else
+    else {
       tok = SetNewToken( number, FLOAT ) ;
+      tok -> real = scan.ToFloat( number );
+    } // else
   } // if
 
   // 1.231 3.1415 2.19 2 23 1.
   else if ( isdigit( mCh ) ) {
+    scan.AddDigit( mCh, false );
     ReadChar( ) ;
     while ( isdigit( mCh ) || mCh == '.' ) {
       number += mCh;
@@ -360,17 +1083,21 @@ Token *Lexer::ReadNumber( ) {
         ReadChar( ) ;
         while ( isdigit( mCh ) ) {
           number += mCh;
+          scan.AddDigit( mCh, true );
           ReadChar( ) ;
         } // while
 
         tok = SetNewToken( number, FLOAT ) ;
+        tok -> real = scan.ToFloat( number );
         return tok;
       } // if
 
+      scan.AddDigit( mCh, false );
       ReadChar( ) ;
     } // while
 
     tok = SetNewToken( number, INT ) ;
+    tok -> integer = scan.integer;
   } // else if
 
   return tok;
@@ -421,6 +1148,8 @@ Token *Lexer::SetNewToken( string val, TokenType type ) {
   Token *tok = new Token;
   tok->value = val;
   tok->type = type;
+  tok->line = mLine;
+  tok->column = mStart + 1;
   return tok;
 } // Lexer::SetNewToken()
 
@@ -525,10 +1254,18 @@ Token *Lexer::ReadCompare( ) {
 // Get next token
 Token *Lexer::ReadNextToken( ) {
   Token *tok;
+  if ( mReplay != NULL ) {
+    if ( mNext < mReplay -> size() )
+      return ( *mReplay )[ mNext++ ];
+    return SetNewToken( "\0", EOFF );
+  } // if
+
+  STAT( ++gStats.tokens );
 
   if ( isspace( mCh ) )
     SkipWhiteSpace( ) ;
 
+  mStart = mCurrent;
   // Number encountered eg 1.23 .235 251,....
   if ( isdigit( mCh ) || mCh == '.' ) {
     tok = ReadNumber( ) ;
@@ -604,69 +1341,321 @@ Token *Lexer::ReadNextToken( ) {
 
 // --------------------------- Environment --------------------------
 class Obj;
+map< string, Obj * > &GBuiltins( ) ;
+class Environment;
+typedef map< string, Obj * > VarMap;
+
+// The variables of a global environment frozen by Environment::Snapshot.
+// Environments forked from it read them and keep their own writes.
+struct EnvSnapshot {
+  shared_ptr< const VarMap > vars;
+  Environment *source; // Closure of the functions among vars
+
+  EnvSnapshot( ) {
+    source = NULL;
+  } // EnvSnapshot()
+};
+
+// Objects and call frames made while it is the current heap ( gRunHeap )
+// belong to it, see Obj::operator new and Environment::NewFrame(). Only
+// the embedding API sets one, so a Context frees what its runs leave
+// unreachable, see Sweep(). Without one they live as long as the process.
+class RunHeap {
+  vector< Obj * > mObjs;
+  vector< Environment * > mFrames;
+
+  void Mark( Obj *obj, vector< char > &objs, vector< char > &frames ) ;
+  void MarkFrames( Environment *env, vector< char > &objs, vector< char > &frames ) ;
+
+public:
+  RunHeap( ) { } // RunHeap()
+  RunHeap( const RunHeap & ) = delete;
+  RunHeap &operator=( const RunHeap & ) = delete;
+  ~RunHeap( ) ;
+
+  void AdoptObj( Obj *obj ) {
+    mObjs.push_back( obj );
+  } // AdoptObj()
+
+  void AdoptFrame( Environment *frame ) {
+    mFrames.push_back( frame );
+  } // AdoptFrame()
+
+  // Objects and frames held
+  size_t Size( ) {
+    return mObjs.size() + mFrames.size();
+  } // Size()
+
+  // What is held lives as long as the process from now on
+  void Release( ) {
+    mObjs.clear();
+    mFrames.clear();
+  } // Release()
+
+  void Sweep( const vector< const VarMap * > &roots ) ;
+};
+
+thread_local RunHeap *gRunHeap = NULL; // NULL : allocations are not tracked
+
+// Source of the binding epochs, see Environment::Epoch(). Only taken
+// from when a binding changes, so epochs are never reused.
+atomic< unsigned long > gBindingSerial( 0 );
+
+bool GCallable( Obj *obj ) ;
+
 // ------------------Environment------------------------------------------
+// Names missing from the whole chain fall back to the builtins, so a
+// script can shadow them
 class Environment {
-  map< string, Obj * > mVars;
+  VarMap mVars;
+  shared_ptr< const VarMap > mBase; // Snapshot under mVars, forks only
+  Environment *mForkOf; // Source of that snapshot
   Environment *mOuter;
+  Environment *mRoot; // End of the mOuter chain
+  atomic< unsigned long > mEpoch; // Of the root, see Epoch()
+  bool mFrame; // Of a function call, see NewFrame()
+
+  // A call frame, it takes no epoch of its own
+  explicit Environment( Environment *closure ) {
+    mOuter = closure;
+    mForkOf = NULL;
+    mRoot = closure == NULL ? this : closure -> mRoot;
+    mEpoch = 0;
+    mFrame = true;
+  } // Environment()
+
+  bool Lookup( const string &var, Obj **obj ) ;
+  void Rebind( ) ;
+
+  friend class RunHeap;
 
 public:
   Environment( ) {
     mOuter = NULL;
+    mForkOf = NULL;
+    mRoot = this;
+    mEpoch = ++gBindingSerial;
+    mFrame = false;
+  } // Environment()
+
+  // A global environment starting with the variables of snapshot, costs
+  // a pointer copy
+  Environment( const EnvSnapshot &snapshot ) {
+    mBase = snapshot.vars;
+    mForkOf = snapshot.source;
+    mOuter = NULL;
+    mRoot = this;
+    mEpoch = ++gBindingSerial;
+    mFrame = false;
   } // Environment()
 
+  // Takes the variables and the links of other, not its epoch
+  Environment &operator=( const Environment &other ) {
+    mVars = other.mVars;
+    mBase = other.mBase;
+    mForkOf = other.mForkOf;
+    mOuter = other.mOuter;
+    mFrame = other.mFrame;
+    mRoot = mOuter == NULL ? this : mOuter -> mRoot;
+    mRoot -> mEpoch.store( ++gBindingSerial, memory_order_release );
+    return *this;
+  } // operator=()
+
+  // A new root takes a new epoch, its enclosed environments move the
+  // epoch of the root they leave
+  ~Environment( ) {
+    if ( mRoot != this )
+      Rebind();
+  } // ~Environment()
+
+  // The environment of a call, it only holds the parameters and the
+  // names the body declares or assigns
+  static Environment *NewFrame( Environment *closure ) ;
+
+  EnvSnapshot Snapshot( ) ;
+  bool Derives( Environment *env ) ;
+
+  bool IsFrame( ) {
+    return mFrame;
+  } // IsFrame()
+
+  // Before anything is enclosed in this environment
   void SetOuter( Environment * env ) {
     mOuter = env; 
+    mRoot = env == NULL ? this : env -> mRoot;
+    Rebind();
   } // SetOuter
 
+  Environment *Outer( ) {
+    return mOuter;
+  } // Outer()
+
+  Environment *Root( ) {
+    return mRoot;
+  } // Root()
+
+  // Changes when a name of an environment of this chain other than a
+  // call frame is added or bound to a function, or when such an
+  // environment is relinked or destroyed. Each root has its own, so
+  // scripts run on other threads in their own globals do not move it.
+  // Call sites keep what they looked up while it stays the same, see
+  // CallCache.
+  unsigned long Epoch( ) {
+    return mRoot -> mEpoch.load( memory_order_acquire );
+  } // Epoch()
+
   Environment *NewEnclosedEnvironment( Environment* outer );
   void Set( string var, Obj *data ) ;
   Obj *Get( string var ) ;
   bool VarExist( string var ) ;
+  void Reserve( string var ) ;
+  vector< string > Names( ) ;
+
+  // The variables of this environment alone, without its snapshot
+  const VarMap &Vars( ) {
+    return mVars;
+  } // Vars()
 };
 
+Environment *Environment::NewFrame( Environment *closure ) {
+  Environment *frame = new Environment( closure );
+  if ( gRunHeap != NULL )
+    gRunHeap -> AdoptFrame( frame );
+  return frame;
+} // Environment::NewFrame()
+
+void Environment::Rebind( ) {
+  if ( ! mFrame )
+    mRoot -> mEpoch.store( ++gBindingSerial, memory_order_release );
+} // Environment::Rebind()
+
 Environment *Environment::NewEnclosedEnvironment( Environment* outer ) {
   Environment *env = new Environment();
   env -> SetOuter( outer );
   return env;
 } // Environment::NewEnclosedEnvironment()
 
+// Find var in this environment only
+bool Environment::Lookup( const string &var, Obj **obj ) {
+  VarMap::iterator found = mVars.find( var );
+  if ( found != mVars.end( ) ) {
+    *obj = found -> second;
+    return true;
+  } // if
+
+  if ( mBase != NULL ) {
+    VarMap::const_iterator shared = mBase -> find( var );
+    if ( shared != mBase -> end( ) ) {
+      *obj = shared -> second;
+      return true;
+    } // if
+  } // if
+
+  return false;
+} // Environment::Lookup()
+
+EnvSnapshot Environment::Snapshot( ) {
+  shared_ptr< VarMap > vars = make_shared< VarMap >( mVars );
+  if ( mBase != NULL )
+    vars -> insert( mBase -> begin( ), mBase -> end( ) );
+
+  EnvSnapshot snapshot;
+  snapshot.vars = vars;
+  snapshot.source = this;
+  return snapshot;
+} // Environment::Snapshot()
+
+// True if this environment is env or was forked, maybe through other
+// forks, from a snapshot of env
+bool Environment::Derives( Environment *env ) {
+  for ( Environment *fork = this; fork != NULL; fork = fork -> mForkOf )
+    if ( fork == env )
+      return true;
+  return false;
+} // Environment::Derives()
+
 bool Environment::VarExist( string var ) {
-  if ( mVars.find( var ) == mVars.end( ) ) {
+  Obj *obj = NULL;
+  if ( ! Lookup( var, &obj ) ) {
     if ( mOuter != NULL )
       return mOuter -> VarExist( var ); 
     else
-      return false;
+      return GBuiltins().count( var ) > 0;
   } // if
   return true;
 } // Environment::VarExist()
 
 void Environment::Set( string var, Obj *data ) {
-  if ( VarExist( var ) ) {
-    mVars [ var ] = data;
+  pair< VarMap::iterator, bool > slot = mVars.insert( make_pair( var, data ) );
+  Obj *old = slot.first -> second;
+  slot.first -> second = data;
+  if ( slot.second || GCallable( old ) || GCallable( data ) )
+    Rebind();
+} // Environment::Set()
+
+// Add var to this environment, with its snapshot value or unset, if it
+// is not there yet
+void Environment::Reserve( string var ) {
+  Obj *obj = NULL;
+  if ( mVars.find( var ) == mVars.end( ) ) {
+    Lookup( var, &obj );
+    mVars[ var ] = obj;
+    Rebind();
+  } // if
+} // Environment::Reserve()
+
+// The names bound in this environment alone, sorted
+vector< string > Environment::Names( ) {
+  vector< string > names;
+  for ( VarMap::iterator it = mVars.begin( ); it != mVars.end( ); ++it )
+    names.push_back( it -> first );
+  if ( mBase != NULL ) {
+    for ( VarMap::const_iterator it = mBase -> begin( ); it != mBase -> end( ); ++it )
+      names.push_back( it -> first );
+    sort( names.begin( ), names.end( ) );
+    names.erase( unique( names.begin( ), names.end( ) ), names.end( ) );
   } // if
-  else {
-    mVars [ var ] = data;
-  } // else
 
-} // Environment::Set()
+  return names;
+} // Environment::Names()
 
 Obj *Environment::Get( string var ) {
-  Obj* obj = NULL; 
-  if ( mVars.find( var ) != mVars.end( ) ) 
-    obj = mVars[ var ]; 
-
-  else {
-    if ( mOuter != NULL ) 
-      obj = mOuter -> Get( var );
-  } // else
+  STAT( ++gStats.lookups );
+  Obj *obj = NULL;
+  for ( Environment *env = this; env != NULL; env = env -> mOuter ) {
+    if ( env -> Lookup( var, &obj ) )
+      return obj;
+    STAT( ++gStats.hops );
+  } // for
 
-  return obj;
+  map< string, Obj * >::iterator builtin = GBuiltins().find( var );
+  if ( builtin != GBuiltins().end( ) )
+    return builtin -> second;
+  return NULL;
 } // Environment::Get()
 
 class Parameter; 
 // --------------------------- Data type -----------------------------
+
+thread_local size_t gObjAllocs = 0; // Obj allocated so far, for the profiler
+
 class Obj {
+protected:
+  ObjKind mObjKind;
+
 public:
+  ObjKind Kind( ) { return mObjKind; } // Kind()
+
+  void SetKind( ObjKind kind ) {
+    mObjKind = kind;
+    STAT( ++gStats.objects[ kind ] );
+  } // SetKind()
+
+  virtual ~Obj( ) { } // ~Obj()
+
+  static void *operator new( size_t size ) ;
+  static void operator delete( void *mem ) ;
+
   virtual void Inspect( ) = 0;
   virtual string Type( ) = 0;
   virtual string Value( ) = 0;
@@ -675,6 +1664,22 @@ public:
   virtual vector < Parameter *> GetParameter( ) = 0;
 };
 
+ALLOC_FN void *Obj::operator new( size_t size ) {
+  ++gObjAllocs;
+  void *mem = ::operator new( size );
+  if ( gRunHeap != NULL )
+    gRunHeap -> AdoptObj( ( Obj * ) mem );
+  return mem;
+} // Obj::operator new()
+
+ALLOC_FN void Obj::operator delete( void *mem ) {
+  ::operator delete( mem );
+} // Obj::operator delete()
+
+bool GCallable( Obj *obj ) {
+  return obj != NULL && ( obj -> Kind() == FUNCTION_KIND || obj -> Kind() == BUILTIN_KIND );
+} // GCallable()
+
 class Return : public Obj {
   string mType;
   Obj* mValue;
@@ -683,6 +1688,7 @@ public:
   Return( Obj* value ) {
     mValue = value;
     mType = "Return";
+    SetKind( RETURN_KIND );
   } // Return
 
   void Inspect(); 
@@ -726,8 +1732,11 @@ public:
   Integer( size_t value, string tp ) {
     mType = tp;
     mValue = value;
+    SetKind( INT_KIND );
   } // Integer()
 
+  int Get( ) { return mValue; } // Get()
+
   void Inspect( ) ;
   string Type( ) ;
   string Value( ) ;
@@ -751,13 +1760,16 @@ Obj* Integer::Eval( Environment *env ) {
 string Integer::Type( ) { return mType; } // Integer::Type()
 
 string Integer::Value( ) {
-  stringstream ss;
-  ss << mValue;
-  string result = ss.str( ) ;
-  return result;
+  char buf[ kNumberChars ];
+  return string( buf, GFormatInt( mValue, buf ) );
 } // Integer::Value()
 
-void Integer::Inspect( ) { cout << mValue << endl; } // Integer::Inspect()
+void Integer::Inspect( ) {
+  char buf[ kNumberChars ];
+  int len = GFormatInt( mValue, buf );
+  buf[ len++ ] = '\n';
+  gOut -> write( buf, len );
+} // Integer::Inspect()
 
 class Float : public Obj {
   string mType;
@@ -767,7 +1779,10 @@ public:
   Float( float value, string tp ) {
     mType = tp;
     mValue = value;
+    SetKind( FLOAT_KIND );
   } // Float()
+
+  float Get( ) { return mValue; } // Get()
   
   Environment *GetEnv( ) {
     return NULL;
@@ -792,14 +1807,15 @@ Obj* Float::Eval( Environment *env ) {
 string Float::Type( ) { return mType; } // Float::Type()
 
 string Float::Value( ) {
-  stringstream ss;
-  ss << mValue;
-  string res = ss.str( ) ;
-  return res;
+  char buf[ kNumberChars ];
+  return string( buf, GFormatGeneral( mValue, buf ) );
 } // Float::Value()
 
 void Float::Inspect( ) { 
-  cout << fixed << setprecision( 3 ) << GRound( mValue ) << endl; 
+  char buf[ kNumberChars ];
+  int len = GFormatFixed3( GRound( mValue ), buf );
+  buf[ len++ ] = '\n';
+  gOut -> write( buf, len );
 } // Float::Inspect()
 
 class Boolean : public Obj {
@@ -810,6 +1826,7 @@ public:
   Boolean( bool value, string tp ) {
     mType = tp;
     mValue = value;
+    SetKind( BOOL_KIND );
   } // Boolean()
 
   Obj* Eval( Environment *env ) {
@@ -840,9 +1857,9 @@ string Boolean::Value( ) {
 
 void Boolean::Inspect( ) {
   if ( mValue == true )
-    cout << "true" << endl;
+    *gOut << "true" << "\n";
   else
-    cout << "false" << endl;
+    *gOut << "false" << "\n";
 } // Boolean::Inspect()
 
 class Char : public Obj {
@@ -853,6 +1870,7 @@ public:
   Char( string value, string type ) {
     mType = type;
     mValue = value;
+    SetKind( CHAR_KIND );
   } // String()
 
   Environment *GetEnv( ) {
@@ -877,7 +1895,7 @@ string Char::Type( ) { return mType; } // String::Type()
 
 string Char::Value( ) { return mValue; } // String::Value()
 
-void Char::Inspect( ) { cout << mValue << endl; } // String::Inspect()
+void Char::Inspect( ) { *gOut << mValue << "\n"; } // String::Inspect()
 
 class String : public Obj {
   string mType;
@@ -887,6 +1905,7 @@ public:
   String( string type, string value ) {
     mType = type;
     mValue = value;
+    SetKind( STRING_KIND );
   } // String()
 
   Environment *GetEnv( ) {
@@ -916,14 +1935,14 @@ void String::Inspect( ) {
     if ( mValue[i] == '\\' ) {
       if ( i + 1 < mValue.size() && mValue[i+1] == 'n' ) {
         ++i;
-        cout << endl;
+        *gOut << "\n";
       } // if
       else 
-        cout << mValue[i];
+        *gOut << mValue[i];
     } // if
 
     else 
-      cout << mValue[i];
+      *gOut << mValue[i];
   } // for
 
 } // String::Inspect()
@@ -932,7 +1951,10 @@ class Null : public Obj {
   string mType;
 
 public:
-  Null( ) { mType = "NULL"; } // Null()
+  Null( ) { 
+    mType = "NULL"; 
+    SetKind( NULL_KIND );
+  } // Null()
 
   Obj* Eval( Environment *env ) {
     return NULL;
@@ -957,1094 +1979,1935 @@ string Null::Type( ) { return mType; } // Null::Type()
 
 string Null::Value( ) { return "Null"; } // Null::Value()
 
-void Null::Inspect( ) { cout << "" << endl; } // Null::Inspect()
+void Null::Inspect( ) { *gOut << "" << "\n"; } // Null::Inspect()
 
-// ------------------------------- Node ---------------------------
+// ---------------------------- Operators ---------------------------
+// Every evaluator ( BinExpr, AssignmentExpr, UnaryExpression,
+// UpdateExpression and the VM ) shares the functors below. The kernel
+// for each ( operator, left operand, right operand ) combination is a
+// template instance, and the instances are laid out in a constexpr
+// matrix so a node only has to index it with the kinds of its operands.
 
-class Node {
-  string mType;
+typedef enum {
+  OPR_ADD,
+  OPR_SUB,
+  OPR_MUL,
+  OPR_DIV,
+  OPR_MOD,
+  OPR_SHL,
+  OPR_SHR,
+  OPR_LT,
+  OPR_GT,
+  OPR_LTEQ,
+  OPR_GTEQ,
+  OPR_EQ,
+  OPR_NOT_EQ,
+  OPERATOR_COUNT
+} Operator
+;
 
-public:
-  virtual void Print( ) = 0;
-  virtual string Type( ) = 0;
-  virtual string Value( ) = 0;
-  virtual Obj *Eval( Environment *env ) = 0;
+// The operand classes a kernel is specialised on, see GKernelClass()
+typedef enum {
+  INT_OPND,
+  FLOAT_OPND,
+  STRING_OPND,
+  CHAR_OPND,
+  BOOL_OPND,
+  OTHER_OPND,
+  OPERAND_COUNT
+} Operand
+;
+
+constexpr Operand kOperandOf[ KIND_COUNT ] = {
+  INT_OPND, // INT_KIND
+  FLOAT_OPND, // FLOAT_KIND
+  STRING_OPND, // STRING_KIND
+  CHAR_OPND, // CHAR_KIND
+  BOOL_OPND, // BOOL_KIND
+  OTHER_OPND, // NULL_KIND
+  OTHER_OPND, // FUNCTION_KIND
+  OTHER_OPND, // RETURN_KIND
+  OTHER_OPND // BUILTIN_KIND
 };
 
-// ---------------------------- AST node type -------------------
-class Statement : public Node {
-public:
-  virtual void Stmt( ) = 0;
-}; // Statement
+const float kEpsilon = 0.0001;
+
+// Binary and compound assignment tokens to operator, OPERATOR_COUNT
+// for anything else. Only called when a node is built.
+Operator GOperatorOf( TokenType type ) {
+  if ( type == PLUS || type == PLUS_EQ || type == PLUSPLUS )
+    return OPR_ADD;
+  else if ( type == MINUS || type == MINUS_EQ || type == MINUSMINUS )
+    return OPR_SUB;
+  else if ( type == MULTIPLY || type == MULTI_EQ )
+    return OPR_MUL;
+  else if ( type == DIVIDE || type == DIVIDE_EQ )
+    return OPR_DIV;
+  else if ( type == MODULO )
+    return OPR_MOD;
+  else if ( type == LEFT_SHIFT )
+    return OPR_SHL;
+  else if ( type == RIGHT_SHIFT )
+    return OPR_SHR;
+  else if ( type == LT )
+    return OPR_LT;
+  else if ( type == GT )
+    return OPR_GT;
+  else if ( type == LTEQ )
+    return OPR_LTEQ;
+  else if ( type == GTEQ )
+    return OPR_GTEQ;
+  else if ( type == EQ )
+    return OPR_EQ;
+  else if ( type == NOT_EQ )
+    return OPR_NOT_EQ;
+  return OPERATOR_COUNT;
+} // GOperatorOf()
+
+// kFloat : the operator is defined on floats
+template < int OPR >
+struct OpFn;
+
+template < >
+struct OpFn< OPR_ADD > {
+  static const bool kFloat = true;
+  static int Int( int l, int r ) { return l + r; } // Int()
+  static float Float( float l, float r ) { return l + r; } // Float()
+};
 
-class Expression : public Node {
-public:
-  virtual void Expr( ) = 0;
+template < >
+struct OpFn< OPR_SUB > {
+  static const bool kFloat = true;
+  static int Int( int l, int r ) { return l - r; } // Int()
+  static float Float( float l, float r ) { return l - r; } // Float()
 };
 
-// 1 + 2 ; 2 + 4 ;
-// --------------------------- Block Statement -----------------------
-class BlockStatement : public Statement {
-  Token *mTok; // { token
-  string mType;
-  vector< Statement * > mStmts;
+template < >
+struct OpFn< OPR_MUL > {
+  static const bool kFloat = true;
+  static int Int( int l, int r ) { return l * r; } // Int()
+  static float Float( float l, float r ) { return l * r; } // Float()
+};
 
-public:
-  BlockStatement( Token *token ) {
-    mType = "Block Statements";
-    mTok = token;
-  } // BlockStatement()
+template < >
+struct OpFn< OPR_DIV > {
+  static const bool kFloat = true;
+  // INT_MIN / -1 wraps as the other operators do, r is never 0, see
+  // GZeroDivisor()
+  static int Int( int l, int r ) {
+    return r == -1 ? ( int ) ( 0u - ( unsigned ) l ) : l / r;
+  } // Int()
 
-  void Append( Statement *stmt ) ;
+  static float Float( float l, float r ) { return l / r; } // Float()
+};
 
-  void Stmt( ) {
-  } // Stmt()
+template < >
+struct OpFn< OPR_MOD > {
+  static const bool kFloat = true;
+  static int Int( int l, int r ) { return r == -1 ? 0 : l % r; } // Int()
+  static float Float( float l, float r ) { return fmod( l, r ); } // Float()
+};
 
-  void Print( ) ;
-  string Type( ) ;
-  string Value( ) ;
+template < >
+struct OpFn< OPR_SHL > {
+  static const bool kFloat = false;
+  static int Int( int l, int r ) { return l << r; } // Int()
+};
 
-  vector< Statement* > GetStmts() {
-    return mStmts;
-  }  // GetStmts()
+template < >
+struct OpFn< OPR_SHR > {
+  static const bool kFloat = false;
+  static int Int( int l, int r ) { return l >> r; } // Int()
+};
 
-  Obj *Eval( Environment *env ) ;
+template < >
+struct OpFn< OPR_LT > {
+  static const bool kFloat = true;
+  static bool Int( int l, int r ) { return l < r; } // Int()
+  static bool Float( float l, float r ) { return l < r - kEpsilon; } // Float()
 };
 
-void BlockStatement::Append( Statement *stmt ) {
+template < >
+struct OpFn< OPR_GT > {
+  static const bool kFloat = true;
+  static bool Int( int l, int r ) { return l > r; } // Int()
+  static bool Float( float l, float r ) { return l > r + kEpsilon; } // Float()
+};
 
-  mStmts.push_back( stmt ) ;
-
-} // BlockStatement::Append()
-
-void BlockStatement::Print( ) {
-  cout << "{ \n";
-  for ( int i = 0; i < mStmts.size( ) ; ++i ) {
-    mStmts [ i ]->Print( ) ;
-  } // for
-  cout << "} \n ";
-} // BlockStatement::Print()
-
-string BlockStatement::Type( ) { return mType; } // BlockStatement::Type()
-
-Obj *BlockStatement::Eval( Environment *env ) { 
-  Obj *obj = NULL;
-  for ( int i = 0; i < mStmts.size(); ++i ) {
-    obj = mStmts[i] -> Eval( env );
-    if ( obj != NULL && obj -> Type() == "Return" ) 
-      return obj;
-  } // for 
+template < >
+struct OpFn< OPR_LTEQ > {
+  static const bool kFloat = true;
+  static bool Int( int l, int r ) { return l <= r; } // Int()
+  static bool Float( float l, float r ) {
+    return l < r + kEpsilon || fabs( l - r ) < kEpsilon;
+  } // Float()
 
-  return obj;
-} // BlockStatement::Eval()
+};
 
-string BlockStatement::Value( ) { return mTok->value; } // BlockStatement::Value()
+template < >
+struct OpFn< OPR_GTEQ > {
+  static const bool kFloat = true;
+  static bool Int( int l, int r ) { return l >= r; } // Int()
+  static bool Float( float l, float r ) {
+    return l > r + kEpsilon || fabs( l - r ) < kEpsilon;
+  } // Float()
 
+};
 
-//----------------- if else ------------------
-class ConditionalExpr : public Expression {
-  Token *mTok; // If token
-  string mType;
-  Expression *mCondition;
-  BlockStatement *mConsequence;
-  BlockStatement *mAlternative;
+template < >
+struct OpFn< OPR_EQ > {
+  static const bool kFloat = true;
+  static bool Int( int l, int r ) { return l == r; } // Int()
+  static bool Float( float l, float r ) { return fabs( l - r ) < kEpsilon; } // Float()
+};
 
-public:
-  ConditionalExpr( Token *tok, Expression *cond, BlockStatement *consequence,
-                   BlockStatement *alternative ) {
-    mTok = tok;
-    mType = "Conditional Expression";
-    mCondition = cond;
-    mConsequence = consequence;
-    mAlternative = alternative;
-  } // ConditionalExpr()
+template < >
+struct OpFn< OPR_NOT_EQ > {
+  static const bool kFloat = true;
+  static bool Int( int l, int r ) { return l != r; } // Int()
+  static bool Float( float l, float r ) { return fabs( l - r ) >= kEpsilon; } // Float()
+};
 
-  void Expr( ) {
-  } // Expr() 
+Obj *GMake( int value ) { return new Integer( value, "Integer" ); } // GMake()
 
-  void Print( ) ;
-  string Type( ) ;
-  string Value( ) ;
-  Obj *Eval( Environment *env ) ;
-};
+Obj *GMake( float value ) { return new Float( value, "Float" ); } // GMake()
 
-void ConditionalExpr::Print( ) {
-  cout << " If ";
-  mCondition->Print( ) ;
-  mConsequence->Print( ) ;
-  if ( mAlternative != NULL ) {
-    cout << "Else", mConsequence->Print( ) ;
-  } // if
+Obj *GMake( bool value ) { return new Boolean( value, "Boolean" ); } // GMake()
 
-} // ConditionalExpr::Print()
+Obj *GMake( string value ) { return new String( "String", value ); } // GMake()
 
-string ConditionalExpr::Type( ) { return mType; } // ConditionalExpr::Type()
+int GIntOf( Obj *obj ) { return ( ( Integer * ) obj ) -> Get(); } // GIntOf()
 
-string ConditionalExpr::Value( ) { return mTok->value; } // ConditionalExpr::Value()
+float GFloatOf( Obj *obj ) {
+  if ( obj -> Kind() == FLOAT_KIND )
+    return ( ( Float * ) obj ) -> Get();
+  return GIntOf( obj );
+} // GFloatOf()
 
-// TODO: Implement evaluation
-Obj *ConditionalExpr::Eval( Environment *env ) { return NULL; } // ConditionalExpr::Eval()
+// A number as the operators read it, see GReadBack()
+float GOperandOf( Obj *obj ) {
+  if ( obj -> Kind() == FLOAT_KIND )
+    return GReadBack( ( ( Float * ) obj ) -> Get() );
+  return GIntOf( obj );
+} // GOperandOf()
 
-class IntExpr : public Expression {
-  Token *mTok;
-  string mType;
-  size_t mValue;
+typedef Obj *( *BinaryKernel )( Obj *left, Obj *right );
 
-public:
-  IntExpr( Token *tok, size_t value ) {
-    mValue = value;
-    mTok = tok;
-    mType = "Integer";
-  } // IntExpr()
+// How an operator works on two operand classes. As in the evaluator the
+// kernels replace, a string or a char on either side makes + concatenate
+// the printed values and the other arithmetic operators undefined, so
+// 'x' + 1 is "x1". Two strings or chars compare by their text, "10" < "9"
+// and 'x' < 'y'. Otherwise a float on either side makes a float operation
+// and anything else is an int operation. Strings and booleans read as
+// numbers through their printed value, so "12" < 9 is false and true
+// reads as 0. Two booleans compare by their truth values, true == true.
+typedef enum {
+  NO_KERNEL,
+  INT_KERNEL,
+  FLOAT_KERNEL,
+  CONCAT_KERNEL,
+  TEXT_KERNEL,
+  TRUTH_KERNEL
+} KernelClass
+;
 
-  string Type( ) ;
-  void Print( ) ;
-  void Expr( ) ;
-  string Value( ) ;
-  Obj *Eval( Environment *env ) ;
+constexpr bool GIsCompare( int opr ) { return opr >= OPR_LT; } // GIsCompare()
+
+constexpr bool GIsText( int k ) { return k == STRING_OPND || k == CHAR_OPND; } // GIsText()
+
+constexpr KernelClass GKernelClass( int opr, int l, int r ) {
+  return l == OTHER_OPND || r == OTHER_OPND ? NO_KERNEL
+         : ! GIsCompare( opr ) && ( GIsText( l ) || GIsText( r ) )
+         ? ( opr == OPR_ADD ? CONCAT_KERNEL : NO_KERNEL )
+         : GIsText( l ) && GIsText( r ) ? TEXT_KERNEL
+         : GIsCompare( opr ) && l == BOOL_OPND && r == BOOL_OPND ? TRUTH_KERNEL
+         : l == FLOAT_OPND || r == FLOAT_OPND ? FLOAT_KERNEL
+         : INT_KERNEL;
+} // GKernelClass()
+
+// An operand read as a number
+template < int K >
+struct ReadOperand {
+  static int Int( Obj *obj ) { return GStringToInt( obj -> Value() ); } // Int()
+  static float Float( Obj *obj ) { return GStringToFloat( obj -> Value() ); } // Float()
 };
 
-string IntExpr::Type( ) { return mType; } // IntExpr::Type()
+template < >
+struct ReadOperand< INT_OPND > {
+  static int Int( Obj *obj ) { return GIntOf( obj ); } // Int()
+  static float Float( Obj *obj ) { return GIntOf( obj ); } // Float()
+};
 
-Obj *IntExpr::Eval( Environment *env ) {
-  Obj *result = new Integer( mValue, mType ) ;
-  return result;
-} // IntExpr::Eval()
+template < >
+struct ReadOperand< FLOAT_OPND > {
+  static float Float( Obj *obj ) { return GOperandOf( obj ); } // Float()
+};
 
-string IntExpr::Value( ) {
-  stringstream ss;
-  ss << mValue;
-  string str = ss.str( ) ;
-  return str;
-} // IntExpr::Value()
+// NULL means the operator is not defined on these operands
+template < int OPR, int L, int R, KernelClass CLASS = GKernelClass( OPR, L, R ) >
+struct Kernel {
+  static Obj *Apply( Obj * /* left */, Obj * /* right */ ) { return NULL; } // Apply()
+};
 
-void IntExpr::Print( ) { cout << mTok->value; } // IntExpr::Print()
+template < int OPR, int L, int R >
+struct Kernel< OPR, L, R, INT_KERNEL > {
+  static Obj *Apply( Obj *left, Obj *right ) {
+    return GMake( OpFn< OPR >::Int( ReadOperand< L >::Int( left ),
+                                    ReadOperand< R >::Int( right ) ) );
+  } // Apply()
+};
 
-void IntExpr::Expr( ) { cout << mValue << endl; } // IntExpr::Expr()
+template < int OPR, int L, int R, bool DEFINED = OpFn< OPR >::kFloat >
+struct FloatKernel {
+  static Obj *Apply( Obj *left, Obj *right ) {
+    return GMake( OpFn< OPR >::Float( ReadOperand< L >::Float( left ),
+                                      ReadOperand< R >::Float( right ) ) );
+  } // Apply()
+};
 
-class FloatExpr : public Expression {
-  Token *mTok;
-  float mValue;
-  string mType;
+template < int OPR, int L, int R >
+struct FloatKernel< OPR, L, R, false > : Kernel< OPR, L, R, NO_KERNEL > {
+};
 
-public:
-  FloatExpr( Token *tok, float value ) {
-    mValue = value;
-    mTok = tok;
-    mType = "Float";
-  } // FloatExpr()
+template < int OPR, int L, int R >
+struct Kernel< OPR, L, R, FLOAT_KERNEL > : FloatKernel< OPR, L, R > {
+};
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+template < int OPR, int L, int R >
+struct Kernel< OPR, L, R, CONCAT_KERNEL > {
+  static Obj *Apply( Obj *left, Obj *right ) {
+    return GMake( left -> Value() + right -> Value() );
+  } // Apply()
+};
 
-  void Print( ) ;
-  void Expr( ) ;
-  string Value( ) ;
-  Obj *Eval( Environment *env ) ;
+// The compare of the sign of string::compare() with 0
+template < int OPR, int L, int R >
+struct Kernel< OPR, L, R, TEXT_KERNEL > {
+  static Obj *Apply( Obj *left, Obj *right ) {
+    return GMake( OpFn< OPR >::Int( left -> Value().compare( right -> Value() ), 0 ) );
+  } // Apply()
 };
 
-Obj *FloatExpr::Eval( Environment *env ) {
-  Obj *result = new Float( mValue, mType ) ;
-  return result;
-} // FloatExpr::Eval()
+template < int OPR, int L, int R >
+struct Kernel< OPR, L, R, TRUTH_KERNEL > {
+  static Obj *Apply( Obj *left, Obj *right ) {
+    return GMake( OpFn< OPR >::Int( left -> Value() == "true",
+                                    right -> Value() == "true" ) );
+  } // Apply()
+};
 
-string FloatExpr::Value( ) {
-  stringstream ss;
-  ss << mValue;
-  string str = ss.str( ) ;
-  return str;
-} // FloatExpr::Value()
+template < int... IS >
+struct IndexSeq {
+};
 
-void FloatExpr::Print( ) { 
-  cout << mTok->value; 
-} // FloatExpr::Print()
+template < int N, int... IS >
+struct MakeIndexSeq : MakeIndexSeq< N - 1, N - 1, IS... > {
+};
 
-void FloatExpr::Expr( ) { 
-  cout << mValue << endl; 
-} // FloatExpr::Expr()
+template < int... IS >
+struct MakeIndexSeq< 0, IS... > {
+  typedef IndexSeq< IS... > Type;
+};
 
-class CharExpr : public Expression {
-  char mValue;
-  string mType;
+// Entry ( opr * OPERAND_COUNT + left ) * OPERAND_COUNT + right
+template < class SEQ >
+struct KernelMatrix;
+
+template < int... IS >
+struct KernelMatrix< IndexSeq< IS... > > {
+  static constexpr BinaryKernel sTable[ sizeof...( IS ) ] = {
+    &Kernel< IS / ( OPERAND_COUNT * OPERAND_COUNT ),
+             ( IS / OPERAND_COUNT ) % OPERAND_COUNT,
+             IS % OPERAND_COUNT >::Apply...
+  };
+};
 
-public:
-  CharExpr( char value ) {
-    mValue = value;
-    mType = "Char";
-  } // StringExpr()
+template < int... IS >
+constexpr BinaryKernel KernelMatrix< IndexSeq< IS... > >::sTable[ sizeof...( IS ) ];
+
+typedef KernelMatrix< MakeIndexSeq< OPERATOR_COUNT * OPERAND_COUNT *
+                                    OPERAND_COUNT >::Type > Kernels;
+
+// NULL if the operator is not defined on the operands
+inline Obj *GApply( Operator opr, Obj *left, Obj *right ) {
+  int index = ( opr * OPERAND_COUNT + kOperandOf[ left -> Kind() ] ) * OPERAND_COUNT +
+              kOperandOf[ right -> Kind() ];
+  return Kernels::sTable[ index ]( left, right );
+} // GApply()
+
+// Integer / and % by zero have no value, the evaluators report it before
+// GApply() instead of dying of SIGFPE
+bool GZeroDivisor( Operator opr, Obj *left, Obj *right ) {
+  Operand l = kOperandOf[ left -> Kind() ], r = kOperandOf[ right -> Kind() ];
+  if ( ( opr != OPR_DIV && opr != OPR_MOD ) || GKernelClass( opr, l, r ) != INT_KERNEL )
+    return false;
+  return ( r == INT_OPND ? GIntOf( right ) : GStringToInt( right -> Value() ) ) == 0;
+} // GZeroDivisor()
+
+template < bool NEGATE, int K >
+struct UnaryKernel {
+  static Obj *Apply( Obj * /* rhs */ ) { return NULL; } // Apply()
+};
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+template < bool NEGATE >
+struct UnaryKernel< NEGATE, INT_OPND > {
+  static Obj *Apply( Obj *rhs ) {
+    return GMake( NEGATE ? GIntOf( rhs ) * -1 : GIntOf( rhs ) );
+  } // Apply()
+};
 
-  void Expr( ) ;
-  void Print( ) ;
-  string Value( ) ;
-  Obj *Eval( Environment *env ) ;
+template < bool NEGATE >
+struct UnaryKernel< NEGATE, FLOAT_OPND > {
+  static Obj *Apply( Obj *rhs ) {
+    return GMake( NEGATE ? GOperandOf( rhs ) * -1.0f : GOperandOf( rhs ) );
+  } // Apply()
 };
 
-Obj *CharExpr::Eval( Environment *env ) {
-  string str = "";
-  str += mValue; 
-  Obj *result = new Char( str, "Char" ) ;
-  return result;
-} // StringExpr::Eval()
+typedef Obj *( *UnaryKernelFn )( Obj *rhs );
 
-string CharExpr::Value( ) { 
-  string str = "";
-  str += mValue;
-  return str; 
-} // StringExpr::Value()
+constexpr UnaryKernelFn kUnaryKernels[ 2 ][ OPERAND_COUNT ] = {
+  { &UnaryKernel< false, INT_OPND >::Apply, &UnaryKernel< false, FLOAT_OPND >::Apply,
+    &UnaryKernel< false, STRING_OPND >::Apply, &UnaryKernel< false, CHAR_OPND >::Apply,
+    &UnaryKernel< false, BOOL_OPND >::Apply, &UnaryKernel< false, OTHER_OPND >::Apply },
+  { &UnaryKernel< true, INT_OPND >::Apply, &UnaryKernel< true, FLOAT_OPND >::Apply,
+    &UnaryKernel< true, STRING_OPND >::Apply, &UnaryKernel< true, CHAR_OPND >::Apply,
+    &UnaryKernel< true, BOOL_OPND >::Apply, &UnaryKernel< true, OTHER_OPND >::Apply }
+};
 
-void CharExpr::Print( ) { 
-  cout << mValue; 
-} // StringExpr::Print()
+// Unary + and -, NULL if rhs is not a number
+inline Obj *GApplyUnary( bool negate, Obj *rhs ) {
+  return kUnaryKernels[ negate ][ kOperandOf[ rhs -> Kind() ] ]( rhs );
+} // GApplyUnary()
 
-void CharExpr::Expr( ) { 
-} // StringExpr::Expr()
+// --------------------------- Bytecode VM --------------------------
+// Pure arithmetic / compare subtrees ( literals, identifiers, unary +-,
+// binary operators ) are compiled to a small stack bytecode the first
+// time they are evaluated. Whenever the VM meets something it does not
+// handle ( undefined id, non number operand, int division by zero ) it
+// gives up and the tree walker evaluates the node instead, so the
+// error messages stay in one place.
 
-class StringExpr : public Expression {
-  string mValue;
-  string mType;
+// Off ( --no-vm ), every expression goes through the tree walker
+bool gUseVm = true;
 
-public:
-  StringExpr( string value ) {
-    mValue = value;
-    mType = "String";
-  } // StringExpr()
+typedef enum {
+  OP_PUSH,
+  OP_LOAD,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_SHL,
+  OP_SHR,
+  OP_CMP,
+  OP_NEG,
+  OP_LOAD_PUSH_ADD, // superinstruction : load id, push const, add
+  OP_LOAD_PUSH_CMP, // superinstruction : load id, push const, compare
+  OP_HALT,
+  OPCODE_COUNT
+} OpCode
+;
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+typedef enum {
+  VM_INT,
+  VM_FLOAT,
+  VM_BOOL
+} VmTag
+;
 
-  void Expr( ) ;
-  void Print( ) ;
-  string Value( ) ;
-  Obj *Eval( Environment *env ) ;
+struct VmValue {
+  VmTag tag;
+  int i;
+  float f;
 };
 
-Obj *StringExpr::Eval( Environment *env ) {
-  Obj *result = new String( mType, mValue ) ;
-  return result;
-} // StringExpr::Eval()
+// kVectorWidth rows of one stack slot in vector mode, see RunVector()
+const int kVectorWidth = 256;
 
-string StringExpr::Value( ) { 
-  return mValue; 
-} // StringExpr::Value()
+struct VmVector {
+  VmTag tag;
+  int i[ kVectorWidth ]; // VM_INT and VM_BOOL
+  float f[ kVectorWidth ];
+};
 
-void StringExpr::Print( ) { 
-  cout << mValue; 
-} // StringExpr::Print()
+typedef bool ( *VecCompareFn )( VmVector *l, VmVector *r, int n );
 
-void StringExpr::Expr( ) { 
-} // StringExpr::Expr()
+// A named int or float column, every column of a set has rows values
+struct Column {
+  string name;
+  VmTag tag; // VM_INT or VM_FLOAT
+  vector< int > ints;
+  vector< float > floats;
+};
 
-class CoutExpr : public Expression {
-  vector< Expression* > mArgs;
-  string mType;
+struct ColumnSet {
+  vector< Column > columns;
+  size_t rows;
+
+  ColumnSet( ) {
+    rows = 0;
+  } // ColumnSet()
+
+  // -1 if there is no such column
+  int Find( const string &name ) const {
+    for ( size_t i = 0; i < columns.size(); ++i )
+      if ( columns[ i ].name == name )
+        return i;
+    return -1;
+  } // Find()
+};
 
-public:
-  CoutExpr( ) {
-    mType = "Cout Expression";
-  } // CoutExpr()
+// Where each name of a Bytecode comes from in vector mode
+struct VectorBinding {
+  vector< const Column * > columns; // NULL when the name is a constant
+  vector< VmValue > constants; // Its value then
+};
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+typedef bool ( *VmCompareFn )( VmValue *l, VmValue *r );
 
-  string Value( ) { 
-    return ""; 
-  } // Value()
+struct Instr {
+  OpCode op;
+  VmCompareFn cmp; // compare kernel of OP_CMP and OP_LOAD_PUSH_CMP
+  VecCompareFn vcmp; // its vector mode kernel
+  int slot; // index into Bytecode names
+  VmValue k; // constant of OP_PUSH and the superinstructions
+  void *target; // handler address once the code is threaded
+};
 
-  void Expr( ) { } // Expr() 
+// Float operands are rounded as the tree walker reads them, GReadBack()
+float GToFloat( VmValue v ) {
+  if ( v.tag == VM_FLOAT )
+    return GReadBack( v.f );
+  return v.i;
+} // GToFloat()
+
+// Binary operator on two numbers, the result goes to l. false means give up
+template < int OPR, bool DEFINED = OpFn< OPR >::kFloat >
+struct VmArith {
+  static bool Apply( VmValue *l, VmValue *r ) {
+    if ( l -> tag == VM_BOOL || r -> tag == VM_BOOL )
+      return false;
 
-  void Print( ) ;
-  void Append( Expression* expr );
-  Obj *Eval( Environment *env ) ;
+    if ( l -> tag == VM_INT && r -> tag == VM_INT ) {
+      l -> i = OpFn< OPR >::Int( l -> i, r -> i );
+      return true;
+    } // if
 
+    l -> f = OpFn< OPR >::Float( GToFloat( *l ), GToFloat( *r ) );
+    l -> tag = VM_FLOAT;
+    return true;
+  } // Apply()
 };
 
-void CoutExpr::Append( Expression* expr ) {
-  mArgs.push_back(expr);
-} // CoutExpr::Append() 
-
-Obj *CoutExpr::Eval( Environment *env ) {
-  Obj* obj = NULL; 
-  for ( int i = 0; i < mArgs.size(); ++i ) {
-    obj = mArgs[i] -> Eval( env );
-    obj -> Inspect();
-  } // for
+template < int OPR >
+struct VmArith< OPR, false > {
+  static bool Apply( VmValue *l, VmValue *r ) {
+    if ( l -> tag != VM_INT || r -> tag != VM_INT )
+      return false;
+    l -> i = OpFn< OPR >::Int( l -> i, r -> i );
+    return true;
+  } // Apply()
+};
 
-  return obj;
-} // CoutExpr::Eval()
+template < int OPR >
+bool GVmCompare( VmValue *l, VmValue *r ) {
+  if ( l -> tag == VM_BOOL || r -> tag == VM_BOOL )
+    return false;
 
-void CoutExpr::Print() {
-  cout << "cout << ";
-  for ( int i = 0; i < mArgs.size(); ++i ) {
-    mArgs[i] -> Print();
-    if ( i + 1 < mArgs.size() )
-      cout << " << ";
-  } // for
-  cout << ";\n";
-} // CoutExpr::Print()
+  bool result = false;
+  if ( l -> tag == VM_FLOAT || r -> tag == VM_FLOAT )
+    result = OpFn< OPR >::Float( GToFloat( *l ), GToFloat( *r ) );
+  else
+    result = OpFn< OPR >::Int( l -> i, r -> i );
 
-class BinExpr : public Expression {
-  Expression *mLeft;
-  Token *mOp;
-  Expression *mRight;
-  string mType;
+  l -> tag = VM_BOOL;
+  l -> i = result;
+  return true;
+} // GVmCompare()
 
-public:
-  BinExpr( Expression *left, Token *op, Expression *right ) {
-    mLeft = left;
-    mOp = op;
-    mRight = right;
-    mType = "Binary Expression";
-  } // BinExpr()
+constexpr VmCompareFn kVmCompares[ OPERATOR_COUNT ] = {
+  NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  &GVmCompare< OPR_LT >, &GVmCompare< OPR_GT >, &GVmCompare< OPR_LTEQ >,
+  &GVmCompare< OPR_GTEQ >, &GVmCompare< OPR_EQ >, &GVmCompare< OPR_NOT_EQ >
+};
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+// The vector kernels are plain loops over the rows of a batch, left to
+// the compiler to turn into SIMD. They give up on the same operands as
+// the scalar ones.
+// Makes v a float operand : ints are widened, floats rounded the way
+// GToFloat() rounds them
+void GVecWiden( VmVector *v, int n ) {
+  if ( v -> tag == VM_FLOAT ) {
+    for ( int k = 0; k < n; ++k )
+      v -> f[ k ] = GReadBack( v -> f[ k ] );
+    return;
+  } // if
 
-  string Value( ) { 
-    return ""; 
-  } // Value()
+  for ( int k = 0; k < n; ++k )
+    v -> f[ k ] = v -> i[ k ];
+  v -> tag = VM_FLOAT;
+} // GVecWiden()
 
-  void Expr( ) ;
-  void Print( ) ;
+template < int OPR, bool DEFINED = OpFn< OPR >::kFloat >
+struct VecArith {
+  static bool Apply( VmVector *l, VmVector *r, int n ) {
+    if ( l -> tag == VM_BOOL || r -> tag == VM_BOOL )
+      return false;
 
-  Obj *Eval( Environment *env ) ;
-  Obj *EvalCompare( Obj *left, Obj *right ) ;
-  Obj *EvalArithmatic( Obj *left, Obj *right ) ;
+    if ( l -> tag == VM_INT && r -> tag == VM_INT ) {
+      int *__restrict li = l -> i;
+      const int *__restrict ri = r -> i;
+      for ( int k = 0; k < n; ++k )
+        li[ k ] = OpFn< OPR >::Int( li[ k ], ri[ k ] );
+      return true;
+    } // if
 
+    GVecWiden( l, n );
+    GVecWiden( r, n );
+    float *__restrict lf = l -> f;
+    const float *__restrict rf = r -> f;
+    for ( int k = 0; k < n; ++k )
+      lf[ k ] = OpFn< OPR >::Float( lf[ k ], rf[ k ] );
+    return true;
+  } // Apply()
 };
 
-Obj *BinExpr::EvalArithmatic( Obj *left, Obj *right ) {
-  Obj *res = NULL;
-  string leftType = left->Type( ) ;
-  string rightType = right->Type( ) ;
-  string rightValue = right->Value( ) ;
-  string leftValue = left->Value( ) ;
-
-  if ( leftType == "String" || rightType == "String" ) {
-    string result;
-    if ( mOp->type == PLUS )
-      result = leftValue + rightValue;
+template < int OPR >
+struct VecArith< OPR, false > {
+  static bool Apply( VmVector *l, VmVector *r, int n ) {
+    if ( l -> tag != VM_INT || r -> tag != VM_INT )
+      return false;
+    int *__restrict li = l -> i;
+    const int *__restrict ri = r -> i;
+    for ( int k = 0; k < n; ++k )
+      li[ k ] = OpFn< OPR >::Int( li[ k ], ri[ k ] );
+    return true;
+  } // Apply()
+};
 
-    else { 
-      cout << "Incompatible type between " 
-           <<  leftType << " and " << rightType << endl; 
-      return NULL;
-    } // else 
-  
-    res = new String( "String", result ) ;
-  } // if
-
-
-  else if ( leftType == "Float" || rightType == "Float" ) {
-    float left_value = GStringToFloat( leftValue ) ;
-    float right_value = GStringToFloat( rightValue ) ;
-    float result;
-    if ( mOp->type == PLUS )
-      result = left_value + right_value;
-
-    else if ( mOp->type == MINUS )
-      result = left_value - right_value;
-
-    else if ( mOp->type == DIVIDE )
-      result = left_value / right_value;
-
-    else if ( mOp->type == MULTIPLY )
-      result = left_value * right_value;
-
-    res = new Float( result, "Float" ) ;
+// Integer / and % give up on a zero anywhere in the batch
+bool GVecHasZero( VmVector *l, VmVector *r, int n ) {
+  if ( l -> tag != VM_INT || r -> tag != VM_INT )
+    return false;
+  bool zero = false;
+  for ( int k = 0; k < n; ++k )
+    zero = zero | ( r -> i[ k ] == 0 );
+  return zero;
+} // GVecHasZero()
+
+template < int OPR >
+bool GVecCompare( VmVector *l, VmVector *r, int n ) {
+  if ( l -> tag == VM_BOOL || r -> tag == VM_BOOL )
+    return false;
+
+  int *__restrict li = l -> i;
+  if ( l -> tag == VM_FLOAT || r -> tag == VM_FLOAT ) {
+    GVecWiden( l, n );
+    GVecWiden( r, n );
+    const float *__restrict lf = l -> f;
+    const float *__restrict rf = r -> f;
+    for ( int k = 0; k < n; ++k )
+      li[ k ] = OpFn< OPR >::Float( lf[ k ], rf[ k ] );
   } // if
-
   else {
-    int left_value = GStringToInt( leftValue ) ;
-    int right_value = GStringToInt( rightValue ) ;
-    int result;
-    if ( mOp->type == PLUS )
-      result = left_value + right_value;
-
-    else if ( mOp->type == MINUS )
-      result = left_value - right_value;
-
-    else if ( mOp->type == DIVIDE )
-      result = left_value / right_value;
+    const int *__restrict ri = r -> i;
+    for ( int k = 0; k < n; ++k )
+      li[ k ] = OpFn< OPR >::Int( li[ k ], ri[ k ] );
+  } // else
 
-    else if ( mOp->type == MULTIPLY )
-      result = left_value * right_value;
+  l -> tag = VM_BOOL;
+  return true;
+} // GVecCompare()
 
-    else if ( mOp -> type == MODULO )
-      result = left_value % right_value;
+constexpr VecCompareFn kVecCompares[ OPERATOR_COUNT ] = {
+  NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  &GVecCompare< OPR_LT >, &GVecCompare< OPR_GT >, &GVecCompare< OPR_LTEQ >,
+  &GVecCompare< OPR_GTEQ >, &GVecCompare< OPR_EQ >, &GVecCompare< OPR_NOT_EQ >
+};
 
-    else if ( mOp -> type == RIGHT_SHIFT )
-      result = left_value >> right_value;
-  
-    else if ( mOp -> type == LEFT_SHIFT )
-      result = left_value << right_value;
+constexpr OpCode kOpCodeOf[ OPERATOR_COUNT ] = {
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_SHL, OP_SHR,
+  OP_CMP, OP_CMP, OP_CMP, OP_CMP, OP_CMP, OP_CMP
+};
 
-    res = new Integer( result, "Integer" ) ;
-  } // else
+// Immutable once finished, so threads can run the same code at once
+class Bytecode {
+  vector< Instr > mCode;
+  vector< string > mNames;
+  int mDepth;
+  int mMaxDepth;
 
-  return res;
-} // BinExpr::EvalArithmatic()
+  void Emit( Instr ins, int effect ) ;
+  bool Load( Environment *env, int slot, VmValue *out ) const ;
 
-Obj *BinExpr::EvalCompare( Obj *left, Obj *right ) {
-  Obj *res = NULL;
-  string leftType = left->Type( ) ;
-  string rightType = right->Type( ) ;
-  string rightValue = right->Value( ) ;
-  string leftValue = left->Value( ) ;
-  bool result = true;
-  float epsilon = 0.0001;
+public:
+  Bytecode( ) {
+    mDepth = 0;
+    mMaxDepth = 0;
+  } // Bytecode()
+
+  void EmitPush( VmValue k ) ;
+  void EmitLoad( string name ) ;
+  void EmitOp( Operator opr ) ;
+  void EmitNeg( ) ;
+  void Finish( ) ;
+  Obj *Run( Environment *env ) ;
+
+  bool BindColumns( const ColumnSet &set, Environment *env, 
+                    VectorBinding *binding ) const ;
+  bool RunVector( const VectorBinding &binding, size_t begin, int n, 
+                  VmVector *out ) const ;
+
+  // Its size and what it holds on the heap
+  size_t HeapBytes( ) const {
+    size_t bytes = sizeof( *this ) + GHeapBytes( mCode ) + GHeapBytes( mNames );
+    for ( size_t i = 0; i < mNames.size(); ++i )
+      bytes += GHeapBytes( mNames[ i ] );
+    return bytes;
+  } // HeapBytes()
+};
 
-  if ( leftType == "Float" || rightType == "Float" ) {
-    float left_value = GStringToFloat( leftValue ) ;
-    float right_value = GStringToFloat( rightValue ) ;  
-    result = GCompareFloats( left_value, right_value, epsilon, mOp -> type ); 
+void Bytecode::Emit( Instr ins, int effect ) {
+  ins.target = NULL;
+  mCode.push_back( ins );
+  mDepth += effect;
+  if ( mDepth > mMaxDepth )
+    mMaxDepth = mDepth;
+} // Bytecode::Emit()
+
+void Bytecode::EmitPush( VmValue k ) {
+  Instr ins;
+  ins.op = OP_PUSH;
+  ins.k = k;
+  Emit( ins, 1 );
+} // Bytecode::EmitPush()
+
+void Bytecode::EmitLoad( string name ) {
+  size_t slot = 0;
+  while ( slot < mNames.size() && mNames[ slot ] != name )
+    slot++;
+  if ( slot == mNames.size() )
+    mNames.push_back( name );
+
+  Instr ins;
+  ins.op = OP_LOAD;
+  ins.slot = slot;
+  Emit( ins, 1 );
+} // Bytecode::EmitLoad()
+
+// Fuse "load id, push const, add/compare" into a single instruction
+void Bytecode::EmitOp( Operator opr ) {
+  OpCode op = kOpCodeOf[ opr ];
+  VmCompareFn cmp = kVmCompares[ opr ];
+  VecCompareFn vcmp = kVecCompares[ opr ];
+  int size = mCode.size();
+  if ( ( op == OP_ADD || op == OP_CMP ) && size >= 2 &&
+       mCode[ size - 2 ].op == OP_LOAD && mCode[ size - 1 ].op == OP_PUSH ) {
+    Instr &fused = mCode[ size - 2 ];
+    fused.op = ( op == OP_ADD ) ? OP_LOAD_PUSH_ADD : OP_LOAD_PUSH_CMP;
+    fused.cmp = cmp;
+    fused.vcmp = vcmp;
+    fused.k = mCode[ size - 1 ].k;
+    mCode.pop_back();
+    mDepth -= 1;
+    return;
   } // if
 
-  else {
-    int left_value = GStringToInt( leftValue ) ;
-    int right_value = GStringToInt( rightValue ) ;
-    result = GCompareInts( left_value, right_value, mOp -> type );
-  } // else
+  Instr ins;
+  ins.op = op;
+  ins.cmp = cmp;
+  ins.vcmp = vcmp;
+  Emit( ins, -1 );
+} // Bytecode::EmitOp()
+
+void Bytecode::EmitNeg( ) {
+  Instr ins;
+  ins.op = OP_NEG;
+  Emit( ins, 0 );
+} // Bytecode::EmitNeg()
+
+void Bytecode::Finish( ) {
+  Instr ins;
+  ins.op = OP_HALT;
+  Emit( ins, 0 );
+  Run( NULL ); // Resolves the dispatch targets
+} // Bytecode::Finish()
+
+bool Bytecode::Load( Environment *env, int slot, VmValue *out ) const {
+  Obj *obj = env -> Get( mNames[ slot ] );
+  if ( obj == NULL )
+    return false;
+
+  ObjKind kind = obj -> Kind();
+  if ( kind == INT_KIND ) {
+    out -> tag = VM_INT;
+    out -> i = GIntOf( obj );
+  } // if
 
-  res = new Boolean( result, "Boolean" ) ;
-  return res;
-} // BinExpr::EvalCompare() 
+  else if ( kind == FLOAT_KIND ) {
+    out -> tag = VM_FLOAT;
+    out -> f = GFloatOf( obj );
+  } // else if
 
-Obj *BinExpr::Eval( Environment *env ) {
-  Obj *result = NULL;
-  Obj *left = mLeft->Eval( env ) ;
-  Obj *right = mRight->Eval( env ) ;
-  if ( left == NULL || right == NULL ) {
-    string undefined = "";
-    if ( left == NULL ) 
-      undefined = mLeft -> Value();
-    else if ( right == NULL )
-      undefined = mRight -> Value(); 
+  else
+    return false;
 
-    cout << "Undefined identifier : '" << undefined << "'\n";
+  return true;
+} // Bytecode::Load()
+
+# ifdef USE_COMPUTED_GOTO
+# define VM_CASE( op ) L_##op:
+# define VM_NEXT( ) goto *( ++ip ) -> target
+# else
+# define VM_CASE( op ) case op:
+# define VM_NEXT( ) ++ip; break
+# endif
+
+// Returns NULL when the tree walker has to take over
+// With a NULL env only prepares the code, see Finish()
+Obj *Bytecode::Run( Environment *env ) {
+# ifdef USE_COMPUTED_GOTO
+  static void *labels[ OPCODE_COUNT ] = {
+    &&L_OP_PUSH, &&L_OP_LOAD, &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL,
+    &&L_OP_DIV, &&L_OP_MOD, &&L_OP_SHL, &&L_OP_SHR, &&L_OP_CMP,
+    &&L_OP_NEG, &&L_OP_LOAD_PUSH_ADD, &&L_OP_LOAD_PUSH_CMP, &&L_OP_HALT
+  };
+
+  if ( env == NULL ) {
+    for ( size_t i = 0; i < mCode.size(); ++i )
+      mCode[ i ].target = labels[ mCode[ i ].op ];
     return NULL;
   } // if
+# else
+  if ( env == NULL )
+    return NULL;
+# endif
+
+  // Operand stack of the running thread
+  static thread_local vector< VmValue > stack;
+  if ( stack.size() <= ( size_t ) mMaxDepth )
+    stack.resize( mMaxDepth + 1 );
+
+  Instr *ip = &mCode[ 0 ];
+  VmValue *sp = &stack[ 0 ];
+
+# ifdef USE_COMPUTED_GOTO
+  goto *ip -> target;
+# else
+  for ( ; ; ) {
+    switch ( ip -> op ) {
+# endif
+
+  VM_CASE( OP_PUSH ) {
+    *sp++ = ip -> k;
+    VM_NEXT();
+  } // OP_PUSH
+
+  VM_CASE( OP_LOAD ) {
+    if ( ! Load( env, ip -> slot, sp ) )
+      return NULL;
+    sp++;
+    VM_NEXT();
+  } // OP_LOAD
 
-  string leftType = left->Type( ) ;
-  string rightType = right->Type( ) ;
+  VM_CASE( OP_ADD ) {
+    if ( ! VmArith< OPR_ADD >::Apply( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_ADD
 
-  if ( mOp->type == PLUS || mOp->type == MINUS || mOp->type == DIVIDE ||
-       mOp->type == MULTIPLY || mOp->type == LEFT_SHIFT || mOp -> type == RIGHT_SHIFT )
-    result = EvalArithmatic( left, right ) ;
-  else if ( mOp->type == LT || mOp->type == GT || 
-            mOp->type == EQ || mOp->type == GTEQ || 
-            mOp -> type == LTEQ || mOp->type == NOT_EQ )
-    result = EvalCompare( left, right ) ;
+  VM_CASE( OP_SUB ) {
+    if ( ! VmArith< OPR_SUB >::Apply( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_SUB
 
-  return result;
-} // BinExpr::Eval()
+  VM_CASE( OP_MUL ) {
+    if ( ! VmArith< OPR_MUL >::Apply( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_MUL
 
-void BinExpr::Print( ) {
-  cout << "(";
-  mLeft->Print( ) ;
-  cout << mOp->value;
-  mRight->Print( ) ;
-  cout << ")";
-} // BinExpr::Print()
+  VM_CASE( OP_DIV ) {
+    if ( sp[ -1 ].tag == VM_INT && sp[ -2 ].tag == VM_INT && sp[ -1 ].i == 0 )
+      return NULL;
+    if ( ! VmArith< OPR_DIV >::Apply( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_DIV
 
-void BinExpr::Expr( ) { } // BinExpr::Expr()
+  VM_CASE( OP_MOD ) {
+    if ( sp[ -1 ].tag == VM_INT && sp[ -2 ].tag == VM_INT && sp[ -1 ].i == 0 )
+      return NULL;
+    if ( ! VmArith< OPR_MOD >::Apply( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_MOD
 
-class BooleanExpression : public Expression {
-  Token *mTok;
-  string mValue;
-  string mType;
+  VM_CASE( OP_SHL ) {
+    if ( ! VmArith< OPR_SHL >::Apply( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_SHL
 
-public:
-  BooleanExpression( Token *tok, string val ) {
-    mValue = val;
-    mTok = tok;
-    mType = "Boolean";
-  } // SymbolExpression()
+  VM_CASE( OP_SHR ) {
+    if ( ! VmArith< OPR_SHR >::Apply( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_SHR
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+  VM_CASE( OP_CMP ) {
+    if ( ! ip -> cmp( sp - 2, sp - 1 ) )
+      return NULL;
+    sp--;
+    VM_NEXT();
+  } // OP_CMP
+
+  VM_CASE( OP_NEG ) {
+    if ( sp[ -1 ].tag == VM_INT )
+      sp[ -1 ].i = sp[ -1 ].i * -1;
+    else if ( sp[ -1 ].tag == VM_FLOAT )
+      sp[ -1 ].f = GReadBack( sp[ -1 ].f ) * -1.0f;
+    else
+      return NULL;
+    VM_NEXT();
+  } // OP_NEG
 
-  string Value( ) { 
-    return mValue; 
-  } // Value()
+  VM_CASE( OP_LOAD_PUSH_ADD ) {
+    VmValue k = ip -> k;
+    if ( ! Load( env, ip -> slot, sp ) || ! VmArith< OPR_ADD >::Apply( sp, &k ) )
+      return NULL;
+    sp++;
+    VM_NEXT();
+  } // OP_LOAD_PUSH_ADD
 
-  void Expr( ) { 
-  } // Expr()
+  VM_CASE( OP_LOAD_PUSH_CMP ) {
+    VmValue k = ip -> k;
+    if ( ! Load( env, ip -> slot, sp ) || ! ip -> cmp( sp, &k ) )
+      return NULL;
+    sp++;
+    VM_NEXT();
+  } // OP_LOAD_PUSH_CMP
+
+  VM_CASE( OP_HALT ) {
+    VmValue top = sp[ -1 ];
+    if ( top.tag == VM_INT )
+      return new Integer( top.i, "Integer" );
+    else if ( top.tag == VM_FLOAT )
+      return new Float( top.f, "Float" );
+    return new Boolean( top.i != 0, "Boolean" );
+  } // OP_HALT
+
+# ifndef USE_COMPUTED_GOTO
+      default :
+        return NULL;
+    } // switch
+  } // for
+# endif
 
-  void Print( ) ;
+  return NULL;
+} // Bytecode::Run()
+
+# undef VM_CASE
+# undef VM_NEXT
+
+// ---------------------------- Vector VM -------------------
+// --columns and Program::Evaluate run a compiled expression over whole
+// columns : each instruction handles kVectorWidth rows at once instead of
+// one row per dispatch. A name is a column or, failing that, a number in
+// the environment, which every row sees the same.
+bool Bytecode::BindColumns( const ColumnSet &set, Environment *env, 
+                            VectorBinding *binding ) const {
+  binding -> columns.assign( mNames.size(), NULL );
+  binding -> constants.resize( mNames.size() );
+  for ( size_t slot = 0; slot < mNames.size(); ++slot ) {
+    int column = set.Find( mNames[ slot ] );
+    if ( column >= 0 )
+      binding -> columns[ slot ] = &set.columns[ column ];
+    else if ( ! Load( env, slot, &binding -> constants[ slot ] ) )
+      return false;
+  } // for
 
-  Obj *Eval( Environment *env ) ;
-};
+  return true;
+} // Bytecode::BindColumns()
+
+void GVecLoad( const VectorBinding &binding, int slot, size_t begin, int n, 
+               VmVector *out ) {
+  const Column *column = binding.columns[ slot ];
+  if ( column == NULL ) {
+    VmValue k = binding.constants[ slot ];
+    out -> tag = k.tag;
+    for ( int j = 0; j < n; ++j ) {
+      out -> i[ j ] = k.i;
+      out -> f[ j ] = k.f;
+    } // for
+  } // if
+  else if ( column -> tag == VM_INT ) {
+    out -> tag = VM_INT;
+    memcpy( out -> i, &column -> ints[ begin ], n * sizeof( int ) );
+  } // else if
+  else {
+    out -> tag = VM_FLOAT;
+    memcpy( out -> f, &column -> floats[ begin ], n * sizeof( float ) );
+  } // else
+} // GVecLoad()
 
-void BooleanExpression::Print() {
-  cout << mValue;
-} // SymbolExpression::Print()
+void GVecPush( VmValue k, int n, VmVector *out ) {
+  out -> tag = k.tag;
+  for ( int j = 0; j < n; ++j ) {
+    out -> i[ j ] = k.i;
+    out -> f[ j ] = k.f;
+  } // for
+} // GVecPush()
+
+// Rows [ begin, begin + n ) into out, n <= kVectorWidth. false where the
+// scalar VM would give up, those rows are for the tree walker.
+bool Bytecode::RunVector( const VectorBinding &binding, size_t begin, int n, 
+                          VmVector *out ) const {
+  static thread_local vector< VmVector > stack;
+  if ( stack.size() < ( size_t ) mMaxDepth + 2 )
+    stack.resize( mMaxDepth + 2 );
+
+  VmVector *sp = &stack[ 0 ];
+  for ( const Instr *ip = &mCode[ 0 ]; ; ++ip ) {
+    bool ok = true;
+    switch ( ip -> op ) {
+      case OP_PUSH : GVecPush( ip -> k, n, sp++ ); break;
+      case OP_LOAD : GVecLoad( binding, ip -> slot, begin, n, sp++ ); break;
+      case OP_ADD : ok = VecArith< OPR_ADD >::Apply( sp - 2, sp - 1, n ); sp--; break;
+      case OP_SUB : ok = VecArith< OPR_SUB >::Apply( sp - 2, sp - 1, n ); sp--; break;
+      case OP_MUL : ok = VecArith< OPR_MUL >::Apply( sp - 2, sp - 1, n ); sp--; break;
+      case OP_DIV :
+        ok = ! GVecHasZero( sp - 2, sp - 1, n ) && 
+             VecArith< OPR_DIV >::Apply( sp - 2, sp - 1, n );
+        sp--;
+        break;
+      case OP_MOD :
+        ok = ! GVecHasZero( sp - 2, sp - 1, n ) && 
+             VecArith< OPR_MOD >::Apply( sp - 2, sp - 1, n );
+        sp--;
+        break;
+      case OP_SHL : ok = VecArith< OPR_SHL >::Apply( sp - 2, sp - 1, n ); sp--; break;
+      case OP_SHR : ok = VecArith< OPR_SHR >::Apply( sp - 2, sp - 1, n ); sp--; break;
+      case OP_CMP : ok = ip -> vcmp( sp - 2, sp - 1, n ); sp--; break;
+      case OP_NEG :
+        if ( sp[ -1 ].tag == VM_INT )
+          for ( int k = 0; k < n; ++k )
+            sp[ -1 ].i[ k ] = sp[ -1 ].i[ k ] * -1;
+        else if ( sp[ -1 ].tag == VM_FLOAT )
+          for ( int k = 0; k < n; ++k )
+            sp[ -1 ].f[ k ] = GReadBack( sp[ -1 ].f[ k ] ) * -1.0f;
+        else
+          ok = false;
+        break;
+      case OP_LOAD_PUSH_ADD :
+        GVecLoad( binding, ip -> slot, begin, n, sp );
+        GVecPush( ip -> k, n, sp + 1 );
+        ok = VecArith< OPR_ADD >::Apply( sp, sp + 1, n );
+        sp++;
+        break;
+      case OP_LOAD_PUSH_CMP :
+        GVecLoad( binding, ip -> slot, begin, n, sp );
+        GVecPush( ip -> k, n, sp + 1 );
+        ok = ip -> vcmp( sp, sp + 1, n );
+        sp++;
+        break;
+      case OP_HALT : 
+        *out = sp[ -1 ];
+        return true;
+      default :
+        return false;
+    } // switch
+
+    if ( ! ok )
+      return false;
+  } // for
+} // Bytecode::RunVector()
+
+// ---------------------------- AST image -------------------
+// A parsed program written out so it can run without lexing or parsing.
+// Nodes go through AstWriter / AstReader field by field, a field is
+// named so the JSON form can key on it, the binary form only keeps the
+// order : the header, then the nodes in pre-order.
+//   header : "PAST", u32 version
+//   node   : u8 NodeKind, span, then the fields of that kind
+//   span   : line, column, end line, end column
+//   token  : u8 present, type, string value, line, column
+//   string : size, bytes
+//   list   : count, elements
+// Integers are zigzag varints, floats are stored as their bits.
+// kAstVersion must be bumped whenever a node layout or TokenType changes.
+typedef enum {
+  BLOCK_NODE,
+  CONDITIONAL_NODE,
+  INT_NODE,
+  FLOAT_NODE,
+  CHAR_NODE,
+  STRING_NODE,
+  COUT_NODE,
+  CIN_NODE,
+  BIN_NODE,
+  BOOLEAN_NODE,
+  ARRAY_NODE,
+  SYMBOL_NODE,
+  UPDATE_NODE,
+  PARAMETER_NODE,
+  FUNCTION_DECL_NODE,
+  CALL_NODE,
+  DECLARATION_NODE,
+  UNARY_NODE,
+  RETURN_NODE,
+  ASSIGNMENT_NODE,
+  PROGRAM_NODE,
+  EXPRESSION_STMT_NODE,
+  NULL_STMT_NODE,
+  NO_NODE // A missing child
+} NodeKind
+;
 
-Obj *BooleanExpression::Eval( Environment *env ) {
-  bool result = false;
-  if ( mValue == "true" )
-    result = true;
+const char kAstMagic[ 4 ] = { 'P', 'A', 'S', 'T' };
+const unsigned int kAstVersion = 3;
 
-  Obj *var = NULL;
-  var = new Boolean( result, "Boolean" );
-  return var;
-} // SymbolExpression::Eval()
+// Names used by the JSON form
+const char *const kNodeKindNames[ NO_NODE ] = {
+  "Block", "Conditional", "Int", "Float", "Char", "String", "Cout", 
+  "Cin", "Binary", "Boolean", "Array", "Symbol", "Update", "Parameter", 
+  "FunctionDeclaration", "Call", "Declaration", "Unary", "Return", 
+  "Assignment", "Program", "ExpressionStatement", "NullStatement"
+};
 
+const char *const kTokenTypeNames[ TOKEN_TYPE_COUNT ] = {
+  "ILLEGAL", "EOFF", "IDENT", "FLOAT", "INT", "ASSIGN", "PLUS", "PLUSPLUS",
+  "MINUSMINUS", "MINUS", "MULTIPLY", "DIVIDE", "COMMA", "SEMICOLON", 
+  "LPAREN", "RPAREN", "LBRACE", "RBRACE", "LBRACKET", "RBRACKET", "MODULO",
+  "LT", "GT", "LTEQ", "GTEQ", "EQ", "NOT_EQ", "NOT", "LEFT_SHIFT", 
+  "RIGHT_SHIFT", "AND", "ANDAND", "PASSREF", "OR", "OROR", "PLUS_EQ",
+  "MINUS_EQ", "MULTI_EQ", "DIVIDE_EQ", "STRING", "CHAR", "COUT", "CIN", 
+  "KEY_TRUE", "KEY_FALSE", "KEY_IF", "KEY_ELSE", "KEY_ELIF", "KEY_INT",
+  "KEY_STRING", "KEY_FLOAT", "KEY_BOOL", "KEY_VOID", "KEY_RETURN", 
+  "KEY_DO", "KEY_WHILE", "KEY_CHAR"
+};
 
-class DeclareArrayExpression : public Expression {
-  Token *mTok;
-  Expression* mSize;
-  string mValue;
-  string mType;
+static_assert( sizeof( kTokenTypeNames ) / sizeof( kTokenTypeNames[ 0 ] ) == TOKEN_TYPE_COUNT,
+               "kTokenTypeNames must name every TokenType" );
+
+// Source range of a node, from the start of its first token to the start
+// of its last one, 1-based. Zero when unknown, e.g. for nodes not built by
+// ParseExpression or ParseStatement.
+struct Span {
+  int line;
+  int column;
+  int endLine;
+  int endColumn;
+
+  Span( ) {
+    line = column = endLine = endColumn = 0;
+  } // Span()
+};
 
+class AstWriter {
 public:
-  DeclareArrayExpression( Token *tok, string val, Expression* size ) {
-    mValue = val;
-    mTok = tok;
-    mSize=  size;
-    mType = "Array Expression";
-  } // SymbolExpression()
+  virtual ~AstWriter( ) { } // ~AstWriter()
+
+  virtual void BeginNode( NodeKind kind, const Span &span ) = 0;
+  virtual void EndNode( ) = 0;
+  virtual void WriteInt( const char *field, long long v ) = 0;
+  virtual void WriteFloat( const char *field, float v ) = 0;
+  virtual void WriteString( const char *field, const string &str ) = 0;
+  virtual void WriteToken( const char *field, Token *tok ) = 0;
+  virtual void WriteNode( const char *field, Node *node ) = 0;
+  virtual void BeginList( const char *field, size_t count ) = 0;
+  virtual void EndList( ) = 0;
+};
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+// Values out of range, missing fields or children of the wrong kind only
+// mark the reader bad, so a damaged image is rejected instead of run
+class AstReader {
+protected:
+  bool mBad;
 
-  string Value( ) { 
-    return mValue; 
-  } // Value()
+  // Enter the node in field, false if there is none
+  virtual bool BeginNode( const char *field, NodeKind &kind, Span &span ) = 0;
+  virtual void EndNode( ) = 0;
 
-  void Expr( ) { 
-  } // Expr()
+public:
+  AstReader( ) {
+    mBad = false;
+  } // AstReader()
 
-  void Print( ) ;
-  
-  Obj *Eval( Environment *env ) ;
-} ;
+  virtual ~AstReader( ) { } // ~AstReader()
 
-void DeclareArrayExpression::Print() {
-  cout << mValue << "[";
-  mSize -> Print();
-  cout << "]"; 
-} // DeclareArrayExpression() 
+  virtual long long ReadInt( const char *field ) = 0;
+  virtual float ReadFloat( const char *field ) = 0;
+  virtual string ReadString( const char *field ) = 0;
+  // Once the reader is bad a placeholder is returned, so node
+  // constructors never see a NULL token they do not expect
+  virtual Token *ReadToken( const char *field, bool optional = false ) = 0;
+  virtual size_t BeginList( const char *field ) = 0;
+  virtual void EndList( ) = 0;
 
-Obj *DeclareArrayExpression::Eval( Environment *env ) {
-  int size = 0; 
-  Obj* msize = mSize -> Eval( env );
-  size = GStringToInt( msize -> Value() );
-  cout << size;
+  Node *ReadNode( const char *field ) ;
 
-  for ( int i = 0; i < size; ++i ) {
-    stringstream ss;
-    ss << i;
-    string index = ss.str();
-    index = mValue + "[" + index + "]";
+  template< class T >
+  T *ReadNodeAs( const char *field, bool optional = false ) ;
 
-    env -> Set( index, NULL );
-  } // for
+  bool Bad( ) {
+    return mBad;
+  } // Bad()
+};
 
-  return msize;
-} // DeclareArrayExpression::Eval()
+// ------------------------------- Node ---------------------------
 
-class SymbolExpression : public Expression {
-  Token *mTok;
-  string mValue;
+class Node {
   string mType;
+  Span mSpan;
 
 public:
-  SymbolExpression( Token *tok, string val ) {
-    mValue = val;
-    mTok = tok;
-    mType = "Symbol Expression";
-  } // SymbolExpression()
+  virtual ~Node( ) { } // ~Node()
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+  void SetSpan( const Span &span ) {
+    mSpan = span;
+  } // SetSpan()
 
-  string Value( ) { 
-    return mValue; 
-  } // Value()
+  void SetSpan( Token *first, Token *last ) ;
 
-  void Expr( ) { 
-  } // Expr()
+  const Span &GetSpan( ) {
+    return mSpan;
+  } // GetSpan()
 
-  void Print( ) ;
-  
+  static void *operator new( size_t size ) ;
+  static void operator delete( void *mem ) ;
+
+  virtual void Print( ) = 0;
+  virtual string Type( ) = 0;
+  virtual string Value( ) = 0;
+
+  // Evaluate the node, through the profiler when one is running
   Obj *Eval( Environment *env ) ;
-};
+  virtual Obj *EvalNode( Environment *env ) = 0;
 
-void SymbolExpression::Print() {
-  cout << mValue;
-} // SymbolExpression::Print()
+  // Write this node and its children to an AST image
+  virtual void Serialize( AstWriter *out ) = 0;
 
-Obj *SymbolExpression::Eval( Environment *env ) {
-  Obj *var = NULL;
-  var = env->Get( mValue ) ;
-  return var;
-} // SymbolExpression::Eval()
+  // What the strings and vectors of this node hold on the heap, see
+  // AstPool::Bytes()
+  virtual size_t HeapBytes( ) {
+    return GHeapBytes( Type() ) + GHeapBytes( Value() );
+  } // HeapBytes()
+};
+
+ALLOC_FN void *Node::operator new( size_t size ) {
+  STAT( ++gStats.nodes );
+  void *mem = ::operator new( size );
+  if ( gAstPool != NULL )
+    gAstPool -> AdoptNode( ( Node * ) mem, size );
+  return mem;
+} // Node::operator new()
+
+ALLOC_FN void Node::operator delete( void *mem ) {
+  ::operator delete( mem );
+} // Node::operator delete()
+
+void Node::SetSpan( Token *first, Token *last ) {
+  if ( first == NULL || last == NULL )
+    return;
+
+  mSpan.line = first -> line;
+  mSpan.column = first -> column;
+  mSpan.endLine = last -> line;
+  mSpan.endColumn = last -> column;
+} // Node::SetSpan()
+
+AstPool::~AstPool( ) {
+  for ( size_t i = 0; i < mNodes.size(); ++i )
+    delete mNodes[ i ];
+  for ( size_t i = 0; i < mTokens.size(); ++i )
+    delete mTokens[ i ];
+} // AstPool::~AstPool()
+
+// The objects, plus the heap of the nodes and tokens adopted since the
+// last call. Their strings and children are only filled once they are
+// built, so they are charged when a parse is done with them.
+size_t AstPool::Bytes( ) {
+  for ( ; mChargedNodes < mNodes.size(); ++mChargedNodes )
+    mBytes += mNodes[ mChargedNodes ] -> HeapBytes();
+  for ( ; mChargedTokens < mTokens.size(); ++mChargedTokens )
+    mBytes += GHeapBytes( mTokens[ mChargedTokens ] -> value );
+  return mBytes;
+} // AstPool::Bytes()
+
+// ---------------------------- Profiler -------------------
+// --profile : every Node::Eval goes through Profiler::Eval, which times
+// the evaluation and counts the Obj allocated under it. Time and
+// allocations are exclusive unless named inclusive, inclusive time is
+// only counted once when a kind or line is nested in itself.
+class Profiler {
+  struct Stats {
+    long calls;
+    double inclusive; // Seconds
+    double exclusive;
+    size_t allocs;
+    int active; // Evaluations of this key on the stack
+
+    Stats( ) {
+      calls = 0;
+      inclusive = exclusive = 0;
+      allocs = 0;
+      active = 0;
+    } // Stats()
+  };
+
+  // A call path : a node reached from its parent path, for folded stacks
+  struct Path {
+    int parent; // -1 at the root
+    string frame;
+    double exclusive;
+  };
+
+  struct Frame {
+    int path;
+    string kind;
+    int line;
+    chrono::steady_clock::time_point start;
+    double children; // Time spent in child evaluations
+    size_t allocs; // gObjAllocs when the evaluation started
+    size_t childAllocs;
+  };
+
+  map< string, Stats > mKinds;
+  map< int, Stats > mLines;
+  vector< Path > mPaths;
+  map< pair< int, Node * >, int > mPathIds;
+  vector< Frame > mStack;
+
+  int PathOf( int parent, Node *node, const string &kind, int line ) ;
+  void Record( Stats &stats, double inclusive, double exclusive, size_t allocs ) ;
+  string Stack( int path ) ;
 
-class UpdateExpression : public Expression {
-  Token *mOp;
-  SymbolExpression *mId;
-  string mType;
-  bool mPrefix;
 public:
-  UpdateExpression( Token* tok, SymbolExpression *id, bool prefix ) {
-    mOp = tok;
-    mId = id;
-    mPrefix = prefix;
-    mType = "Update Expression";
-  } // UpdateExpression()
-  
-  string Type( ) { 
-    return mType; 
-  } // Type()
+  Obj *Eval( Node *node, Environment *env ) ;
+  void Report( ostream &out ) ;
+  bool WriteFolded( const char *path ) ;
+};
 
-  string Value( ) { 
-    return mOp -> value; 
-  } // Value()
+thread_local Profiler *gProfiler = NULL; // Set by --profile
+
+int Profiler::PathOf( int parent, Node *node, const string &kind, int line ) {
+  pair< int, Node * > key( parent, node );
+  map< pair< int, Node * >, int >::iterator found = mPathIds.find( key );
+  if ( found != mPathIds.end() )
+    return found -> second;
+
+  stringstream frame;
+  frame << kind << ":" << line;
+  Path path;
+  path.parent = parent;
+  path.frame = frame.str();
+  path.exclusive = 0;
+  mPaths.push_back( path );
+  mPathIds[ key ] = mPaths.size() - 1;
+  return mPaths.size() - 1;
+} // Profiler::PathOf()
+
+Obj *Profiler::Eval( Node *node, Environment *env ) {
+  Frame frame;
+  frame.kind = node -> Type();
+  frame.line = node -> GetSpan().line;
+  // Nodes built outside ParseExpression / ParseStatement have no span
+  if ( frame.line == 0 && ! mStack.empty() )
+    frame.line = mStack.back().line;
+  frame.path = PathOf( mStack.empty() ? -1 : mStack.back().path, node, 
+                       frame.kind, frame.line );
+  frame.children = 0;
+  frame.allocs = gObjAllocs;
+  frame.childAllocs = 0;
+  ++mKinds[ frame.kind ].active;
+  ++mLines[ frame.line ].active;
+  mStack.push_back( frame );
+  mStack.back().start = chrono::steady_clock::now();
+
+  Obj *result = node -> EvalNode( env );
+
+  chrono::duration< double > took = chrono::steady_clock::now() - mStack.back().start;
+  Frame done = mStack.back();
+  mStack.pop_back();
+  double inclusive = took.count();
+  size_t allocs = gObjAllocs - done.allocs;
+  if ( ! mStack.empty() ) {
+    mStack.back().children += inclusive;
+    mStack.back().childAllocs += allocs;
+  } // if
 
-  void Expr( ) { 
-  } // Expr()
+  double exclusive = inclusive - done.children;
+  Record( mKinds[ done.kind ], inclusive, exclusive, allocs - done.childAllocs );
+  Record( mLines[ done.line ], inclusive, exclusive, allocs - done.childAllocs );
+  mPaths[ done.path ].exclusive += exclusive;
+  return result;
+} // Profiler::Eval()
+
+void Profiler::Record( Stats &stats, double inclusive, double exclusive, size_t allocs ) {
+  ++stats.calls;
+  stats.exclusive += exclusive;
+  stats.allocs += allocs;
+  if ( --stats.active == 0 )
+    stats.inclusive += inclusive;
+} // Profiler::Record()
+
+const int kProfileLines = 20; // Source lines in the report
+
+template < class Key >
+bool GByExclusive( const pair< Key, double > &a, const pair< Key, double > &b ) {
+  return a.second > b.second;
+} // GByExclusive()
+
+// Both tables are sorted by exclusive time, only the hottest lines are shown
+void Profiler::Report( ostream &out ) {
+  vector< pair< string, double > > kinds;
+  for ( map< string, Stats >::iterator it = mKinds.begin(); it != mKinds.end(); ++it )
+    kinds.push_back( make_pair( it -> first, it -> second.exclusive ) );
+  sort( kinds.begin(), kinds.end(), GByExclusive< string > );
+
+  out << "Profile by node kind\n";
+  out << setw( 10 ) << "calls" << setw( 12 ) << "incl ms" << setw( 12 ) << "excl ms" 
+      << setw( 10 ) << "allocs" << "  kind\n";
+  out << fixed << setprecision( 3 );
+  for ( size_t i = 0; i < kinds.size(); ++i ) {
+    Stats &stats = mKinds[ kinds[ i ].first ];
+    out << setw( 10 ) << stats.calls << setw( 12 ) << stats.inclusive * 1e3 
+        << setw( 12 ) << stats.exclusive * 1e3 << setw( 10 ) << stats.allocs 
+        << "  " << kinds[ i ].first << "\n";
+  } // for
 
-  void Print( ) ;
-  
-  Obj *Eval( Environment *env ) ;
-} ;
+  vector< pair< int, double > > lines;
+  for ( map< int, Stats >::iterator it = mLines.begin(); it != mLines.end(); ++it )
+    lines.push_back( make_pair( it -> first, it -> second.exclusive ) );
+  sort( lines.begin(), lines.end(), GByExclusive< int > );
+  out << "\nProfile by source line ( 0 : no source position )\n";
+  out << setw( 10 ) << "calls" << setw( 12 ) << "incl ms" << setw( 12 ) << "excl ms" 
+      << setw( 10 ) << "allocs" << "  line\n";
+  for ( size_t i = 0; i < lines.size() && i < kProfileLines; ++i ) {
+    Stats &stats = mLines[ lines[ i ].first ];
+    out << setw( 10 ) << stats.calls << setw( 12 ) << stats.inclusive * 1e3 
+        << setw( 12 ) << stats.exclusive * 1e3 << setw( 10 ) << stats.allocs 
+        << "  " << lines[ i ].first << "\n";
+  } // for
 
-void UpdateExpression::Print() {
-  cout << "(";
-  if ( mPrefix ) {
-    cout << mOp -> value; 
-    mId -> Print();
-  } // if
-  
-  else { 
-    mId -> Print();
-    cout << mOp -> value;
-  } // else
+  out.unsetf( ios::floatfield );
+} // Profiler::Report()
+
+string Profiler::Stack( int path ) {
+  if ( mPaths[ path ].parent < 0 )
+    return mPaths[ path ].frame;
+  return Stack( mPaths[ path ].parent ) + ";" + mPaths[ path ].frame;
+} // Profiler::Stack()
+
+// One "frame;frame;frame microseconds" line per call path, the input of
+// flamegraph.pl
+bool Profiler::WriteFolded( const char *path ) {
+  ofstream file( path, ios::out | ios::trunc );
+  for ( size_t i = 0; i < mPaths.size(); ++i ) {
+    long micros = ( long ) ( mPaths[ i ].exclusive * 1e6 + 0.5 );
+    if ( micros > 0 )
+      file << Stack( i ) << " " << micros << "\n";
+  } // for
 
-  cout << ")"; 
-} // UpdateExpression::Print()
+  return ( bool ) file;
+} // Profiler::WriteFolded()
+
+// Every evaluation of a node goes through here
+Obj *Node::Eval( Environment *env ) {
+  if ( gProfiler == NULL )
+    return EvalNode( env );
+  return gProfiler -> Eval( this, env );
+} // Node::Eval()
+
+// ---------------------------- Sampling profiler -------------------
+// --sample : a SIGPROF timer counts the statement running when it
+// fires. The evaluator only keeps gCurrentStmt up to date, and the
+// handler only touches a fixed table, so it can stay on in production.
+thread_local Node *volatile gCurrentStmt = NULL; // Set by Program and BlockStatement
+
+struct SampleSlot {
+  Node *volatile node;
+  volatile long count;
+};
 
-Obj *UpdateExpression::Eval( Environment *env ) {
-  Obj* obj = env -> Get( mId -> Value() ); 
-  string value = obj -> Value();
-  Obj* res = NULL; 
-  if ( mPrefix ) {
+const int kSampleSlots = 4096; // Power of two
+const int kSampleLines = 20; // Statements in the report
 
-    if ( obj -> Type() == "Float" ) {
-      float num = GStringToFloat(value);
-      num += 1.0;
-      res = new Float( num, "Float" );
-    } // if
+SampleSlot gSampleSlots[ kSampleSlots ];
+volatile long gSamplesIdle = 0; // No statement running
+volatile long gSamplesDropped = 0; // Table full
 
-    else if ( obj -> Type() == "Integer" ) {
-      int num = GStringToInt(value);
-      num += 1;
-      res = new Integer( num, "Integer" );
-    } // if
- 
-    env -> Set( mId -> Value(), res );
-    return env -> Get( mId -> Value() ); 
+void GOnSample( int /* sig */ ) {
+  Node *node = gCurrentStmt;
+  if ( node == NULL ) {
+    ++gSamplesIdle;
+    return;
   } // if
 
-  else {
-    if ( obj -> Type() == "Float" ) {
-      float num = GStringToFloat(value);
-      num += 1.0;
-      res = new Float( num, "Float" );
+  size_t slot = ( ( size_t ) node >> 4 ) & ( kSampleSlots - 1 );
+  for ( int i = 0; i < kSampleSlots; ++i ) {
+    SampleSlot &entry = gSampleSlots[ ( slot + i ) & ( kSampleSlots - 1 ) ];
+    if ( entry.node == NULL )
+      entry.node = node;
+    if ( entry.node == node ) {
+      ++entry.count;
+      return;
     } // if
+  } // for
 
-    else if ( obj -> Type() == "Integer" ) {
-      int num = GStringToInt(value);
-      num += 1;
-      res = new Integer( num, "Integer" );
+  ++gSamplesDropped;
+} // GOnSample()
+
+// Sample every usec microseconds of CPU time
+bool GStartSampling( long usec ) {
+  struct sigaction action;
+  memset( &action, 0, sizeof( action ) );
+  action.sa_handler = GOnSample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset( &action.sa_mask );
+  if ( sigaction( SIGPROF, &action, NULL ) != 0 )
+    return false;
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = usec / 1000000;
+  timer.it_interval.tv_usec = usec % 1000000;
+  timer.it_value = timer.it_interval;
+  return setitimer( ITIMER_PROF, &timer, NULL ) == 0;
+} // GStartSampling()
+
+void GStopSampling( ) {
+  struct itimerval timer;
+  memset( &timer, 0, sizeof( timer ) );
+  setitimer( ITIMER_PROF, &timer, NULL );
+} // GStopSampling()
+
+bool GByCount( const SampleSlot &a, const SampleSlot &b ) {
+  return a.count > b.count;
+} // GByCount()
+
+// The hottest statements with their share of the samples
+void GSampleReport( ostream &out ) {
+  vector< SampleSlot > slots;
+  long total = gSamplesIdle + gSamplesDropped;
+  for ( int i = 0; i < kSampleSlots; ++i ) {
+    if ( gSampleSlots[ i ].node != NULL ) {
+      slots.push_back( gSampleSlots[ i ] );
+      total += gSampleSlots[ i ].count;
     } // if
+  } // for
 
-    env -> Set( mId -> Value(), res );
-    return obj; 
-  } // if
+  sort( slots.begin(), slots.end(), GByCount );
+  out << "Samples : " << total << " ( idle " << gSamplesIdle << ", dropped " 
+      << gSamplesDropped << " )\n";
+  out << setw( 10 ) << "samples" << setw( 8 ) << "%" << setw( 8 ) << "line" 
+      << "  statement\n";
+  out << fixed << setprecision( 1 );
+  for ( size_t i = 0; i < slots.size() && i < kSampleLines; ++i ) {
+    Node *node = slots[ i ].node;
+    out << setw( 10 ) << slots[ i ].count << setw( 8 ) 
+        << 100.0 * slots[ i ].count / total << setw( 8 ) << node -> GetSpan().line 
+        << "  " << node -> Type() << "\n";
+  } // for
 
-} // UpdateExpression::Eval()
+  out.unsetf( ios::floatfield );
+} // GSampleReport()
 
-class Parameter : public Expression {
-  Token* mTok; // kind token
-  string mType;
-  SymbolExpression* mPara;
-  bool mPassByRef;
+// ---------------------------- AST node type -------------------
+class Statement : public Node {
+public:
+  virtual void Stmt( ) = 0;
+
+  // Register the names this statement declares, so later statements of
+  // the same script parse without evaluating it first
+  virtual void Declare( Environment * /* scope */ ) {
+  } // Declare()
+}; // Statement
 
+class Expression : public Node {
 public:
-  Parameter( Token *tok, SymbolExpression* para, bool pbr ) {
-    mTok = tok;
-    mType = "Parameter";
-    mPara = para; 
-    mPassByRef = pbr; 
-  } // Parameter()
-  
-  Parameter() {} // Parameter()
+  virtual void Expr( ) = 0;
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+  // Emit bytecode for this subtree, false if the VM can not run it
+  virtual bool Compile( Bytecode * /* code */ ) {
+    return false;
+  } // Compile()
+};
 
-  string Value( ) { 
-    return mPara -> Value(); 
-  } // Value()
+// 1 + 2 ; 2 + 4 ;
+// --------------------------- Block Statement -----------------------
+class BlockStatement : public Statement {
+  Token *mTok; // { token
+  string mType;
+  vector< Statement * > mStmts;
 
-  void Expr( ) { 
-  } // Expr()
+public:
+  BlockStatement( Token *token ) {
+    mType = "Block Statements";
+    mTok = token;
+  } // BlockStatement()
+
+  void Append( Statement *stmt ) ;
+
+  void Stmt( ) {
+  } // Stmt()
 
   void Print( ) ;
-  
-  Obj *Eval( Environment *env ) ;
-  
-};
+  string Type( ) ;
+  string Value( ) ;
 
-void Parameter::Print() {
-  cout << mTok -> value << " " << mPara -> Value();
-} // Parameter::Print()
+  vector< Statement* > GetStmts() {
+    return mStmts;
+  }  // GetStmts()
 
-// Register parameter to current env
-Obj* Parameter::Eval( Environment *env ) {
-  Obj* obj = NULL;
-  if ( mTok -> type == KEY_INT ) 
-    obj = new Integer( 0, "Integer");
-  else if ( mTok -> type ==  KEY_FLOAT )
-    obj = new Float( 0.0, "Float");
-  else if ( mTok -> type == KEY_STRING )
-    obj = new String( "", "String" );
-  
-  string name = mPara -> Value();
-  env -> Set( name, obj );
-  return obj;
-} // Parameter::Eval()
+  Obj *EvalNode( Environment *env ) ;
 
-class Function : public Obj {
-  Token* mKind;
-  Expression* mName;
-  vector< Parameter* > mPara;
-  BlockStatement *mBody;
-  Environment *mEnv;
-  string mType;
-public: 
-  Function( Token* kind, Expression* name, 
-           BlockStatement* bstmt, Environment* env, 
-           vector< Parameter* > para ) {
-    mName = name;
-    mKind = kind; 
-    mPara = para;
-    mEnv = env;
-    mBody = bstmt;
-    mType = "Function";
-  } // Function()
+  void Serialize( AstWriter *out ) ;
+  static BlockStatement *Load( AstReader *in ) ;
 
-  Obj* Eval( Environment *env );
-  void Inspect();
-  string Type(); 
-  string Value();
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + GHeapBytes( mStmts );
+  } // HeapBytes()
+};
 
-  Environment *GetEnv( ) {
-    return mEnv;
-  } // GetEnv() 
+void BlockStatement::Append( Statement *stmt ) {
 
-  vector < Parameter *> GetParameter( ) {
-    return mPara;
-  } // GetParameter()
-} ;
+  mStmts.push_back( stmt ) ;
 
-Obj *Function::Eval( Environment *env ) {
-  Obj* blockObj = mBody -> Eval( env );
-  return blockObj;
-} // Function::Eval()
+} // BlockStatement::Append()
 
-void Function::Inspect() {
-  cout << mKind -> value << " ";
-  mName -> Print();
-  cout << " (";
-  for ( int i = 0; i < mPara.size(); ++i ) {
-    mPara[i] -> Print(); 
-    if ( i + 1 < mPara.size() )
-      cout << ", ";
+void BlockStatement::Print( ) {
+  *gOut << "{ \n";
+  for ( int i = 0; i < mStmts.size( ) ; ++i ) {
+    mStmts [ i ]->Print( ) ;
   } // for
+  *gOut << "} \n ";
+} // BlockStatement::Print()
 
-  cout << ") \n";
-  mBody -> Print();
-} // Function::Inspect()
+string BlockStatement::Type( ) { return mType; } // BlockStatement::Type()
 
-string Function::Value() {
-  string str = mKind -> value;
-  return str;
-} // Function::Value()
+Obj *BlockStatement::EvalNode( Environment *env ) { 
+  Obj *obj = NULL;
+  Node *caller = gCurrentStmt;
+  for ( int i = 0; i < mStmts.size(); ++i ) {
+    gCurrentStmt = mStmts[i];
+    obj = mStmts[i] -> Eval( env );
+    if ( obj != NULL && obj -> Kind() == RETURN_KIND ) 
+      break;
+  } // for 
 
-string Function::Type() {
-  return mType;
-} // Function::Type()
+  gCurrentStmt = caller;
+  return obj;
+} // BlockStatement::EvalNode()
 
-class FunctionDeclaration : public Statement {
-  Token* mTok; // Type token
-  SymbolExpression *mId;
-  vector< Parameter *> mParams;
-  BlockStatement *mBlockStmt;
+string BlockStatement::Value( ) { return mTok->value; } // BlockStatement::Value()
+
+
+//----------------- if else ------------------
+class ConditionalExpr : public Expression {
+  Token *mTok; // If token
   string mType;
-  Environment *mEnv;
+  Expression *mCondition;
+  BlockStatement *mConsequence;
+  BlockStatement *mAlternative;
 
 public:
-
-  FunctionDeclaration( Token* tok, SymbolExpression *id ) {
+  ConditionalExpr( Token *tok, Expression *cond, BlockStatement *consequence,
+                   BlockStatement *alternative ) {
     mTok = tok;
-    mId = id;
-    mType = "Function Declaration";
-  } // FunctionDeclaration()
+    mType = "Conditional Expression";
+    mCondition = cond;
+    mConsequence = consequence;
+    mAlternative = alternative;
+  } // ConditionalExpr()
 
-  void Append( Parameter* prm );
+  void Expr( ) {
+  } // Expr() 
 
-  void SetEnv( Environment* env ) {
-    mEnv = env; 
-  } // SetEnv() 
+  void Print( ) ;
+  string Type( ) ;
+  string Value( ) ;
+  Obj *EvalNode( Environment *env ) ;
 
-  void SetBlock( BlockStatement* bstmt ) {
-    mBlockStmt = bstmt; 
-  } // SetBlock()
+  void Serialize( AstWriter *out ) ;
+  static ConditionalExpr *Load( AstReader *in ) ;
+};
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+void ConditionalExpr::Print( ) {
+  *gOut << " If ";
+  mCondition->Print( ) ;
+  mConsequence->Print( ) ;
+  if ( mAlternative != NULL ) {
+    *gOut << "Else", mConsequence->Print( ) ;
+  } // if
 
-  string Value( ) { 
-    return ""; 
-  } // Value()
+} // ConditionalExpr::Print()
+
+string ConditionalExpr::Type( ) { return mType; } // ConditionalExpr::Type()
 
+string ConditionalExpr::Value( ) { return mTok->value; } // ConditionalExpr::Value()
 
-  void Stmt( ) { 
-  } // Expr()
+// TODO: Implement evaluation
+Obj *ConditionalExpr::EvalNode( Environment * /* env */ ) { return NULL; } // ConditionalExpr::EvalNode()
+
+class IntExpr : public Expression {
+  Token *mTok;
+  string mType;
+  size_t mValue;
+
+public:
+  IntExpr( Token *tok, size_t value ) {
+    mValue = value;
+    mTok = tok;
+    mType = "Integer";
+  } // IntExpr()
 
+  string Type( ) ;
   void Print( ) ;
+  void Expr( ) ;
+  string Value( ) ;
+  Obj *EvalNode( Environment *env ) ;
+  bool Compile( Bytecode *code ) ;
 
-  Obj *Eval( Environment *env ) ;
-} ;
+  void Serialize( AstWriter *out ) ;
+  static IntExpr *Load( AstReader *in ) ;
+};
 
-void FunctionDeclaration::Append( Parameter* prm ) {
-  mParams.push_back( prm );
-} // FunctionDeclaration::Append()
+bool IntExpr::Compile( Bytecode *code ) {
+  VmValue k;
+  k.tag = VM_INT;
+  k.i = mValue;
+  code -> EmitPush( k );
+  return true;
+} // IntExpr::Compile()
 
-void FunctionDeclaration::Print() {
-  cout << mTok -> value << " " << mId -> Value() << "(";
-  for ( int i = 0; i < mParams.size(); ++i ) {
-    cout << " ";
-    mParams[i] -> Print();
-    if ( i + 1 < mParams.size() )
-      cout << ","; 
-  } // for
-  
-  cout << " ) {\n";
-  vector <Statement *> stmts = mBlockStmt -> GetStmts();
-  
-  for ( int i = 0; i < stmts.size(); ++i ) {
-    cout << "  ";
-    stmts[i] -> Print();
-  } // for
+string IntExpr::Type( ) { return mType; } // IntExpr::Type()
 
-  cout << "}\n";
-} // FunctionDeclaration::Print()
+Obj *IntExpr::EvalNode( Environment * /* env */ ) {
+  Obj *result = new Integer( mValue, mType ) ;
+  return result;
+} // IntExpr::EvalNode()
 
-Obj* FunctionDeclaration::Eval( Environment* env ) {
-  Obj *obj = new Function( mTok, mId, mBlockStmt, mEnv, mParams );
-  env -> Set( mId -> Value(), obj ); 
-  return obj;
-}  // FunctionDeclaration::Eval() 
+string IntExpr::Value( ) {
+  char buf[ kNumberChars ];
+  return string( buf, GFormatUnsigned( mValue, buf ) );
+} // IntExpr::Value()
 
-class CallExpression : public Expression {
-  Obj* mFunction;
-  vector < Expression* > mArgs;
-  string mValue;
+void IntExpr::Print( ) { *gOut << mTok->value; } // IntExpr::Print()
+
+void IntExpr::Expr( ) { *gOut << mValue << "\n"; } // IntExpr::Expr()
+
+class FloatExpr : public Expression {
+  Token *mTok;
+  float mValue;
   string mType;
 
 public:
-  CallExpression( Obj *fid, vector< Expression*> args ) {
-    mFunction = fid;
-    mArgs = args;
-    mType = "Call Expression";
-    mValue = "";
-  } // CallExpression()
+  FloatExpr( Token *tok, float value ) {
+    mValue = value;
+    mTok = tok;
+    mType = "Float";
+  } // FloatExpr()
 
   string Type( ) { 
     return mType; 
   } // Type()
 
-  string Value( ) { 
-    return mValue; 
-  } // Value()
-
-  void Expr( ) { 
-  } // Expr()
-
   void Print( ) ;
-  Obj* ApplyFunction( Obj* function, vector< Obj* > args );
-  Environment* ExtendFunctionEnv( Obj* function, vector< Obj* > args ); 
-  Obj *Eval( Environment *env ) ;
-
-  vector < Parameter *> GetParameter( ) {
-    vector< Parameter*> prm;
-    return prm;
-  } // GetParameter()
+  void Expr( ) ;
+  string Value( ) ;
+  Obj *EvalNode( Environment *env ) ;
+  bool Compile( Bytecode *code ) ;
 
-} ;
+  void Serialize( AstWriter *out ) ;
+  static FloatExpr *Load( AstReader *in ) ;
+};
 
-void CallExpression::Print() {
-  cout << mFunction -> Value();
-  cout << "( ";
-  for ( int i = 0; i < mArgs.size(); ++i ) {
-    mArgs[i] -> Print();
-    if ( i + 1 < mArgs.size() )
-      cout << ", ";
-  } // for 
-  cout << ") ";
-} // CallExpression::Print(); 
+bool FloatExpr::Compile( Bytecode *code ) {
+  VmValue k;
+  k.tag = VM_FLOAT;
+  k.f = mValue;
+  code -> EmitPush( k );
+  return true;
+} // FloatExpr::Compile()
 
-Environment* CallExpression::ExtendFunctionEnv( Obj* function, 
-                                               vector< Obj* > args ) {
-  // This would get the inner environment
-  Environment* env =  function -> GetEnv(); 
-  // Register the parameter
-  vector < Parameter* > parameter = function -> GetParameter();
+Obj *FloatExpr::EvalNode( Environment * /* env */ ) {
+  Obj *result = new Float( mValue, mType ) ;
+  return result;
+} // FloatExpr::EvalNode()
 
-  // Update the inner environment variable to equal to args
-  for ( int i = 0; i < parameter.size(); i++ ) {
-    string name = parameter[i] -> Value();
-    env -> Set( name, args[i] ); 
-  } // for
+string FloatExpr::Value( ) {
+  char buf[ kNumberChars ];
+  return string( buf, GFormatGeneral( mValue, buf ) );
+} // FloatExpr::Value()
 
-  return env;
-} // CallExpression::ExtendFunctionEnv()
+void FloatExpr::Print( ) { 
+  *gOut << mTok->value; 
+} // FloatExpr::Print()
 
+void FloatExpr::Expr( ) { 
+  *gOut << mValue << "\n"; 
+} // FloatExpr::Expr()
 
-Obj* CallExpression::ApplyFunction( Obj* function, vector< Obj* > args ) {
-  if ( function -> Type() != "Function" ) 
-    return NULL;
+class CharExpr : public Expression {
+  char mValue;
+  string mType;
 
-  Environment *extendEnv = ExtendFunctionEnv( function, args );
-  // Evaluate the block statement
-  Obj* blockStmt = function -> Eval( extendEnv );
-  if ( blockStmt -> Type() == "Return" ) {
+public:
+  CharExpr( char value ) {
+    mValue = value;
+    mType = "Char";
+  } // StringExpr()
 
-    if ( mFunction -> Value() == "void" ) {
-      cout << "Error : Void function should not return a value." << endl;
-      return NULL; 
-    } // if 
+  string Type( ) { 
+    return mType; 
+  } // Type()
 
-  } // if
-  return blockStmt;
-} // CallExpression::ApplyFunction() 
+  void Expr( ) ;
+  void Print( ) ;
+  string Value( ) ;
+  Obj *EvalNode( Environment *env ) ;
 
-Obj* CallExpression::Eval( Environment *env ) {
-  vector < Obj* > args;
-  for ( int i = 0; i < mArgs.size(); ++i ) {
-    Obj* arg = mArgs[i] -> Eval( env );
-    if ( arg != NULL )
-      args.push_back( arg );
-  } // for
+  void Serialize( AstWriter *out ) ;
+  static CharExpr *Load( AstReader *in ) ;
+};
 
-  Obj* ret = ApplyFunction( mFunction, args );
-  return ret; 
-} // CallExpression::Eval()
+Obj *CharExpr::EvalNode( Environment * /* env */ ) {
+  string str = "";
+  str += mValue; 
+  Obj *result = new Char( str, "Char" ) ;
+  return result;
+} // StringExpr::EvalNode()
+
+string CharExpr::Value( ) { 
+  string str = "";
+  str += mValue;
+  return str; 
+} // StringExpr::Value()
 
+void CharExpr::Print( ) { 
+  *gOut << mValue; 
+} // StringExpr::Print()
 
-class DeclarationStatement : public Statement {
-  Token* mTok; // Type token
-  vector < Expression* > mIds;
+void CharExpr::Expr( ) { 
+} // StringExpr::Expr()
+
+class StringExpr : public Expression {
+  string mValue;
   string mType;
 
-public: 
-  DeclarationStatement( Token* tok ) {
-    mTok = tok;
-    mType = "Declaration statement";
-  } // DeclarationStatement()
+public:
+  StringExpr( string value ) {
+    mValue = value;
+    mType = "String";
+  } // StringExpr()
 
-  void Stmt( ) {
-  } // Stmt()
-  
-  void Append( Token* id ); 
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  void Expr( ) ;
   void Print( ) ;
-  string Type( ) ;
   string Value( ) ;
+  Obj *EvalNode( Environment *env ) ;
 
-  void AppendArr( Expression* expr ); 
-  Obj *Eval( Environment *env ) ;
+  void Serialize( AstWriter *out ) ;
+  static StringExpr *Load( AstReader *in ) ;
 };
 
-void DeclarationStatement::AppendArr( Expression* expr ) {
-  mIds.push_back( expr );
-} // DeclarationStatement::Append()
+Obj *StringExpr::EvalNode( Environment * /* env */ ) {
+  Obj *result = new String( mType, mValue ) ;
+  return result;
+} // StringExpr::EvalNode()
 
-void DeclarationStatement::Append( Token* id ) {
-  SymbolExpression *symbol = new SymbolExpression( id, id -> value);
-  mIds.push_back( symbol );
-} // DeclarationStatement::Append()
+string StringExpr::Value( ) { 
+  return mValue; 
+} // StringExpr::Value()
 
-void DeclarationStatement::Print() {
-  cout << mTok -> value << " ";
-  for ( int i = 0; i < mIds.size(); ++i ) {
-    mIds[i] -> Print();
-    if ( i + 1 < mIds.size() )
-      cout << ", ";  
-  } // for 
-  cout << ";";
-} // DeclarationStatement::Print()
+void StringExpr::Print( ) { 
+  *gOut << mValue; 
+} // StringExpr::Print()
 
-string DeclarationStatement::Type() {
-  return mType; 
-} // DeclarationStatement::Type()
+void StringExpr::Expr( ) { 
+} // StringExpr::Expr()
 
-string DeclarationStatement::Value() {
-  return mTok -> value;
-} // DeclarationStatement::Value()
+class CoutExpr : public Expression {
+  vector< Expression* > mArgs;
+  string mType;
 
-Obj *DeclarationStatement::Eval( Environment *env ) {
-  TokenType tp = mTok -> type;
-  Obj* obj = NULL;
-  
-  if ( tp == KEY_INT )
-    obj = new Integer( 0, "Integer" );
-  
-  else if ( tp == KEY_FLOAT )
-    obj = new Float( 0.0, "FLoat" );
+public:
+  CoutExpr( ) {
+    mType = "Cout Expression";
+  } // CoutExpr()
 
-  else if ( tp == KEY_STRING ) 
-    obj = new String( "String", "" );
+  string Type( ) { 
+    return mType; 
+  } // Type()
 
-  else if ( tp == KEY_BOOL )
-    obj = new Boolean( false, "Boolean" );
+  string Value( ) { 
+    return ""; 
+  } // Value()
 
-  for ( int i = 0; i < mIds.size(); ++i ) { 
-    if ( mIds[i] -> Type() != "Array Expression" ) 
-      env -> Set( mIds[i] -> Value(), obj );
-    else 
-      mIds[i] -> Eval( env );
+  void Expr( ) { } // Expr() 
+
+  void Print( ) ;
+  void Append( Expression* expr );
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static CoutExpr *Load( AstReader *in ) ;
+
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + GHeapBytes( mArgs );
+  } // HeapBytes()
+};
+
+void CoutExpr::Append( Expression* expr ) {
+  mArgs.push_back(expr);
+} // CoutExpr::Append() 
+
+Obj *CoutExpr::EvalNode( Environment *env ) {
+  Obj* obj = NULL; 
+  for ( int i = 0; i < mArgs.size(); ++i ) {
+    obj = mArgs[i] -> Eval( env );
+    if ( obj == NULL )
+      return NULL;
+    obj -> Inspect();
   } // for
 
   return obj;
-} //  DeclarationStatment::Eval()
+} // CoutExpr::EvalNode()
 
-class UnaryExpression : public Expression {
-  Token *mOp;
-  Expression *mRhs;
+void CoutExpr::Print() {
+  *gOut << "cout << ";
+  for ( int i = 0; i < mArgs.size(); ++i ) {
+    mArgs[i] -> Print();
+    if ( i + 1 < mArgs.size() )
+      *gOut << " << ";
+  } // for
+  *gOut << ";\n";
+} // CoutExpr::Print()
+
+// cin >> a >> b : each variable takes the next value of the type it holds
+class CinExpr : public Expression {
+  vector< Expression* > mTargets;
   string mType;
 
+  Obj *ReadValue( Obj *var ) ;
+
 public:
-  UnaryExpression( Token *op, Expression *right ) {
-    mOp = op;
-    mRhs = right;
-    mType = "Unary expression";
-  } // UnaryExpression()
+  CinExpr( ) {
+    mType = "Cin Expression";
+  } // CinExpr()
 
   string Type( ) { 
     return mType; 
@@ -2054,1248 +3917,5922 @@ public:
     return ""; 
   } // Value()
 
-  void Expr( ) { 
-  } // Expr()
+  void Expr( ) { } // Expr() 
 
   void Print( ) ;
-  
-  Obj *Eval( Environment *env ) ;
-  Obj *EvalPlusMinus( Environment *env ) ;
+  void Append( Expression* target );
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static CinExpr *Load( AstReader *in ) ;
+
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + GHeapBytes( mTargets );
+  } // HeapBytes()
 };
 
-Obj *UnaryExpression::EvalPlusMinus( Environment *env ) {
-  Obj *rhs = mRhs->Eval( env ) ;
-  if ( rhs == NULL )
+void CinExpr::Append( Expression* target ) {
+  mTargets.push_back( target );
+} // CinExpr::Append() 
+
+// A new value of the kind var holds, NULL if the input has none
+Obj *CinExpr::ReadValue( Obj *var ) {
+  if ( gIn == NULL )
     return NULL;
 
-  Obj *result = NULL;
-  string value = rhs->Value( ) ;
-  if ( mOp->type == PLUS ) {
-    if ( rhs->Type( ) == "Float" ) {
-      float num = GStringToFloat( value ) ;
-      result = new Float( num, "Float" ) ;
-    } // if
+  if ( var -> Kind() == INT_KIND ) {
+    int value;
+    if ( gIn -> ReadInt( value ) )
+      return new Integer( value, "Integer" );
+  } // if
+  else if ( var -> Kind() == FLOAT_KIND ) {
+    float value;
+    if ( gIn -> ReadFloat( value ) )
+      return new Float( value, "Float" );
+  } // else if
+  else if ( var -> Kind() == BOOL_KIND ) {
+    bool value;
+    if ( gIn -> ReadBool( value ) )
+      return new Boolean( value, "Boolean" );
+  } // else if
+  else if ( var -> Kind() == CHAR_KIND ) {
+    char value;
+    if ( gIn -> ReadChar( value ) )
+      return new Char( string( 1, value ), "Char" );
+  } // else if
+  else if ( var -> Kind() == STRING_KIND ) {
+    string value;
+    if ( gIn -> ReadWord( value ) )
+      return new String( "String", value );
+  } // else if
 
-    else if ( rhs->Type( ) == "Integer" ) {
-      int num = GStringToInt( value ) ;
-      result = new Integer( num, "Integer" ) ;
-    } // else if
+  return NULL;
+} // CinExpr::ReadValue()
 
-  } // if
+Obj *CinExpr::EvalNode( Environment *env ) {
+  Obj* obj = NULL; 
+  for ( size_t i = 0; i < mTargets.size(); ++i ) {
+    string name = mTargets[i] -> Value();
+    Obj *var = env -> Get( name );
+    if ( var == NULL ) {
+      *gOut << "Undefined identifier : '" << name << "'\n";
+      return NULL;
+    } // if
 
-  else if ( mOp->type == MINUS ) {
-    if ( rhs->Type( ) == "Float" ) {
-      float num = GStringToFloat( value ) ;
-      num = num * -1.0;
-      result = new Float( num, "Float" ) ;
+    obj = ReadValue( var );
+    if ( obj == NULL ) {
+      *gOut << "Cannot read '" << name << "' from the input\n";
+      return NULL;
     } // if
 
-    else if ( rhs->Type( ) == "Integer" ) {
-      int num = GStringToInt( value ) ;
-      num = num * -1;
-      result = new Integer( num, "Integer" ) ;
-    } // else if
+    env -> Set( name, obj );
+  } // for
 
-  } // else if
+  return obj;
+} // CinExpr::EvalNode()
 
-  return result;
-} // UnaryExpression::EvalPlusMinus()
+void CinExpr::Print() {
+  *gOut << "cin";
+  for ( size_t i = 0; i < mTargets.size(); ++i ) {
+    *gOut << " >> ";
+    mTargets[i] -> Print();
+  } // for
+  *gOut << ";\n";
+} // CinExpr::Print()
 
-Obj *UnaryExpression::Eval( Environment *env ) {
-  Obj *result = NULL;
-  if ( mOp->type == PLUS || mOp->type == MINUS ) {
-    result = EvalPlusMinus( env ) ;
-  } // if
+class BinExpr : public Expression {
+  Expression *mLeft;
+  Token *mOp;
+  Operator mOpr;
+  Expression *mRight;
+  string mType;
+  Bytecode *mCode; // NULL if the subtree can not run on the VM
 
-  return result;
-} // UnaryExpression::Eval()
+public:
+  BinExpr( Expression *left, Token *op, Expression *right ) {
+    mLeft = left;
+    mOp = op;
+    mOpr = GOperatorOf( op -> type );
+    mRight = right;
+    mType = "Binary Expression";
+    // Compiled as it is built, evaluation never changes the node
+    mCode = new Bytecode();
+    if ( Compile( mCode ) )
+      mCode -> Finish();
+    else {
+      delete mCode;
+      mCode = NULL;
+    } // else
+  } // BinExpr()
 
-void UnaryExpression::Print( ) {
-  cout << "( ";
-  cout << mOp->value;
-  mRhs->Print( ) ;
-  cout << ") ";
-} // UnaryExpression::Print()
+  ~BinExpr( ) {
+    delete mCode;
+  } // ~BinExpr()
 
-// ------------------------------- Statements --------------------------
-class ReturnStmt : public Statement {
-  Token *mTok;
-  Expression* mReturnValue;
-  string mType; 
+  // NULL if the subtree does not run on the VM
+  Bytecode *Code( ) {
+    return gUseVm ? mCode : NULL;
+  } // Code()
 
-public:
-  ReturnStmt( Token* tok, Expression* value) {
-    mTok = tok;
-    mReturnValue = value; 
-    mType = "Return Statement";
-  } // ReturnStmt()
-  
-  void Stmt() {}
+  string Type( ) { 
+    return mType; 
+  } // Type()
 
-  void Print();
-  string Type(); 
-  string Value();
-  Obj* Eval( Environment* env ); 
-} ;
+  string Value( ) { 
+    return ""; 
+  } // Value()
 
-Obj* ReturnStmt::Eval( Environment* env ) {
-  Obj *obj = mReturnValue -> Eval( env );
-  Obj *res = new Return( obj );
-  return res;
-} // ReturnStmt::Eval()
+  void Expr( ) ;
+  void Print( ) ;
 
-string ReturnStmt::Type() {
-  return mType;
-} // ReturnStmt::Type()
+  Obj *EvalNode( Environment *env ) ;
+  bool Compile( Bytecode *code ) ;
 
-string ReturnStmt::Value() {
-  return "";
-} // ReturnStmt::Value()
+  void Serialize( AstWriter *out ) ;
+  static BinExpr *Load( AstReader *in ) ;
 
-void ReturnStmt::Print() {
-  cout << mTok -> value << " ";
-  mReturnValue -> Print();
-  cout << ";\n";
-} // ReturnStmt::Print()
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + ( mCode != NULL ? mCode -> HeapBytes() : 0 );
+  } // HeapBytes()
+};
 
-// ------------------------------- Statements --------------------------
-class AssignmentExpr : public Expression {
-  Token *mToken; // Operator token 
-  Expression *mName; // Variable name
-  Expression *mValue;
+bool BinExpr::Compile( Bytecode *code ) {
+  if ( mOpr == OPERATOR_COUNT )
+    return false;
+  if ( ! mLeft -> Compile( code ) || ! mRight -> Compile( code ) )
+    return false;
+
+  code -> EmitOp( mOpr );
+  return true;
+} // BinExpr::Compile()
+
+Obj *BinExpr::EvalNode( Environment *env ) {
+  if ( Code() != NULL ) {
+    Obj *fast = mCode -> Run( env );
+    if ( fast != NULL )
+      return fast;
+  } // if
+
+  Obj *result = NULL;
+  Obj *left = mLeft->Eval( env ) ;
+  Obj *right = mRight->Eval( env ) ;
+  if ( left == NULL || right == NULL ) {
+    string undefined = "";
+    if ( left == NULL ) 
+      undefined = mLeft -> Value();
+    else if ( right == NULL )
+      undefined = mRight -> Value(); 
+
+    *gOut << "Undefined identifier : '" << undefined << "'\n";
+    return NULL;
+  } // if
+
+  if ( GZeroDivisor( mOpr, left, right ) ) {
+    *gOut << "Division by zero\n";
+    return NULL;
+  } // if
+
+  if ( mOpr != OPERATOR_COUNT )
+    result = GApply( mOpr, left, right );
+
+  if ( result == NULL ) 
+    *gOut << "Incompatible type between " 
+         << left -> Type() << " and " << right -> Type() << "\n"; 
+
+  return result;
+} // BinExpr::EvalNode()
+
+void BinExpr::Print( ) {
+  *gOut << "(";
+  mLeft->Print( ) ;
+  *gOut << mOp->value;
+  mRight->Print( ) ;
+  *gOut << ")";
+} // BinExpr::Print()
+
+void BinExpr::Expr( ) { } // BinExpr::Expr()
+
+class BooleanExpression : public Expression {
+  Token *mTok;
+  string mValue;
   string mType;
 
 public:
-  AssignmentExpr( Token *token, Expression *name, Expression *value ) {
-    mToken = token;
-    mName = name;
-    mValue = value;
-    mType = "Assignment Expression";
-  } // AssignmentExpr()
+  BooleanExpression( Token *tok, string val ) {
+    mValue = val;
+    mTok = tok;
+    mType = "Boolean";
+  } // SymbolExpression()
 
   string Type( ) { 
     return mType; 
   } // Type()
 
   string Value( ) { 
-    return ""; 
+    return mValue; 
   } // Value()
 
-  void Expr( ) {
-  } // Stmt()
+  void Expr( ) { 
+  } // Expr()
 
   void Print( ) ;
 
-  Obj *Eval( Environment *env ) ;
-  Obj *EvalFloat( string var, string rhs ) ;
-  Obj *EvalInt( string var, string rhs ) ;
-  Obj *EvalString( string var, string rhs ) ;
-};
-
-Obj *AssignmentExpr::EvalInt( string var, string rhs ) {
-  int left = GStringToFloat( var );
-  int right = GStringToFloat( rhs );
-  if ( mToken -> type == PLUS_EQ )
-    left += right;
-  else if ( mToken -> type == MINUS_EQ )
-    left -= right;
-  else if ( mToken -> type == DIVIDE_EQ )
-    left /= right;
-  else if ( mToken -> type == MULTI_EQ ) 
-    left *= right;
-
-  Obj *obj = new Integer( left,"Integer" );
-  return obj;
-} // AssignmenExpr::EvalFloat()
+  Obj *EvalNode( Environment *env ) ;
 
-Obj *AssignmentExpr::EvalString( string var, string rhs ) {
-  if ( mToken -> type == PLUS_EQ )
-    var += rhs ;
+  void Serialize( AstWriter *out ) ;
+  static BooleanExpression *Load( AstReader *in ) ;
+};
 
-  else {
-    cout << "Incorrect operation on string\n"; 
-    return NULL;
-  } // else
+void BooleanExpression::Print() {
+  *gOut << mValue;
+} // SymbolExpression::Print()
 
-  Obj *obj = new String( "String", var );
-  return obj;
-} // AssignmenExpr::EvalFloat()
-
-Obj *AssignmentExpr::EvalFloat( string var, string rhs ) {
-  float left = GStringToFloat( var );
-  float right = GStringToFloat( rhs );
-  cout << right;
-  if ( mToken -> type == PLUS_EQ )
-    left += right;
-  else if ( mToken -> type == MINUS_EQ )
-    left -= right;
-  else if ( mToken -> type == DIVIDE_EQ )
-    left /= right;
-  else if ( mToken -> type == MULTI_EQ ) 
-    left *= right;
-
-  Obj *obj = new Float( left,"Float" );
-  return obj;
-} // AssignmenExpr::EvalFloat()
+Obj *BooleanExpression::EvalNode( Environment * /* env */ ) {
+  bool result = false;
+  if ( mValue == "true" )
+    result = true;
 
-Obj *AssignmentExpr::Eval( Environment *env ) {
-  Obj *rhs = mValue->Eval( env ) ;
-  if ( rhs == NULL )
-    return NULL;
+  Obj *var = NULL;
+  var = new Boolean( result, "Boolean" );
+  return var;
+} // SymbolExpression::EvalNode()
 
-  string varName = mName->Value( ) ;
-  Obj *var = env -> Get( varName );
 
-  string var_value = var -> Value( );
-  string rhs_value = rhs -> Value( );
+class DeclareArrayExpression : public Expression {
+  Token *mTok;
+  Expression* mSize;
+  string mValue;
+  string mType;
 
-  if ( mToken -> type == ASSIGN ) {
-    env -> Set( varName, rhs );
-    var = env -> Get( varName );
-  } // if
-  
-  else { 
-    Obj *result = NULL;
-    if ( var -> Type() == "Float" || rhs -> Type() == "Float" ) 
-      result = EvalFloat( var_value, rhs_value );
-    else if ( var -> Type() == "String" && rhs -> Type() == "String" ) 
-      result = EvalString( var_value, rhs_value );
-    else if ( var -> Type() == "Integer" && rhs -> Type() == "Integer" )
-      result = EvalInt( var_value, rhs_value );
-    else {
-      cout << "Invalid operation between : " << var -> Type() << " and "
-           << rhs -> Type();
-      return NULL;
-    } // else
+public:
+  DeclareArrayExpression( Token *tok, string val, Expression* size ) {
+    mValue = val;
+    mTok = tok;
+    mSize=  size;
+    mType = "Array Expression";
+  } // SymbolExpression()
 
-    env -> Set( varName,result ); 
-    var = env -> Get( varName ); 
-  } // else
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return mValue; 
+  } // Value()
+
+  void Expr( ) { 
+  } // Expr()
+
+  void Print( ) ;
   
-  return var;
-} // AssignmentExpr::Eval()
+  Obj *EvalNode( Environment *env ) ;
 
-void AssignmentExpr::Print( ) {
-  mName->Print( ) ;
-  cout << " = (";
-  mValue->Print( ) ;
-  cout << ") ";
-} // AssignmentExpr::Print()
+  void Serialize( AstWriter *out ) ;
+  static DeclareArrayExpression *Load( AstReader *in ) ;
+} ;
 
+void DeclareArrayExpression::Print() {
+  *gOut << mValue << "[";
+  mSize -> Print();
+  *gOut << "]"; 
+} // DeclareArrayExpression() 
 
-class Program : public Node {
+Obj *DeclareArrayExpression::EvalNode( Environment *env ) {
+  int size = 0; 
+  Obj* msize = mSize -> Eval( env );
+  size = GStringToInt( msize -> Value() );
+  *gOut << size;
+
+  for ( int i = 0; i < size; ++i ) {
+    stringstream ss;
+    ss << i;
+    string index = ss.str();
+    index = mValue + "[" + index + "]";
+
+    env -> Set( index, NULL );
+  } // for
+
+  return msize;
+} // DeclareArrayExpression::EvalNode()
+
+class SymbolExpression : public Expression {
+  Token *mTok;
+  string mValue;
+  string mType;
 
 public:
-  vector< Statement * > mBody;
+  SymbolExpression( Token *tok, string val ) {
+    mValue = val;
+    mTok = tok;
+    mType = "Symbol Expression";
+  } // SymbolExpression()
 
   string Type( ) { 
-    return "Program"; 
-  } // Type() 
+    return mType; 
+  } // Type()
 
   string Value( ) { 
-    return ""; 
+    return mValue; 
   } // Value()
 
-  void Append( Statement *stmt ) ;
+  void Expr( ) { 
+  } // Expr()
+
   void Print( ) ;
+  
+  Obj *EvalNode( Environment *env ) ;
 
-  Statement *Pop( ) ;
-  Obj *Eval( Environment *env ) ;
+  bool Compile( Bytecode *code ) {
+    code -> EmitLoad( mValue );
+    return true;
+  } // Compile()
+
+  void Serialize( AstWriter *out ) ;
+  static SymbolExpression *Load( AstReader *in ) ;
 };
 
-Obj *Program::Eval( Environment *env ) {
-  Obj *obj = NULL;
-  Statement *stmt = NULL;
-  while ( mBody.size( ) > 0 ) {
-    stmt = Pop( ) ;
-    obj = stmt->Eval( env ) ;
-    if ( obj == NULL ) 
-      return NULL;
-    // obj -> Inspect();
-  } // while
+void SymbolExpression::Print() {
+  *gOut << mValue;
+} // SymbolExpression::Print()
 
-  return obj;
-} // Program::Eval()
+Obj *SymbolExpression::EvalNode( Environment *env ) {
+  Obj *var = NULL;
+  var = env->Get( mValue ) ;
+  return var;
+} // SymbolExpression::EvalNode()
 
-Statement *Program::Pop( ) {
-  Statement *stmt = NULL;
-  if ( ! mBody.empty( ) ) {
-    stmt = mBody.front( ) ;
-    mBody.erase( mBody.begin( ) ) ;
+class UpdateExpression : public Expression {
+  Token *mOp;
+  Operator mOpr;
+  SymbolExpression *mId;
+  string mType;
+  bool mPrefix;
+public:
+  UpdateExpression( Token* tok, SymbolExpression *id, bool prefix ) {
+    mOp = tok;
+    mOpr = GOperatorOf( tok -> type );
+    mId = id;
+    mPrefix = prefix;
+    mType = "Update Expression";
+  } // UpdateExpression()
+  
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return mOp -> value; 
+  } // Value()
+
+  void Expr( ) { 
+  } // Expr()
+
+  void Print( ) ;
+  
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static UpdateExpression *Load( AstReader *in ) ;
+} ;
+
+void UpdateExpression::Print() {
+  *gOut << "(";
+  if ( mPrefix ) {
+    *gOut << mOp -> value; 
+    mId -> Print();
   } // if
+  
+  else { 
+    mId -> Print();
+    *gOut << mOp -> value;
+  } // else
 
-  return stmt;
-} // Program::Pop()
+  *gOut << ")"; 
+} // UpdateExpression::Print()
 
-void Program::Print( ) {
-  for ( int i = 0; i < mBody.size( ) ; ++i )
-    mBody [ i ]->Print( ) ;
-} // Program::Print()
+Obj *UpdateExpression::EvalNode( Environment *env ) {
+  Obj* obj = env -> Get( mId -> Value() ); 
+  Obj* res = NULL; 
+  if ( kOperandOf[ obj -> Kind() ] == INT_OPND || kOperandOf[ obj -> Kind() ] == FLOAT_OPND ) {
+    Integer one( 1, "Integer" );
+    res = GApply( mOpr, obj, &one );
+  } // if
+
+  env -> Set( mId -> Value(), res );
+  if ( mPrefix )
+    return res; 
+  return obj; 
+} // UpdateExpression::EvalNode()
+
+class Parameter : public Expression {
+  Token* mTok; // kind token
+  string mType;
+  SymbolExpression* mPara;
+  bool mPassByRef;
+
+public:
+  Parameter( Token *tok, SymbolExpression* para, bool pbr ) {
+    mTok = tok;
+    mType = "Parameter";
+    mPara = para; 
+    mPassByRef = pbr; 
+  } // Parameter()
+  
+  Parameter() {} // Parameter()
+
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return mPara -> Value(); 
+  } // Value()
+
+  void Expr( ) { 
+  } // Expr()
+
+  void Print( ) ;
+  
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static Parameter *Load( AstReader *in ) ;
+};
+
+void Parameter::Print() {
+  *gOut << mTok -> value << " " << mPara -> Value();
+} // Parameter::Print()
+
+// Register parameter to current env
+Obj* Parameter::EvalNode( Environment *env ) {
+  Obj* obj = NULL;
+  if ( mTok -> type == KEY_INT ) 
+    obj = new Integer( 0, "Integer");
+  else if ( mTok -> type ==  KEY_FLOAT )
+    obj = new Float( 0.0, "Float");
+  else if ( mTok -> type == KEY_STRING )
+    obj = new String( "", "String" );
+  
+  string name = mPara -> Value();
+  env -> Set( name, obj );
+  return obj;
+} // Parameter::EvalNode()
+
+class FunctionDeclaration;
+
+class Function : public Obj {
+  Token* mKind;
+  Expression* mName;
+  vector< Parameter* > mPara;
+  FunctionDeclaration *mDecl; // Owns the body, see FunctionDeclaration::Body()
+  Environment *mEnv;
+  string mType;
+public: 
+  Function( Token* kind, Expression* name, 
+           FunctionDeclaration* decl, Environment* env, 
+           vector< Parameter* > para ) {
+    mName = name;
+    mKind = kind; 
+    mPara = para;
+    mEnv = env;
+    mDecl = decl;
+    mType = "Function";
+    SetKind( FUNCTION_KIND );
+  } // Function()
+
+  Obj* Eval( Environment *env );
+  void Inspect();
+  string Type(); 
+  string Value();
+
+  Environment *GetEnv( ) {
+    return mEnv;
+  } // GetEnv() 
+
+  vector < Parameter *> GetParameter( ) {
+    return mPara;
+  } // GetParameter()
+} ;
+
+string Function::Value() {
+  string str = mKind -> value;
+  return str;
+} // Function::Value()
+
+string Function::Type() {
+  return mType;
+} // Function::Type()
+
+// A function of the interpreter itself, see GBuiltins()
+typedef Obj *( *BuiltinFn )( vector< Obj * > args );
+
+class Builtin : public Obj {
+  string mName;
+  BuiltinFn mFn;
+
+public:
+  Builtin( string name, BuiltinFn fn ) {
+    mName = name;
+    mFn = fn;
+    SetKind( BUILTIN_KIND );
+  } // Builtin()
+
+  Obj *Call( vector< Obj * > args ) {
+    return mFn( args );
+  } // Call()
+
+  Obj *Eval( Environment * /* env */ ) {
+    return NULL;
+  } // Eval()
+
+  void Inspect( ) {
+    *gOut << "builtin " << mName << "\n";
+  } // Inspect()
+
+  string Type( ) {
+    return "Builtin";
+  } // Type()
+
+  string Value( ) {
+    return mName;
+  } // Value()
+
+  Environment *GetEnv( ) {
+    return NULL;
+  } // GetEnv()
+
+  vector < Parameter *> GetParameter( ) {
+    vector< Parameter*> prm;
+    return prm;
+  } // GetParameter()
+} ;
+
+// stats() : print the runtime counters
+Obj *GStatsBuiltin( vector< Obj * > /* args */ ) {
+  gStats.Print( *gOut );
+  return new Null();
+} // GStatsBuiltin()
+
+// A run heap current on the first lookup must not take them
+map< string, Obj * > GMakeBuiltins( ) {
+  RunHeap *saved = gRunHeap;
+  gRunHeap = NULL;
+  map< string, Obj * > builtins;
+  builtins[ "stats" ] = new Builtin( "stats", GStatsBuiltin );
+  gRunHeap = saved;
+  return builtins;
+} // GMakeBuiltins()
+
+// Built once, read only afterwards
+map< string, Obj * > &GBuiltins( ) {
+  static map< string, Obj * > builtins = GMakeBuiltins();
+  return builtins;
+} // GBuiltins()
+
+RunHeap::~RunHeap( ) {
+  for ( size_t i = 0; i < mObjs.size(); ++i )
+    delete mObjs[ i ];
+  for ( size_t i = 0; i < mFrames.size(); ++i )
+    delete mFrames[ i ];
+} // RunHeap::~RunHeap()
+
+// Position of item in the sorted items, -1 if it is not one of them
+template < class T >
+long GIndexOf( const vector< T * > &items, T *item ) {
+  typename vector< T * >::const_iterator at = lower_bound( items.begin(), items.end(), item );
+  if ( at == items.end() || *at != item )
+    return -1;
+  return at - items.begin();
+} // GIndexOf()
+
+// Objects of other heaps are left alone, they are not ours to free
+void RunHeap::Mark( Obj *obj, vector< char > &objs, vector< char > &frames ) {
+  long at = GIndexOf( mObjs, obj );
+  if ( at < 0 || objs[ at ] )
+    return;
+
+  objs[ at ] = true;
+  if ( obj -> Kind() == FUNCTION_KIND )
+    MarkFrames( obj -> GetEnv(), objs, frames );
+  else if ( obj -> Kind() == RETURN_KIND )
+    Mark( obj -> Eval( NULL ), objs, frames );
+} // RunHeap::Mark()
+
+// A function declared in a call keeps the frames of that call
+void RunHeap::MarkFrames( Environment *env, vector< char > &objs, vector< char > &frames ) {
+  for ( ; env != NULL; env = env -> mOuter ) {
+    long at = GIndexOf( mFrames, env );
+    if ( at < 0 || frames[ at ] )
+      return;
+
+    frames[ at ] = true;
+    for ( VarMap::iterator it = env -> mVars.begin(); it != env -> mVars.end(); ++it )
+      Mark( it -> second, objs, frames );
+  } // for
+} // RunHeap::MarkFrames()
+
+// Free the objects and frames the variables of roots do not reach
+void RunHeap::Sweep( const vector< const VarMap * > &roots ) {
+  sort( mObjs.begin(), mObjs.end() );
+  sort( mFrames.begin(), mFrames.end() );
+  vector< char > objs( mObjs.size(), false ), frames( mFrames.size(), false );
+  for ( size_t r = 0; r < roots.size(); ++r )
+    for ( VarMap::const_iterator it = roots[ r ] -> begin(); it != roots[ r ] -> end(); ++it )
+      Mark( it -> second, objs, frames );
+
+  size_t kept = 0;
+  for ( size_t i = 0; i < mObjs.size(); ++i ) {
+    if ( objs[ i ] )
+      mObjs[ kept++ ] = mObjs[ i ];
+    else
+      delete mObjs[ i ];
+  } // for
+
+  mObjs.resize( kept );
+  kept = 0;
+  for ( size_t i = 0; i < mFrames.size(); ++i ) {
+    if ( frames[ i ] )
+      mFrames[ kept++ ] = mFrames[ i ];
+    else
+      delete mFrames[ i ];
+  } // for
+
+  mFrames.resize( kept );
+} // RunHeap::Sweep()
+
+// A body parsed on its first call did not parse or resolve. The script
+// already runs by then, main exits with 1 once it is done.
+atomic< bool > gBodyFailed( false );
+bool gCheckBodies = false; // --check-bodies, only set before any thread starts
+
+// Declarations of a script keep the tokens of their body and parse it
+// on the first call, see Parser::SkipBody()
+class FunctionDeclaration : public Statement {
+  Token* mTok; // Type token
+  SymbolExpression *mId;
+  vector< Parameter *> mParams;
+  BlockStatement *mBlockStmt;
+  vector< Token * > mBodyToks; // From { to }, until the body is parsed
+  AstPool *mPool; // Owner of the nodes of the body
+  atomic< bool > mParsed;
+  string mBodyErr; // Why the body did not parse
+  string mType;
+
+public:
+
+  FunctionDeclaration( Token* tok, SymbolExpression *id ) {
+    mTok = tok;
+    mId = id;
+    mBlockStmt = NULL;
+    mPool = NULL;
+    mParsed = true;
+    mType = "Function Declaration";
+  } // FunctionDeclaration()
+
+  void Append( Parameter* prm );
+
+  void SetBlock( BlockStatement* bstmt ) {
+    mBlockStmt = bstmt; 
+  } // SetBlock()
+
+  void Defer( const vector< Token * > &body ) {
+    mBodyToks = body;
+    mPool = gAstPool;
+    mParsed = false;
+  } // Defer()
+
+  BlockStatement *Body( Environment *closure ) ;
+
+  // The body is not parsed or not resolved yet, see Body()
+  bool Deferred( ) {
+    return ! mParsed.load( memory_order_acquire );
+  } // Deferred()
+
+  string Name( ) {
+    return mId -> Value();
+  } // Name()
+
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return ""; 
+  } // Value()
+
+
+  void Stmt( ) { 
+  } // Expr()
+
+  void Print( ) ;
+
+  Obj *EvalNode( Environment *env ) ;
+
+  void Declare( Environment *scope ) {
+    scope -> Set( mId -> Value(), NULL );
+  } // Declare()
+
+  void Serialize( AstWriter *out ) ;
+  static FunctionDeclaration *Load( AstReader *in ) ;
+
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + GHeapBytes( mParams ) + GHeapBytes( mBodyToks ) + GHeapBytes( mBodyErr );
+  } // HeapBytes()
+} ;
+
+void FunctionDeclaration::Append( Parameter* prm ) {
+  mParams.push_back( prm );
+} // FunctionDeclaration::Append()
+
+void FunctionDeclaration::Print() {
+  *gOut << mTok -> value << " " << mId -> Value() << "(";
+  for ( int i = 0; i < mParams.size(); ++i ) {
+    *gOut << " ";
+    mParams[i] -> Print();
+    if ( i + 1 < mParams.size() )
+      *gOut << ","; 
+  } // for
+  
+  *gOut << " ) {\n";
+  BlockStatement *body = Body( NULL );
+  vector <Statement *> stmts;
+  if ( body != NULL )
+    stmts = body -> GetStmts();
+  
+  for ( int i = 0; i < stmts.size(); ++i ) {
+    *gOut << "  ";
+    stmts[i] -> Print();
+  } // for
+
+  *gOut << "}\n";
+} // FunctionDeclaration::Print()
+
+// The function closes over the environment it is declared in
+Obj* FunctionDeclaration::EvalNode( Environment* env ) {
+  Obj *obj = new Function( mTok, mId, this, env, mParams );
+  env -> Set( mId -> Value(), obj ); 
+  return obj;
+}  // FunctionDeclaration::EvalNode() 
+
+Obj *Function::Eval( Environment *env ) {
+  BlockStatement *body = mDecl -> Body( mEnv );
+  if ( body == NULL )
+    return NULL;
+
+  Obj* blockObj = body -> Eval( env );
+  return blockObj;
+} // Function::Eval()
+
+void Function::Inspect() {
+  *gOut << mKind -> value << " ";
+  mName -> Print();
+  *gOut << " (";
+  for ( size_t i = 0; i < mPara.size(); ++i ) {
+    mPara[i] -> Print(); 
+    if ( i + 1 < mPara.size() )
+      *gOut << ", ";
+  } // for
+
+  *gOut << ") \n";
+  BlockStatement *body = mDecl -> Body( mEnv );
+  if ( body != NULL )
+    body -> Print();
+} // Function::Inspect()
+
+// The function a call site found last and the environment it looked in,
+// valid while the epoch of its root has not moved. Threads running the same AST
+// share it, the sequence number keeps them from using half an update.
+class CallCache {
+  atomic< unsigned > mSeq; // Odd while being written
+  atomic< Environment * > mScope;
+  atomic< unsigned long > mEpoch;
+  atomic< Obj * > mFunction;
+
+public:
+  CallCache( ) : mSeq( 0 ), mScope( NULL ), mEpoch( 0 ), mFunction( NULL ) {
+  } // CallCache()
+
+  Obj *Find( Environment *scope, unsigned long epoch ) ;
+  void Store( Environment *scope, unsigned long epoch, Obj *function ) ;
+};
+
+// NULL if the cache holds nothing for scope at epoch
+Obj *CallCache::Find( Environment *scope, unsigned long epoch ) {
+  unsigned seq = mSeq.load( memory_order_acquire );
+  if ( seq & 1 )
+    return NULL;
+
+  Obj *function = NULL;
+  if ( mScope.load( memory_order_relaxed ) == scope && 
+       mEpoch.load( memory_order_relaxed ) == epoch )
+    function = mFunction.load( memory_order_relaxed );
+  atomic_thread_fence( memory_order_acquire );
+  if ( mSeq.load( memory_order_relaxed ) != seq )
+    return NULL;
+  return function;
+} // CallCache::Find()
+
+// Left as it is when another thread is writing it
+void CallCache::Store( Environment *scope, unsigned long epoch, Obj *function ) {
+  unsigned seq = mSeq.load( memory_order_relaxed );
+  if ( ( seq & 1 ) || ! mSeq.compare_exchange_strong( seq, seq + 1, memory_order_acquire ) )
+    return;
+
+  atomic_thread_fence( memory_order_release );
+  mScope.store( scope, memory_order_relaxed );
+  mEpoch.store( epoch, memory_order_relaxed );
+  mFunction.store( function, memory_order_relaxed );
+  mSeq.store( seq + 2, memory_order_release );
+} // CallCache::Store()
+
+class CallExpression : public Expression {
+  Expression* mName; // Callee, looked up when the call is evaluated
+  vector < Expression* > mArgs;
+  bool mPastFrames; // The callee is no name of the call frame, see Resolver
+  CallCache mCache;
+  string mValue;
+  string mType;
+
+  Obj *Callee( Environment *env ) ;
+
+public:
+  CallExpression( Expression *fid, vector< Expression*> args ) {
+    mName = fid;
+    mArgs = args;
+    mPastFrames = false;
+    mType = "Call Expression";
+    mValue = "";
+  } // CallExpression()
+
+  void LookPastFrames( ) {
+    mPastFrames = true;
+  } // LookPastFrames()
+
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return mValue; 
+  } // Value()
+
+  void Expr( ) { 
+  } // Expr()
+
+  void Print( ) ;
+  Obj* ApplyFunction( Obj* function, vector< Obj* > args, Environment* caller );
+  Environment* ExtendFunctionEnv( Obj* function, vector< Obj* > args,
+                                  Environment* caller ); 
+  Obj *EvalNode( Environment *env ) ;
+
+  vector < Parameter *> GetParameter( ) {
+    vector< Parameter*> prm;
+    return prm;
+  } // GetParameter()
+
+  void Serialize( AstWriter *out ) ;
+  static CallExpression *Load( AstReader *in ) ;
+
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + GHeapBytes( mArgs );
+  } // HeapBytes()
+} ;
+
+void CallExpression::Print() {
+  *gOut << mName -> Value();
+  *gOut << "( ";
+  for ( int i = 0; i < mArgs.size(); ++i ) {
+    mArgs[i] -> Print();
+    if ( i + 1 < mArgs.size() )
+      *gOut << ", ";
+  } // for 
+  *gOut << ") ";
+} // CallExpression::Print(); 
+
+Environment* CallExpression::ExtendFunctionEnv( Obj* function, 
+                                               vector< Obj* > args,
+                                               Environment* caller ) {
+  // A function taken from a snapshot sees the globals of the fork it is
+  // called from, not the ones it was declared in
+  Environment* closure = function -> GetEnv();
+  Environment* root = caller -> Root();
+  if ( root != closure && root -> Derives( closure ) )
+    closure = root;
+
+  // Every call gets its own environment enclosed by the function's one
+  Environment* env = Environment::NewFrame( closure );
+  // Register the parameter
+  vector < Parameter* > parameter = function -> GetParameter();
+
+  // Update the inner environment variable to equal to args
+  for ( size_t i = 0; i < parameter.size() && i < args.size(); i++ ) {
+    string name = parameter[i] -> Value();
+    env -> Set( name, args[i] ); 
+  } // for
+
+  return env;
+} // CallExpression::ExtendFunctionEnv()
+
+
+Obj* CallExpression::ApplyFunction( Obj* function, vector< Obj* > args,
+                                    Environment* caller ) {
+  if ( function -> Kind() == BUILTIN_KIND )
+    return ( ( Builtin * ) function ) -> Call( args );
+
+  if ( function -> Kind() != FUNCTION_KIND ) 
+    return NULL;
+
+  Environment *extendEnv = ExtendFunctionEnv( function, args, caller );
+  STAT( ++gStats.calls );
+  STAT( gStats.maxDepth = max( gStats.maxDepth, ++gStats.depth ) );
+  // Evaluate the block statement
+  Obj* blockStmt = function -> Eval( extendEnv );
+  STAT( --gStats.depth );
+  if ( blockStmt != NULL && blockStmt -> Kind() == RETURN_KIND ) {
+
+    if ( function -> Value() == "void" ) {
+      *gOut << "Error : Void function should not return a value." << "\n";
+      return NULL; 
+    } // if 
+
+    // The caller gets the value, not the Return wrapping it
+    return blockStmt -> Eval( NULL );
+  } // if
+
+  return blockStmt;
+} // CallExpression::ApplyFunction() 
+
+Obj* CallExpression::EvalNode( Environment *env ) {
+  vector < Obj* > args;
+  for ( int i = 0; i < mArgs.size(); ++i ) {
+    Obj* arg = mArgs[i] -> Eval( env );
+    if ( arg != NULL )
+      args.push_back( arg );
+  } // for
+
+  Obj* function = Callee( env );
+  if ( function == NULL ) {
+    *gOut << "Undefined identifier : '" << mName -> Value() << "'\n";
+    return NULL;
+  } // if
+
+  Obj* ret = ApplyFunction( function, args, env );
+  return ret; 
+} // CallExpression::EvalNode()
+
+// A callee the frames can not hold is looked up in the first environment
+// past them, and only when the cache has nothing for it there
+Obj *CallExpression::Callee( Environment *env ) {
+  if ( ! mPastFrames )
+    return env -> Get( mName -> Value() );
+
+  Environment *scope = env;
+  while ( scope -> IsFrame() && scope -> Outer() != NULL )
+    scope = scope -> Outer();
+
+  unsigned long epoch = scope -> Epoch();
+  Obj *function = mCache.Find( scope, epoch );
+  if ( function != NULL )
+    return function;
+
+  STAT( ++gStats.callMisses );
+  function = scope -> Get( mName -> Value() );
+  if ( GCallable( function ) )
+    mCache.Store( scope, epoch, function );
+  return function;
+} // CallExpression::Callee()
+
+
+class DeclarationStatement : public Statement {
+  Token* mTok; // Type token
+  vector < Expression* > mIds;
+  string mType;
+
+public: 
+  DeclarationStatement( Token* tok ) {
+    mTok = tok;
+    mType = "Declaration statement";
+  } // DeclarationStatement()
+
+  void Stmt( ) {
+  } // Stmt()
+  
+  void Append( Token* id ); 
+  void Print( ) ;
+  string Type( ) ;
+  string Value( ) ;
+
+  void AppendArr( Expression* expr ); 
+  Obj *EvalNode( Environment *env ) ;
+  void Declare( Environment *scope ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static DeclarationStatement *Load( AstReader *in ) ;
+
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + GHeapBytes( mIds );
+  } // HeapBytes()
+};
+
+void DeclarationStatement::Declare( Environment *scope ) {
+  for ( size_t i = 0; i < mIds.size(); ++i ) 
+    scope -> Set( mIds[i] -> Value(), NULL );
+} // DeclarationStatement::Declare()
+
+void DeclarationStatement::AppendArr( Expression* expr ) {
+  mIds.push_back( expr );
+} // DeclarationStatement::Append()
+
+void DeclarationStatement::Append( Token* id ) {
+  SymbolExpression *symbol = new SymbolExpression( id, id -> value);
+  symbol -> SetSpan( id, id );
+  mIds.push_back( symbol );
+} // DeclarationStatement::Append()
+
+void DeclarationStatement::Print() {
+  *gOut << mTok -> value << " ";
+  for ( int i = 0; i < mIds.size(); ++i ) {
+    mIds[i] -> Print();
+    if ( i + 1 < mIds.size() )
+      *gOut << ", ";  
+  } // for 
+  *gOut << ";";
+} // DeclarationStatement::Print()
+
+string DeclarationStatement::Type() {
+  return mType; 
+} // DeclarationStatement::Type()
+
+string DeclarationStatement::Value() {
+  return mTok -> value;
+} // DeclarationStatement::Value()
+
+Obj *DeclarationStatement::EvalNode( Environment *env ) {
+  TokenType tp = mTok -> type;
+  Obj* obj = NULL;
+  
+  if ( tp == KEY_INT )
+    obj = new Integer( 0, "Integer" );
+  
+  else if ( tp == KEY_FLOAT )
+    obj = new Float( 0.0, "FLoat" );
+
+  else if ( tp == KEY_STRING ) 
+    obj = new String( "String", "" );
+
+  else if ( tp == KEY_BOOL )
+    obj = new Boolean( false, "Boolean" );
+
+  for ( int i = 0; i < mIds.size(); ++i ) { 
+    if ( mIds[i] -> Type() != "Array Expression" ) 
+      env -> Set( mIds[i] -> Value(), obj );
+    else 
+      mIds[i] -> Eval( env );
+  } // for
+
+  return obj;
+} //  DeclarationStatment::EvalNode()
+
+class UnaryExpression : public Expression {
+  Token *mOp;
+  Expression *mRhs;
+  string mType;
+
+public:
+  UnaryExpression( Token *op, Expression *right ) {
+    mOp = op;
+    mRhs = right;
+    mType = "Unary expression";
+  } // UnaryExpression()
+
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return ""; 
+  } // Value()
+
+  void Expr( ) { 
+  } // Expr()
+
+  void Print( ) ;
+  
+  Obj *EvalNode( Environment *env ) ;
+  Obj *EvalPlusMinus( Environment *env ) ;
+  bool Compile( Bytecode *code ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static UnaryExpression *Load( AstReader *in ) ;
+};
+
+bool UnaryExpression::Compile( Bytecode *code ) {
+  if ( mOp -> type != PLUS && mOp -> type != MINUS )
+    return false;
+  if ( ! mRhs -> Compile( code ) )
+    return false;
+
+  if ( mOp -> type == MINUS )
+    code -> EmitNeg();
+  return true;
+} // UnaryExpression::Compile()
+
+Obj *UnaryExpression::EvalPlusMinus( Environment *env ) {
+  Obj *rhs = mRhs->Eval( env ) ;
+  if ( rhs == NULL )
+    return NULL;
+
+  return GApplyUnary( mOp -> type == MINUS, rhs );
+} // UnaryExpression::EvalPlusMinus()
+
+Obj *UnaryExpression::EvalNode( Environment *env ) {
+  Obj *result = NULL;
+  if ( mOp->type == PLUS || mOp->type == MINUS ) {
+    result = EvalPlusMinus( env ) ;
+  } // if
+
+  return result;
+} // UnaryExpression::EvalNode()
+
+void UnaryExpression::Print( ) {
+  *gOut << "( ";
+  *gOut << mOp->value;
+  mRhs->Print( ) ;
+  *gOut << ") ";
+} // UnaryExpression::Print()
+
+// ------------------------------- Statements --------------------------
+class ReturnStmt : public Statement {
+  Token *mTok;
+  Expression* mReturnValue;
+  string mType; 
+
+public:
+  ReturnStmt( Token* tok, Expression* value) {
+    mTok = tok;
+    mReturnValue = value; 
+    mType = "Return Statement";
+  } // ReturnStmt()
+  
+  void Stmt() {}
+
+  void Print();
+  string Type(); 
+  string Value();
+  Obj* EvalNode( Environment* env );
+
+  void Serialize( AstWriter *out ) ;
+  static ReturnStmt *Load( AstReader *in ) ;
+} ;
+
+Obj* ReturnStmt::EvalNode( Environment* env ) {
+  Obj *obj = mReturnValue -> Eval( env );
+  Obj *res = new Return( obj );
+  return res;
+} // ReturnStmt::EvalNode()
+
+string ReturnStmt::Type() {
+  return mType;
+} // ReturnStmt::Type()
+
+string ReturnStmt::Value() {
+  return "";
+} // ReturnStmt::Value()
+
+void ReturnStmt::Print() {
+  *gOut << mTok -> value << " ";
+  mReturnValue -> Print();
+  *gOut << ";\n";
+} // ReturnStmt::Print()
+
+// ------------------------------- Statements --------------------------
+class AssignmentExpr : public Expression {
+  Token *mToken; // Operator token 
+  Operator mOpr; // Operator of a compound assignment
+  Expression *mName; // Variable name
+  Expression *mValue;
+  string mType;
+
+public:
+  AssignmentExpr( Token *token, Expression *name, Expression *value ) {
+    mToken = token;
+    mOpr = GOperatorOf( token -> type );
+    mName = name;
+    mValue = value;
+    mType = "Assignment Expression";
+  } // AssignmentExpr()
+
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return ""; 
+  } // Value()
+
+  void Expr( ) {
+  } // Stmt()
+
+  void Print( ) ;
+
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static AssignmentExpr *Load( AstReader *in ) ;
+};
+
+Obj *AssignmentExpr::EvalNode( Environment *env ) {
+  Obj *rhs = mValue->Eval( env ) ;
+  if ( rhs == NULL )
+    return NULL;
+
+  string varName = mName->Value( ) ;
+  Obj *var = env -> Get( varName );
+
+  if ( mToken -> type == ASSIGN ) {
+    env -> Set( varName, rhs );
+    var = env -> Get( varName );
+  } // if
+  
+  else { 
+    if ( GZeroDivisor( mOpr, var, rhs ) ) {
+      *gOut << "Division by zero\n";
+      return NULL;
+    } // if
+
+    Obj *result = GApply( mOpr, var, rhs );
+    if ( result == NULL ) {
+      *gOut << "Invalid operation between : " << var -> Type() << " and "
+           << rhs -> Type();
+      return NULL;
+    } // else
+
+    env -> Set( varName,result ); 
+    var = env -> Get( varName ); 
+  } // else
+  
+  return var;
+} // AssignmentExpr::EvalNode()
+
+void AssignmentExpr::Print( ) {
+  mName->Print( ) ;
+  *gOut << " = (";
+  mValue->Print( ) ;
+  *gOut << ") ";
+} // AssignmentExpr::Print()
+
+
+class Program : public Node {
+
+public:
+  vector< Statement * > mBody;
+
+  string Type( ) { 
+    return "Program"; 
+  } // Type() 
+
+  string Value( ) { 
+    return ""; 
+  } // Value()
+
+  void Append( Statement *stmt ) ;
+  void Print( ) ;
+  bool Resolve( Environment *scope, string *err ) ;
+
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static Program *Load( AstReader *in ) ;
+
+  size_t HeapBytes( ) {
+    return Node::HeapBytes() + GHeapBytes( mBody );
+  } // HeapBytes()
+};
+
+// The body is left untouched, so a parsed program can run many times
+Obj *Program::EvalNode( Environment *env ) {
+  Obj *obj = NULL;
+  for ( size_t i = 0; i < mBody.size( ) && ( i == 0 || obj != NULL ) ; ++i ) {
+    gCurrentStmt = mBody[ i ];
+    obj = mBody[ i ]->Eval( env ) ;
+  } // for
+
+  gCurrentStmt = NULL;
+  return obj;
+} // Program::EvalNode()
+
+void Program::Print( ) {
+  for ( int i = 0; i < mBody.size( ) ; ++i )
+    mBody [ i ]->Print( ) ;
+} // Program::Print()
+
+void Program::Append( Statement *stmt ) { 
+  mBody.push_back( stmt ) ; 
+} // Program::Append()
+
+class ExpressionStatement : public Statement {
+  Token *mToken;
+  Expression *mExpr;
+  string mType;
+
+public:
+  ExpressionStatement( Expression *expr, Token *token ) {
+    mExpr = expr;
+    mToken = token;
+    mType = "Expression Statement";
+  } // ExpressionStatement()
+
+  Expression *Expr( ) { 
+    return mExpr; 
+  } // Expr()
+
+  string Type( ) { 
+    return mType; 
+  } // Type()
+
+  string Value( ) { 
+    return ""; 
+  } // Value()
+
+  void Stmt( ) {
+  } // Stmt()
+
+  void Print( ) ;
+  
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static ExpressionStatement *Load( AstReader *in ) ;
+};
+
+Obj *ExpressionStatement::EvalNode( Environment *env ) {
+  Obj *obj = mExpr->Eval( env ) ;
+  return obj;
+} // ExpressionStatement::EvalNode()
+
+void ExpressionStatement::Print( ) {
+  mExpr->Print( ) ;
+  *gOut << ";\n";
+} // ExpressionStatement::Print()
+
+class NullStatement : public Statement {
+  string mType;
+
+public:
+  NullStatement( ) { 
+    mType = "Null Statement"; 
+  } // NullStatement()
+
+  string Value( ) { 
+    return ""; 
+  } // Value()
+
+  void Stmt( ) {
+  } // Stmt()
+
+  string Type( ) ;
+  void Print( ) ;
+  Obj *EvalNode( Environment *env ) ;
+
+  void Serialize( AstWriter *out ) ;
+  static NullStatement *Load( AstReader *in ) ;
+};
+
+Obj *NullStatement::EvalNode( Environment * /* env */ ) {
+  Obj *obj = new Null( ) ;
+  return obj;
+} // NullStatement::EvalNode()
+
+string NullStatement::Type( ) { return mType; } // NullStatement::Type()
+
+void NullStatement::Print( ) { *gOut << ";\n"; } // NullStatement::Print()
+
+// ---------------------------- AST image codec -------------------
+class BinaryAstWriter : public AstWriter {
+  string mBuf;
+
+  void WriteByte( unsigned int v ) {
+    mBuf += ( char ) ( v & 0xff );
+  } // WriteByte()
+
+  void WriteVarint( unsigned long long v ) ;
+
+public:
+  void WriteHeader( ) ;
+
+  void BeginNode( NodeKind kind, const Span &span ) ;
+
+  void EndNode( ) {
+  } // EndNode()
+
+  void WriteInt( const char *field, long long v ) ;
+  void WriteFloat( const char *field, float v ) ;
+  void WriteString( const char *field, const string &str ) ;
+  void WriteToken( const char *field, Token *tok ) ;
+  void WriteNode( const char *field, Node *node ) ;
+  void BeginList( const char *field, size_t count ) ;
+
+  void EndList( ) {
+  } // EndList()
+
+  const string &Bytes( ) {
+    return mBuf;
+  } // Bytes()
+};
+
+void BinaryAstWriter::WriteVarint( unsigned long long v ) {
+  while ( v >= 0x80 ) {
+    WriteByte( v | 0x80 );
+    v >>= 7;
+  } // while
+
+  WriteByte( v );
+} // BinaryAstWriter::WriteVarint()
+
+void BinaryAstWriter::WriteHeader( ) {
+  mBuf.append( kAstMagic, sizeof( kAstMagic ) );
+  for ( int i = 0; i < 4; ++i )
+    WriteByte( kAstVersion >> ( 8 * i ) );
+} // BinaryAstWriter::WriteHeader()
+
+void BinaryAstWriter::BeginNode( NodeKind kind, const Span &span ) {
+  WriteByte( kind );
+  WriteInt( "line", span.line );
+  WriteInt( "column", span.column );
+  WriteInt( "endLine", span.endLine );
+  WriteInt( "endColumn", span.endColumn );
+} // BinaryAstWriter::BeginNode()
+
+// Zigzag, so small negative values stay short
+void BinaryAstWriter::WriteInt( const char * /* field */, long long v ) {
+  WriteVarint( ( ( unsigned long long ) v << 1 ) ^ ( unsigned long long ) ( v >> 63 ) );
+} // BinaryAstWriter::WriteInt()
+
+void BinaryAstWriter::WriteFloat( const char * /* field */, float v ) {
+  unsigned int bits = 0;
+  memcpy( &bits, &v, sizeof( bits ) );
+  for ( int i = 0; i < 4; ++i )
+    WriteByte( bits >> ( 8 * i ) );
+} // BinaryAstWriter::WriteFloat()
+
+void BinaryAstWriter::WriteString( const char * /* field */, const string &str ) {
+  WriteVarint( str.size() );
+  mBuf += str;
+} // BinaryAstWriter::WriteString()
+
+void BinaryAstWriter::WriteToken( const char * /* field */, Token *tok ) {
+  if ( tok == NULL ) {
+    WriteByte( 0 );
+    return;
+  } // if
+
+  WriteByte( 1 );
+  WriteVarint( tok -> type );
+  WriteString( "value", tok -> value );
+  WriteInt( "line", tok -> line );
+  WriteInt( "column", tok -> column );
+} // BinaryAstWriter::WriteToken()
+
+void BinaryAstWriter::WriteNode( const char * /* field */, Node *node ) {
+  if ( node == NULL )
+    WriteByte( NO_NODE );
+  else
+    node -> Serialize( this );
+} // BinaryAstWriter::WriteNode()
+
+void BinaryAstWriter::BeginList( const char * /* field */, size_t count ) {
+  WriteVarint( count );
+} // BinaryAstWriter::BeginList()
+
+class BinaryAstReader : public AstReader {
+  const unsigned char *mPos;
+  const unsigned char *mEnd;
+
+  unsigned int ReadByte( ) ;
+  unsigned long long ReadVarint( ) ;
+
+protected:
+  bool BeginNode( const char *field, NodeKind &kind, Span &span ) ;
+
+  void EndNode( ) {
+  } // EndNode()
+
+public:
+  BinaryAstReader( const char *data, size_t size ) {
+    mPos = ( const unsigned char * ) data;
+    mEnd = mPos + size;
+  } // BinaryAstReader()
+
+  static bool IsImage( const char *data, size_t size ) ;
+
+  bool ReadHeader( ) ;
+  long long ReadInt( const char *field ) ;
+  float ReadFloat( const char *field ) ;
+  string ReadString( const char *field ) ;
+  Token *ReadToken( const char *field, bool optional = false ) ;
+  size_t BeginList( const char *field ) ;
+
+  void EndList( ) {
+  } // EndList()
+
+  bool AtEnd( ) {
+    return mPos == mEnd;
+  } // AtEnd()
+};
+
+unsigned int BinaryAstReader::ReadByte( ) {
+  if ( mPos >= mEnd ) {
+    mBad = true;
+    return 0;
+  } // if
+
+  return *mPos++;
+} // BinaryAstReader::ReadByte()
+
+unsigned long long BinaryAstReader::ReadVarint( ) {
+  unsigned long long v = 0;
+  for ( int shift = 0; shift < 64 ; shift += 7 ) {
+    unsigned int byte = ReadByte();
+    v |= ( unsigned long long ) ( byte & 0x7f ) << shift;
+    if ( ( byte & 0x80 ) == 0 )
+      return v;
+  } // for
+
+  mBad = true;
+  return 0;
+} // BinaryAstReader::ReadVarint()
+
+bool BinaryAstReader::IsImage( const char *data, size_t size ) {
+  return size >= sizeof( kAstMagic ) &&
+         memcmp( data, kAstMagic, sizeof( kAstMagic ) ) == 0;
+} // BinaryAstReader::IsImage()
+
+bool BinaryAstReader::ReadHeader( ) {
+  if ( ! IsImage( ( const char * ) mPos, mEnd - mPos ) )
+    return false;
+
+  mPos += sizeof( kAstMagic );
+  unsigned int version = 0;
+  for ( int i = 0; i < 4; ++i )
+    version |= ReadByte() << ( 8 * i );
+  return version == kAstVersion && ! mBad;
+} // BinaryAstReader::ReadHeader()
+
+bool BinaryAstReader::BeginNode( const char * /* field */, NodeKind &kind, Span &span ) {
+  unsigned int tag = ReadByte();
+  if ( mBad || tag == NO_NODE )
+    return false;
+  if ( tag > NO_NODE ) {
+    mBad = true;
+    return false;
+  } // if
+
+  kind = ( NodeKind ) tag;
+  span.line = ReadInt( "line" );
+  span.column = ReadInt( "column" );
+  span.endLine = ReadInt( "endLine" );
+  span.endColumn = ReadInt( "endColumn" );
+  return true;
+} // BinaryAstReader::BeginNode()
+
+long long BinaryAstReader::ReadInt( const char * /* field */ ) {
+  unsigned long long v = ReadVarint();
+  return ( long long ) ( v >> 1 ) ^ -( long long ) ( v & 1 );
+} // BinaryAstReader::ReadInt()
+
+float BinaryAstReader::ReadFloat( const char * /* field */ ) {
+  unsigned int bits = 0;
+  for ( int i = 0; i < 4; ++i )
+    bits |= ReadByte() << ( 8 * i );
+
+  float v = 0;
+  memcpy( &v, &bits, sizeof( v ) );
+  return v;
+} // BinaryAstReader::ReadFloat()
+
+string BinaryAstReader::ReadString( const char * /* field */ ) {
+  unsigned long long size = ReadVarint();
+  if ( mBad || size > ( unsigned long long ) ( mEnd - mPos ) ) {
+    mBad = true;
+    return "";
+  } // if
+
+  string str( ( const char * ) mPos, size );
+  mPos += size;
+  return str;
+} // BinaryAstReader::ReadString()
+
+Token *BinaryAstReader::ReadToken( const char * /* field */, bool optional ) {
+  bool present = ReadByte() != 0;
+  if ( ! present && ! optional )
+    mBad = true;
+  if ( ! present && ! mBad )
+    return NULL;
+
+  Token *tok = new Token();
+  if ( ! present )
+    return tok;
+
+  unsigned long long type = ReadVarint();
+  if ( type >= TOKEN_TYPE_COUNT )
+    mBad = true;
+  else
+    tok -> type = ( TokenType ) type;
+  tok -> value = ReadString( "value" );
+  tok -> line = ReadInt( "line" );
+  tok -> column = ReadInt( "column" );
+  return tok;
+} // BinaryAstReader::ReadToken()
+
+size_t BinaryAstReader::BeginList( const char * /* field */ ) {
+  return ReadVarint();
+} // BinaryAstReader::BeginList()
+
+// Builds the document as the tree is walked. mStack holds the object or
+// array being filled, a field of an array is its next element.
+class JsonAstWriter : public AstWriter {
+  Json mRoot;
+  vector< Json * > mStack;
+  const char *mField; // Field of the node WriteNode is writing
+
+  Json &Slot( const char *field ) ;
+
+public:
+  JsonAstWriter( ) {
+    mRoot[ "format" ] = "PAST";
+    mRoot[ "version" ] = kAstVersion;
+    mField = "program";
+  } // JsonAstWriter()
+
+  void BeginNode( NodeKind kind, const Span &span ) ;
+
+  void EndNode( ) {
+    mStack.pop_back();
+  } // EndNode()
+
+  void WriteInt( const char *field, long long v ) ;
+  void WriteFloat( const char *field, float v ) ;
+  void WriteString( const char *field, const string &str ) ;
+  void WriteToken( const char *field, Token *tok ) ;
+  void WriteNode( const char *field, Node *node ) ;
+  void BeginList( const char *field, size_t count ) ;
+
+  void EndList( ) {
+    mStack.pop_back();
+  } // EndList()
+
+  string Dump( ) ;
+};
+
+Json &JsonAstWriter::Slot( const char *field ) {
+  if ( mStack.empty() )
+    return mRoot[ field ];
+
+  Json &top = *mStack.back();
+  if ( ! top.is_array() )
+    return top[ field ];
+
+  top.push_back( Json() );
+  return top.back();
+} // JsonAstWriter::Slot()
+
+void JsonAstWriter::BeginNode( NodeKind kind, const Span &span ) {
+  Json &node = Slot( mField );
+  node = Json::object();
+  node[ "kind" ] = kNodeKindNames[ kind ];
+  node[ "span" ] = { span.line, span.column, span.endLine, span.endColumn };
+  mStack.push_back( &node );
+} // JsonAstWriter::BeginNode()
+
+void JsonAstWriter::WriteInt( const char *field, long long v ) {
+  Slot( field ) = v;
+} // JsonAstWriter::WriteInt()
+
+void JsonAstWriter::WriteFloat( const char *field, float v ) {
+  Slot( field ) = v;
+} // JsonAstWriter::WriteFloat()
+
+void JsonAstWriter::WriteString( const char *field, const string &str ) {
+  Slot( field ) = str;
+} // JsonAstWriter::WriteString()
+
+void JsonAstWriter::WriteToken( const char *field, Token *tok ) {
+  Json &slot = Slot( field );
+  if ( tok == NULL )
+    return;
+
+  slot[ "type" ] = kTokenTypeNames[ tok -> type ];
+  slot[ "value" ] = tok -> value;
+  slot[ "line" ] = tok -> line;
+  slot[ "column" ] = tok -> column;
+} // JsonAstWriter::WriteToken()
+
+void JsonAstWriter::WriteNode( const char *field, Node *node ) {
+  if ( node == NULL ) {
+    Slot( field );
+    return;
+  } // if
+
+  mField = field;
+  node -> Serialize( this );
+} // JsonAstWriter::WriteNode()
+
+void JsonAstWriter::BeginList( const char *field, size_t /* count */ ) {
+  Json &list = Slot( field );
+  list = Json::array();
+  mStack.push_back( &list );
+} // JsonAstWriter::BeginList()
+
+string JsonAstWriter::Dump( ) {
+  return mRoot.dump( 2 );
+} // JsonAstWriter::Dump()
+
+class JsonAstReader : public AstReader {
+  struct Frame {
+    const Json *value;
+    size_t next; // Next element, when value is an array
+  };
+
+  Json mRoot;
+  vector< Frame > mStack;
+
+  const Json *Slot( const char *field ) ;
+  void Enter( const Json *value ) ;
+
+protected:
+  bool BeginNode( const char *field, NodeKind &kind, Span &span ) ;
+
+  void EndNode( ) {
+    mStack.pop_back();
+  } // EndNode()
+
+public:
+  JsonAstReader( const string &text ) ;
+
+  long long ReadInt( const char *field ) ;
+  float ReadFloat( const char *field ) ;
+  string ReadString( const char *field ) ;
+  Token *ReadToken( const char *field, bool optional = false ) ;
+  size_t BeginList( const char *field ) ;
+
+  void EndList( ) {
+    mStack.pop_back();
+  } // EndList()
+};
+
+JsonAstReader::JsonAstReader( const string &text ) {
+  mRoot = Json::parse( text, NULL, false );
+  if ( ! mRoot.is_object() || mRoot.value( "format", "" ) != "PAST" ||
+       mRoot.value( "version", 0u ) != kAstVersion )
+    mBad = true;
+  else 
+    Enter( &mRoot );
+} // JsonAstReader::JsonAstReader()
+
+void JsonAstReader::Enter( const Json *value ) {
+  Frame frame;
+  frame.value = value;
+  frame.next = 0;
+  mStack.push_back( frame );
+} // JsonAstReader::Enter()
+
+// NULL if the field is missing
+const Json *JsonAstReader::Slot( const char *field ) {
+  if ( mBad || mStack.empty() )
+    return NULL;
+
+  Frame &top = mStack.back();
+  if ( top.value -> is_array() ) {
+    if ( top.next >= top.value -> size() )
+      return NULL;
+    return &( *top.value )[ top.next++ ];
+  } // if
+
+  Json::const_iterator it = top.value -> find( field );
+  if ( it == top.value -> end() )
+    return NULL;
+  return &*it;
+} // JsonAstReader::Slot()
+
+bool JsonAstReader::BeginNode( const char *field, NodeKind &kind, Span &span ) {
+  const Json *node = Slot( field );
+  if ( node == NULL || node -> is_null() )
+    return false;
+
+  Json::const_iterator name = node -> find( "kind" );
+  if ( ! node -> is_object() || name == node -> end() || ! name -> is_string() ) {
+    mBad = true;
+    return false;
+  } // if
+
+  int i = 0;
+  while ( i < NO_NODE && *name != kNodeKindNames[ i ] )
+    ++i;
+  if ( i == NO_NODE ) {
+    mBad = true;
+    return false;
+  } // if
+
+  kind = ( NodeKind ) i;
+  // The span is optional, so tools can hand write nodes
+  Json::const_iterator range = node -> find( "span" );
+  Enter( node );
+  if ( range != node -> end() && range -> is_array() ) {
+    Enter( &*range );
+    span.line = ReadInt( NULL );
+    span.column = ReadInt( NULL );
+    span.endLine = ReadInt( NULL );
+    span.endColumn = ReadInt( NULL );
+    mStack.pop_back();
+  } // if
+
+  return true;
+} // JsonAstReader::BeginNode()
+
+long long JsonAstReader::ReadInt( const char *field ) {
+  const Json *v = Slot( field );
+  if ( v == NULL || ! v -> is_number_integer() ) {
+    mBad = true;
+    return 0;
+  } // if
+
+  return v -> get< long long >();
+} // JsonAstReader::ReadInt()
+
+float JsonAstReader::ReadFloat( const char *field ) {
+  const Json *v = Slot( field );
+  if ( v == NULL || ! v -> is_number() ) {
+    mBad = true;
+    return 0;
+  } // if
+
+  return v -> get< float >();
+} // JsonAstReader::ReadFloat()
+
+string JsonAstReader::ReadString( const char *field ) {
+  const Json *v = Slot( field );
+  if ( v == NULL || ! v -> is_string() ) {
+    mBad = true;
+    return "";
+  } // if
+
+  return v -> get< string >();
+} // JsonAstReader::ReadString()
+
+Token *JsonAstReader::ReadToken( const char *field, bool optional ) {
+  const Json *v = Slot( field );
+  bool present = v != NULL && ! v -> is_null();
+  if ( ! present && ! optional )
+    mBad = true;
+  if ( ! present && ! mBad )
+    return NULL;
+
+  Token *tok = new Token();
+  if ( ! present || ! v -> is_object() ) {
+    mBad = true;
+    return tok;
+  } // if
+
+  Enter( v );
+  string type = ReadString( "type" );
+  int i = 0;
+  while ( i < TOKEN_TYPE_COUNT && type != kTokenTypeNames[ i ] )
+    ++i;
+  if ( i == TOKEN_TYPE_COUNT )
+    mBad = true;
+  else
+    tok -> type = ( TokenType ) i;
+  tok -> value = ReadString( "value" );
+  tok -> line = ReadInt( "line" );
+  tok -> column = ReadInt( "column" );
+  mStack.pop_back();
+  return tok;
+} // JsonAstReader::ReadToken()
+
+size_t JsonAstReader::BeginList( const char *field ) {
+  const Json *v = Slot( field );
+  if ( v == NULL || ! v -> is_array() ) {
+    mBad = true;
+    // Keep BeginList / EndList balanced
+    Enter( &mRoot );
+    return 0;
+  } // if
+
+  Enter( v );
+  return v -> size();
+} // JsonAstReader::BeginList()
+
+Node *AstReader::ReadNode( const char *field ) {
+  NodeKind kind;
+  Span span;
+  if ( mBad || ! BeginNode( field, kind, span ) )
+    return NULL;
+
+  Node *node = NULL;
+  switch ( kind ) {
+    case BLOCK_NODE : node = BlockStatement::Load( this ); break;
+    case CONDITIONAL_NODE : node = ConditionalExpr::Load( this ); break;
+    case INT_NODE : node = IntExpr::Load( this ); break;
+    case FLOAT_NODE : node = FloatExpr::Load( this ); break;
+    case CHAR_NODE : node = CharExpr::Load( this ); break;
+    case STRING_NODE : node = StringExpr::Load( this ); break;
+    case COUT_NODE : node = CoutExpr::Load( this ); break;
+    case CIN_NODE : node = CinExpr::Load( this ); break;
+    case BIN_NODE : node = BinExpr::Load( this ); break;
+    case BOOLEAN_NODE : node = BooleanExpression::Load( this ); break;
+    case ARRAY_NODE : node = DeclareArrayExpression::Load( this ); break;
+    case SYMBOL_NODE : node = SymbolExpression::Load( this ); break;
+    case UPDATE_NODE : node = UpdateExpression::Load( this ); break;
+    case PARAMETER_NODE : node = Parameter::Load( this ); break;
+    case FUNCTION_DECL_NODE : node = FunctionDeclaration::Load( this ); break;
+    case CALL_NODE : node = CallExpression::Load( this ); break;
+    case DECLARATION_NODE : node = DeclarationStatement::Load( this ); break;
+    case UNARY_NODE : node = UnaryExpression::Load( this ); break;
+    case RETURN_NODE : node = ReturnStmt::Load( this ); break;
+    case ASSIGNMENT_NODE : node = AssignmentExpr::Load( this ); break;
+    case PROGRAM_NODE : node = Program::Load( this ); break;
+    case EXPRESSION_STMT_NODE : node = ExpressionStatement::Load( this ); break;
+    case NULL_STMT_NODE : node = NullStatement::Load( this ); break;
+    default : mBad = true;
+  } // switch
+
+  EndNode();
+  if ( node != NULL )
+    node -> SetSpan( span );
+  return node;
+} // AstReader::ReadNode()
+
+// A child of the wrong kind, or a missing one that is not optional,
+// marks the reader bad
+template< class T >
+T *AstReader::ReadNodeAs( const char *field, bool optional ) {
+  Node *node = ReadNode( field );
+  T *typed = dynamic_cast< T * >( node );
+  if ( ( node != NULL && typed == NULL ) || ( node == NULL && ! optional ) )
+    mBad = true;
+  return typed;
+} // AstReader::ReadNodeAs()
+
+void BlockStatement::Serialize( AstWriter *out ) {
+  out -> BeginNode( BLOCK_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> BeginList( "statements", mStmts.size() );
+  for ( size_t i = 0; i < mStmts.size(); ++i )
+    out -> WriteNode( NULL, mStmts[ i ] );
+  out -> EndList();
+  out -> EndNode();
+} // BlockStatement::Serialize()
+
+BlockStatement *BlockStatement::Load( AstReader *in ) {
+  BlockStatement *block = new BlockStatement( in -> ReadToken( "token" ) );
+  size_t count = in -> BeginList( "statements" );
+  for ( size_t i = 0; i < count && ! in -> Bad(); ++i )
+    block -> Append( in -> ReadNodeAs< Statement >( NULL ) );
+  in -> EndList();
+  return block;
+} // BlockStatement::Load()
+
+void ConditionalExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( CONDITIONAL_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> WriteNode( "condition", mCondition );
+  out -> WriteNode( "consequence", mConsequence );
+  out -> WriteNode( "alternative", mAlternative );
+  out -> EndNode();
+} // ConditionalExpr::Serialize()
+
+ConditionalExpr *ConditionalExpr::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "token" );
+  Expression *cond = in -> ReadNodeAs< Expression >( "condition" );
+  BlockStatement *consequence = in -> ReadNodeAs< BlockStatement >( "consequence" );
+  BlockStatement *alternative = in -> ReadNodeAs< BlockStatement >( "alternative", true );
+  return new ConditionalExpr( tok, cond, consequence, alternative );
+} // ConditionalExpr::Load()
+
+void IntExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( INT_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> WriteInt( "value", mValue );
+  out -> EndNode();
+} // IntExpr::Serialize()
+
+IntExpr *IntExpr::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "token" );
+  size_t value = in -> ReadInt( "value" );
+  return new IntExpr( tok, value );
+} // IntExpr::Load()
+
+void FloatExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( FLOAT_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> WriteFloat( "value", mValue );
+  out -> EndNode();
+} // FloatExpr::Serialize()
+
+FloatExpr *FloatExpr::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "token" );
+  float value = in -> ReadFloat( "value" );
+  return new FloatExpr( tok, value );
+} // FloatExpr::Load()
+
+void CharExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( CHAR_NODE, GetSpan() );
+  out -> WriteString( "value", string( 1, mValue ) );
+  out -> EndNode();
+} // CharExpr::Serialize()
+
+CharExpr *CharExpr::Load( AstReader *in ) {
+  string value = in -> ReadString( "value" );
+  return new CharExpr( value.empty() ? '\0' : value[ 0 ] );
+} // CharExpr::Load()
+
+void StringExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( STRING_NODE, GetSpan() );
+  out -> WriteString( "value", mValue );
+  out -> EndNode();
+} // StringExpr::Serialize()
+
+StringExpr *StringExpr::Load( AstReader *in ) {
+  return new StringExpr( in -> ReadString( "value" ) );
+} // StringExpr::Load()
+
+void CoutExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( COUT_NODE, GetSpan() );
+  out -> BeginList( "args", mArgs.size() );
+  for ( size_t i = 0; i < mArgs.size(); ++i )
+    out -> WriteNode( NULL, mArgs[ i ] );
+  out -> EndList();
+  out -> EndNode();
+} // CoutExpr::Serialize()
+
+CoutExpr *CoutExpr::Load( AstReader *in ) {
+  CoutExpr *expr = new CoutExpr();
+  size_t count = in -> BeginList( "args" );
+  for ( size_t i = 0; i < count && ! in -> Bad(); ++i )
+    expr -> Append( in -> ReadNodeAs< Expression >( NULL ) );
+  in -> EndList();
+  return expr;
+} // CoutExpr::Load()
+
+void CinExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( CIN_NODE, GetSpan() );
+  out -> BeginList( "targets", mTargets.size() );
+  for ( size_t i = 0; i < mTargets.size(); ++i )
+    out -> WriteNode( NULL, mTargets[ i ] );
+  out -> EndList();
+  out -> EndNode();
+} // CinExpr::Serialize()
+
+CinExpr *CinExpr::Load( AstReader *in ) {
+  CinExpr *expr = new CinExpr();
+  size_t count = in -> BeginList( "targets" );
+  for ( size_t i = 0; i < count && ! in -> Bad(); ++i )
+    expr -> Append( in -> ReadNodeAs< Expression >( NULL ) );
+  in -> EndList();
+  return expr;
+} // CinExpr::Load()
+
+void BinExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( BIN_NODE, GetSpan() );
+  out -> WriteNode( "left", mLeft );
+  out -> WriteToken( "op", mOp );
+  out -> WriteNode( "right", mRight );
+  out -> EndNode();
+} // BinExpr::Serialize()
+
+BinExpr *BinExpr::Load( AstReader *in ) {
+  Expression *left = in -> ReadNodeAs< Expression >( "left" );
+  Token *op = in -> ReadToken( "op" );
+  Expression *right = in -> ReadNodeAs< Expression >( "right" );
+  // The constructor compiles both children, a damaged AST may lack them
+  if ( in -> Bad() )
+    return NULL;
+  return new BinExpr( left, op, right );
+} // BinExpr::Load()
+
+void BooleanExpression::Serialize( AstWriter *out ) {
+  out -> BeginNode( BOOLEAN_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> WriteString( "value", mValue );
+  out -> EndNode();
+} // BooleanExpression::Serialize()
+
+BooleanExpression *BooleanExpression::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "token" );
+  string value = in -> ReadString( "value" );
+  return new BooleanExpression( tok, value );
+} // BooleanExpression::Load()
+
+void DeclareArrayExpression::Serialize( AstWriter *out ) {
+  out -> BeginNode( ARRAY_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> WriteString( "name", mValue );
+  out -> WriteNode( "size", mSize );
+  out -> EndNode();
+} // DeclareArrayExpression::Serialize()
+
+DeclareArrayExpression *DeclareArrayExpression::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "token" );
+  string name = in -> ReadString( "name" );
+  Expression *size = in -> ReadNodeAs< Expression >( "size" );
+  return new DeclareArrayExpression( tok, name, size );
+} // DeclareArrayExpression::Load()
+
+void SymbolExpression::Serialize( AstWriter *out ) {
+  out -> BeginNode( SYMBOL_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> WriteString( "name", mValue );
+  out -> EndNode();
+} // SymbolExpression::Serialize()
+
+SymbolExpression *SymbolExpression::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "token" );
+  string name = in -> ReadString( "name" );
+  return new SymbolExpression( tok, name );
+} // SymbolExpression::Load()
+
+void UpdateExpression::Serialize( AstWriter *out ) {
+  out -> BeginNode( UPDATE_NODE, GetSpan() );
+  out -> WriteToken( "op", mOp );
+  out -> WriteNode( "id", mId );
+  out -> WriteInt( "prefix", mPrefix );
+  out -> EndNode();
+} // UpdateExpression::Serialize()
+
+UpdateExpression *UpdateExpression::Load( AstReader *in ) {
+  Token *op = in -> ReadToken( "op" );
+  SymbolExpression *id = in -> ReadNodeAs< SymbolExpression >( "id" );
+  bool prefix = in -> ReadInt( "prefix" ) != 0;
+  return new UpdateExpression( op, id, prefix );
+} // UpdateExpression::Load()
+
+void Parameter::Serialize( AstWriter *out ) {
+  out -> BeginNode( PARAMETER_NODE, GetSpan() );
+  out -> WriteToken( "type", mTok );
+  out -> WriteNode( "name", mPara );
+  out -> WriteInt( "byRef", mPassByRef );
+  out -> EndNode();
+} // Parameter::Serialize()
+
+Parameter *Parameter::Load( AstReader *in ) {
+  Token *kind = in -> ReadToken( "type" );
+  SymbolExpression *para = in -> ReadNodeAs< SymbolExpression >( "name" );
+  bool pbr = in -> ReadInt( "byRef" ) != 0;
+  return new Parameter( kind, para, pbr );
+} // Parameter::Load()
+
+void FunctionDeclaration::Serialize( AstWriter *out ) {
+  out -> BeginNode( FUNCTION_DECL_NODE, GetSpan() );
+  out -> WriteToken( "type", mTok );
+  out -> WriteNode( "name", mId );
+  out -> BeginList( "params", mParams.size() );
+  for ( size_t i = 0; i < mParams.size(); ++i )
+    out -> WriteNode( NULL, mParams[ i ] );
+  out -> EndList();
+  out -> WriteNode( "body", Body( NULL ) );
+  out -> EndNode();
+} // FunctionDeclaration::Serialize()
+
+FunctionDeclaration *FunctionDeclaration::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "type" );
+  SymbolExpression *id = in -> ReadNodeAs< SymbolExpression >( "name" );
+  FunctionDeclaration *func = new FunctionDeclaration( tok, id );
+  size_t count = in -> BeginList( "params" );
+  for ( size_t i = 0; i < count && ! in -> Bad(); ++i )
+    func -> Append( in -> ReadNodeAs< Parameter >( NULL ) );
+  in -> EndList();
+  func -> SetBlock( in -> ReadNodeAs< BlockStatement >( "body" ) );
+  return func;
+} // FunctionDeclaration::Load()
+
+void CallExpression::Serialize( AstWriter *out ) {
+  out -> BeginNode( CALL_NODE, GetSpan() );
+  out -> WriteNode( "callee", mName );
+  out -> BeginList( "args", mArgs.size() );
+  for ( size_t i = 0; i < mArgs.size(); ++i )
+    out -> WriteNode( NULL, mArgs[ i ] );
+  out -> EndList();
+  out -> EndNode();
+} // CallExpression::Serialize()
+
+CallExpression *CallExpression::Load( AstReader *in ) {
+  Expression *name = in -> ReadNodeAs< Expression >( "callee" );
+  vector< Expression * > args;
+  size_t count = in -> BeginList( "args" );
+  for ( size_t i = 0; i < count && ! in -> Bad(); ++i )
+    args.push_back( in -> ReadNodeAs< Expression >( NULL ) );
+  in -> EndList();
+  return new CallExpression( name, args );
+} // CallExpression::Load()
+
+void DeclarationStatement::Serialize( AstWriter *out ) {
+  out -> BeginNode( DECLARATION_NODE, GetSpan() );
+  out -> WriteToken( "type", mTok );
+  out -> BeginList( "ids", mIds.size() );
+  for ( size_t i = 0; i < mIds.size(); ++i )
+    out -> WriteNode( NULL, mIds[ i ] );
+  out -> EndList();
+  out -> EndNode();
+} // DeclarationStatement::Serialize()
+
+DeclarationStatement *DeclarationStatement::Load( AstReader *in ) {
+  DeclarationStatement *stmt = new DeclarationStatement( in -> ReadToken( "type" ) );
+  size_t count = in -> BeginList( "ids" );
+  for ( size_t i = 0; i < count && ! in -> Bad(); ++i )
+    stmt -> AppendArr( in -> ReadNodeAs< Expression >( NULL ) );
+  in -> EndList();
+  return stmt;
+} // DeclarationStatement::Load()
+
+void UnaryExpression::Serialize( AstWriter *out ) {
+  out -> BeginNode( UNARY_NODE, GetSpan() );
+  out -> WriteToken( "op", mOp );
+  out -> WriteNode( "right", mRhs );
+  out -> EndNode();
+} // UnaryExpression::Serialize()
+
+UnaryExpression *UnaryExpression::Load( AstReader *in ) {
+  Token *op = in -> ReadToken( "op" );
+  Expression *rhs = in -> ReadNodeAs< Expression >( "right" );
+  return new UnaryExpression( op, rhs );
+} // UnaryExpression::Load()
+
+void ReturnStmt::Serialize( AstWriter *out ) {
+  out -> BeginNode( RETURN_NODE, GetSpan() );
+  out -> WriteToken( "token", mTok );
+  out -> WriteNode( "value", mReturnValue );
+  out -> EndNode();
+} // ReturnStmt::Serialize()
+
+ReturnStmt *ReturnStmt::Load( AstReader *in ) {
+  Token *tok = in -> ReadToken( "token" );
+  Expression *value = in -> ReadNodeAs< Expression >( "value", true );
+  return new ReturnStmt( tok, value );
+} // ReturnStmt::Load()
+
+void AssignmentExpr::Serialize( AstWriter *out ) {
+  out -> BeginNode( ASSIGNMENT_NODE, GetSpan() );
+  out -> WriteToken( "op", mToken );
+  out -> WriteNode( "name", mName );
+  out -> WriteNode( "value", mValue );
+  out -> EndNode();
+} // AssignmentExpr::Serialize()
+
+AssignmentExpr *AssignmentExpr::Load( AstReader *in ) {
+  Token *op = in -> ReadToken( "op" );
+  Expression *name = in -> ReadNodeAs< Expression >( "name" );
+  Expression *value = in -> ReadNodeAs< Expression >( "value" );
+  return new AssignmentExpr( op, name, value );
+} // AssignmentExpr::Load()
+
+void Program::Serialize( AstWriter *out ) {
+  out -> BeginNode( PROGRAM_NODE, GetSpan() );
+  out -> BeginList( "body", mBody.size() );
+  for ( size_t i = 0; i < mBody.size(); ++i )
+    out -> WriteNode( NULL, mBody[ i ] );
+  out -> EndList();
+  out -> EndNode();
+} // Program::Serialize()
+
+Program *Program::Load( AstReader *in ) {
+  Program *program = new Program();
+  size_t count = in -> BeginList( "body" );
+  for ( size_t i = 0; i < count && ! in -> Bad(); ++i )
+    program -> Append( in -> ReadNodeAs< Statement >( NULL ) );
+  in -> EndList();
+  return program;
+} // Program::Load()
+
+void ExpressionStatement::Serialize( AstWriter *out ) {
+  out -> BeginNode( EXPRESSION_STMT_NODE, GetSpan() );
+  out -> WriteNode( "expr", mExpr );
+  out -> WriteToken( "token", mToken );
+  out -> EndNode();
+} // ExpressionStatement::Serialize()
+
+ExpressionStatement *ExpressionStatement::Load( AstReader *in ) {
+  Expression *expr = in -> ReadNodeAs< Expression >( "expr" );
+  Token *tok = in -> ReadToken( "token", true );
+  return new ExpressionStatement( expr, tok );
+} // ExpressionStatement::Load()
+
+void NullStatement::Serialize( AstWriter *out ) {
+  out -> BeginNode( NULL_STMT_NODE, GetSpan() );
+  out -> EndNode();
+} // NullStatement::Serialize()
+
+NullStatement *NullStatement::Load( AstReader * /* in */ ) {
+  return new NullStatement();
+} // NullStatement::Load()
+
+// Rebuild the program held in a binary AST image, NULL if it is not a
+// valid image of this version
+Program *GLoadImage( const char *data, size_t size ) {
+  BinaryAstReader in( data, size );
+  if ( ! in.ReadHeader() )
+    return NULL;
+
+  Program *program = in.ReadNodeAs< Program >( "program" );
+  if ( in.Bad() || ! in.AtEnd() )
+    return NULL;
+
+  string err;
+  program -> Resolve( NULL, &err );
+  return program;
+} // GLoadImage()
+
+// Same for the JSON form written by --dump-ast=json
+Program *GLoadJson( const string &text ) {
+  JsonAstReader in( text );
+  Program *program = in.ReadNodeAs< Program >( "program" );
+  if ( in.Bad() )
+    return NULL;
+
+  string err;
+  program -> Resolve( NULL, &err );
+  return program;
+} // GLoadJson()
+
+// -------------------------- Resolver ------------------------
+// The parser builds the AST without looking at any environment, the
+// names are checked afterwards. Resolver walks nodes through Serialize
+// like EffectWriter : declarations, parameters and function names
+// declare their name, any other symbol must have been declared before
+// it or exist in the scope.
+
+// A name met by the parser in the statement it is parsing
+struct NameTok {
+  Token *tok;
+  bool declares;
+};
+
+bool GTokenBefore( Token *a, Token *b ) {
+  return a -> line < b -> line || ( a -> line == b -> line && a -> column < b -> column );
+} // GTokenBefore()
+
+class Resolver : public AstWriter {
+  struct Frame {
+    NodeKind kind;
+    const char *field; // Field of the parent holding the node
+    Node *node;
+  };
+
+  vector< Frame > mFrames;
+  const char *mField; // Field of the next node
+  Node *mNode; // Next node
+  Environment *mScope; // NULL : the names are not checked
+  set< string > mLocals; // Declared by the nodes walked so far
+  set< string > mAssigned; // Assigned so far, a call frame may hold them
+  string mError; // About the first undefined name
+
+  void Name( const string &name ) ;
+
+public:
+  Resolver( Environment *scope ) {
+    mField = NULL;
+    mNode = NULL;
+    mScope = scope;
+  } // Resolver()
+
+  // false if node uses a name that is not declared, see Error()
+  bool Resolve( Node *node ) {
+    WriteNode( NULL, node );
+    return mError.empty();
+  } // Resolve()
+
+  // For a statement that did not parse : false if a name used before
+  // its error token is not declared, the error it shows then comes
+  // second as in the order of the source
+  bool ResolveBefore( const vector< NameTok > &names, Token *error ) ;
+
+  string Error( ) {
+    return mError;
+  } // Error()
+
+  void BeginNode( NodeKind kind, const Span &span ) ;
+  void EndNode( ) ;
+  void WriteInt( const char * /* field */, long long /* v */ ) { } // WriteInt()
+  void WriteFloat( const char * /* field */, float /* v */ ) { } // WriteFloat()
+  void WriteString( const char *field, const string &str ) ;
+  void WriteToken( const char * /* field */, Token * /* tok */ ) { } // WriteToken()
+  void WriteNode( const char *field, Node *node ) ;
+  void BeginList( const char * /* field */, size_t /* count */ ) { } // BeginList()
+  void EndList( ) { } // EndList()
+};
+
+void Resolver::WriteNode( const char *field, Node *node ) {
+  if ( node == NULL || ! mError.empty() )
+    return;
+
+  // A skipped body is resolved when it is parsed
+  FunctionDeclaration *func = dynamic_cast< FunctionDeclaration * >( node );
+  if ( func != NULL && func -> Deferred() ) {
+    mLocals.insert( func -> Name() );
+    return;
+  } // if
+
+  mField = field;
+  mNode = node;
+  node -> Serialize( this );
+} // Resolver::WriteNode()
+
+void Resolver::BeginNode( NodeKind kind, const Span & /* span */ ) {
+  Frame frame;
+  frame.kind = kind;
+  frame.field = mField;
+  frame.node = mNode;
+  mFrames.push_back( frame );
+} // Resolver::BeginNode()
+
+void Resolver::EndNode( ) {
+  mFrames.pop_back();
+} // Resolver::EndNode()
+
+void Resolver::WriteString( const char *field, const string &str ) {
+  if ( strcmp( field, "name" ) != 0 )
+    return;
+
+  if ( mFrames.back().kind == ARRAY_NODE )
+    mLocals.insert( str );
+  else if ( mFrames.back().kind == SYMBOL_NODE )
+    Name( str );
+} // Resolver::WriteString()
+
+// A symbol, declared or used depending on where it is. The callee of
+// a call that no frame can hold is looked up past the frames.
+void Resolver::Name( const string &name ) {
+  const char *field = mFrames.back().field == NULL ? "" : mFrames.back().field;
+  Frame *parent = mFrames.size() > 1 ? &mFrames[ mFrames.size() - 2 ] : NULL;
+  NodeKind kind = parent != NULL ? parent -> kind : NO_NODE;
+  if ( ( kind == FUNCTION_DECL_NODE && strcmp( field, "name" ) == 0 ) ||
+       kind == PARAMETER_NODE || kind == DECLARATION_NODE ) {
+    mLocals.insert( name );
+    return;
+  } // if
+
+  if ( ( kind == ASSIGNMENT_NODE && strcmp( field, "name" ) == 0 ) ||
+       ( kind == UPDATE_NODE && strcmp( field, "id" ) == 0 ) || kind == CIN_NODE )
+    mAssigned.insert( name );
+  else if ( kind == CALL_NODE && strcmp( field, "callee" ) == 0 &&
+            mLocals.count( name ) == 0 && mAssigned.count( name ) == 0 )
+    ( ( CallExpression * ) parent -> node ) -> LookPastFrames();
+
+  if ( mError.empty() && mScope != NULL && mLocals.count( name ) == 0 && 
+       ! mScope -> VarExist( name ) )
+    mError = "Undefined identifier : '" + name + "'\n";
+} // Resolver::Name()
+
+bool Resolver::ResolveBefore( const vector< NameTok > &names, Token *error ) {
+  for ( size_t i = 0; i < names.size() && mError.empty(); ++i ) {
+    if ( ! GTokenBefore( names[ i ].tok, error ) )
+      break;
+
+    const string &name = names[ i ].tok -> value;
+    if ( names[ i ].declares )
+      mLocals.insert( name );
+    else if ( mScope != NULL && mLocals.count( name ) == 0 && ! mScope -> VarExist( name ) )
+      mError = "Undefined identifier : '" + name + "'\n";
+  } // for
+
+  return mError.empty();
+} // Resolver::ResolveBefore()
+
+// Check the names of stmt, then declare its names in scope. false with
+// the first undefined name in err. Without a scope only the call sites
+// are marked, see Resolver::Name().
+bool GResolveStatement( Statement *stmt, Environment *scope, string *err ) {
+  Resolver resolver( scope );
+  if ( ! resolver.Resolve( stmt ) ) {
+    *err = resolver.Error();
+    return false;
+  } // if
+
+  if ( scope != NULL )
+    stmt -> Declare( scope );
+  return true;
+} // GResolveStatement()
+
+// Resolve the statements in order, see GResolveStatement()
+bool Program::Resolve( Environment *scope, string *err ) {
+  for ( size_t i = 0; i < mBody.size(); ++i )
+    if ( ! GResolveStatement( mBody[ i ], scope, err ) )
+      return false;
+
+  return true;
+} // Program::Resolve()
+
+// -------------------------- Parser ------------------------
+
+typedef enum {
+  LOWEST,
+  SET,
+  EQUAL,
+  LESSGREATER,
+  SUM,
+  SHIFT,
+  PRODUCT,
+  ANDBP,
+  ORBP,
+  PREFIX,
+  CALL,
+} BindingPower
+;
+
+class Parser {
+  istream *mIn;
+  int mLine; // Lines read from mIn
+  Lexer *mLexer;
+  Token *mCurToken;
+  Token *mLast; // Last token popped
+  vector< string > mErrs;
+  Token *mErrTok; // Where the first of mErrs was found
+  vector< NameTok > mNames; // Of the statement being parsed, in order
+  vector< Token* > mToks;
+  bool mLazy; // Function bodies are skipped, see SkipBody()
+
+public:
+  Parser( ) {
+    mIn = &gStdin;
+    mLine = 0;
+    mLexer = NULL;
+    mCurToken = NULL;
+    mLast = NULL;
+    mErrTok = NULL;
+    mLazy = false;
+  } // Parser()
+
+  Parser( istream *in ) {
+    mIn = in;
+    mLine = 0;
+    mLexer = NULL;
+    mCurToken = NULL;
+    mLast = NULL;
+    mErrTok = NULL;
+    mLazy = false;
+  } // Parser()
+
+  // Parse the tokens of a skipped function body
+  Parser( const vector< Token * > *tokens ) {
+    mIn = NULL;
+    mLine = 0;
+    mLexer = new Lexer( tokens );
+    mCurToken = mLexer -> ReadNextToken();
+    mToks.push_back( mCurToken );
+    mLast = NULL;
+    mErrTok = NULL;
+    mLazy = false;
+  } // Parser()
+
+  ~Parser( ) {
+    delete mLexer;
+  } // ~Parser()
+
+  void Init( ) ;
+  void Reset( ) ;
+  bool Exhausted( ) ;
+  // Helper function
+  void NextToken( ) ;
+  Token* Pop( ) ;
+  bool Expect( Token* tok, TokenType tp ) ;
+  void Fail( Token *tok, const string &err ) ;
+  void Name( Token *tok, bool declares ) ;
+  void ResolveFailed( Resolver &resolver ) ;
+  bool CurrentTokenIs( TokenType type ) ;
+  bool SkipBody( vector< Token * > &body ) ;
+  BindingPower BPLookUp( Token* tok ) ;
+  vector< string > Errors( ) ;
+
+  // Parsing stmt
+  Statement *ParseExpressionStmt( ) ;
+  Statement *ParseStatement( ) ;
+  Statement *ParseLetStmt( );
+  Statement *ParseReturnStmt( );
+  Statement* ParseCompound( ); 
+  Statement *ParseAssignStmt( );
+  FunctionDeclaration *ParseFunction( FunctionDeclaration *fn ); 
+  Program *ParseProgram( ) ;
+  Program *ParseScript( Environment *scope ) ;
+
+  // Parse expression
+  BlockStatement *ParseBlockStatement( ) ;
+  Expression *ParseExpression( BindingPower bp, bool CinCout ) ;
+  vector <Expression *> ParseCallArgs( ); 
+  vector <Parameter *> ParseParameter( ); 
+
+  // Prefix parsers, see kPrefixFNs
+  Expression *ParseCoutExpr( bool CinCout );
+  Expression *ParseCinExpr( bool CinCout );
+  Expression *ParseBoolean( bool CinCout );
+  Expression *ParseGroup( bool CinCout ) ;
+  Expression *ParseNumber( bool CinCout ) ;
+  Expression *ParseString( bool CinCout ) ;
+  Expression *ParseChar( bool CinCout );
+  Expression *ParseIdentifier( bool CinCout ) ;
+  Expression *ParsePrefix( bool CinCout ) ;
+
+  // Infix parsers, see kInfixFNs
+  Expression *ParseInfix( Expression *left, bool CinCout ) ;
+  Expression *ParseAssignExpr( Expression* left, bool CinCout ) ;
+  Expression *ParseCallExpr( Expression* left, bool CinCout );
+};
+
+typedef Expression *( Parser::*PrefixFn )( bool CinCout );
+typedef Expression *( Parser::*InfixFn )( Expression *left, bool CinCout );
+
+// Parser tables indexed by TokenType, NULL when the token has no parser
+constexpr PrefixFn kPrefixFNs[] = {
+  NULL, // ILLEGAL
+  NULL, // EOFF
+  &Parser::ParseIdentifier, // IDENT
+  &Parser::ParseNumber, // FLOAT
+  &Parser::ParseNumber, // INT
+  NULL, // ASSIGN
+  &Parser::ParsePrefix, // PLUS
+  &Parser::ParseIdentifier, // PLUSPLUS
+  &Parser::ParseIdentifier, // MINUSMINUS
+  &Parser::ParsePrefix, // MINUS
+  NULL, // MULTIPLY
+  NULL, // DIVIDE
+  NULL, // COMMA
+  NULL, // SEMICOLON
+  &Parser::ParseGroup, // LPAREN
+  NULL, // RPAREN
+  NULL, // LBRACE
+  NULL, // RBRACE
+  NULL, // LBRACKET
+  NULL, // RBRACKET
+  NULL, // MODULO
+  NULL, // LT
+  NULL, // GT
+  NULL, // LTEQ
+  NULL, // GTEQ
+  NULL, // EQ
+  NULL, // NOT_EQ
+  NULL, // NOT
+  NULL, // LEFT_SHIFT
+  NULL, // RIGHT_SHIFT
+  NULL, // AND
+  NULL, // ANDAND
+  NULL, // PASSREF
+  NULL, // OR
+  NULL, // OROR
+  NULL, // PLUS_EQ
+  NULL, // MINUS_EQ
+  NULL, // MULTI_EQ
+  NULL, // DIVIDE_EQ
+  &Parser::ParseString, // STRING
+  &Parser::ParseChar, // CHAR
+  &Parser::ParseCoutExpr, // COUT
+  &Parser::ParseCinExpr, // CIN
+  &Parser::ParseBoolean, // KEY_TRUE
+  &Parser::ParseBoolean, // KEY_FALSE
+  NULL, // KEY_IF
+  NULL, // KEY_ELSE
+  NULL, // KEY_ELIF
+  NULL, // KEY_INT
+  NULL, // KEY_STRING
+  NULL, // KEY_FLOAT
+  NULL, // KEY_BOOL
+  NULL, // KEY_VOID
+  NULL, // KEY_RETURN
+  NULL, // KEY_DO
+  NULL, // KEY_WHILE
+  NULL // KEY_CHAR
+};
+
+static_assert( sizeof( kPrefixFNs ) / sizeof( kPrefixFNs[ 0 ] ) == TOKEN_TYPE_COUNT,
+               "kPrefixFNs needs one entry per TokenType" );
+
+constexpr InfixFn kInfixFNs[] = {
+  NULL, // ILLEGAL
+  NULL, // EOFF
+  NULL, // IDENT
+  NULL, // FLOAT
+  NULL, // INT
+  &Parser::ParseAssignExpr, // ASSIGN
+  &Parser::ParseInfix, // PLUS
+  NULL, // PLUSPLUS
+  NULL, // MINUSMINUS
+  &Parser::ParseInfix, // MINUS
+  &Parser::ParseInfix, // MULTIPLY
+  &Parser::ParseInfix, // DIVIDE
+  NULL, // COMMA
+  NULL, // SEMICOLON
+  &Parser::ParseCallExpr, // LPAREN
+  NULL, // RPAREN
+  NULL, // LBRACE
+  NULL, // RBRACE
+  NULL, // LBRACKET
+  NULL, // RBRACKET
+  &Parser::ParseInfix, // MODULO
+  &Parser::ParseInfix, // LT
+  &Parser::ParseInfix, // GT
+  &Parser::ParseInfix, // LTEQ
+  &Parser::ParseInfix, // GTEQ
+  &Parser::ParseInfix, // EQ
+  &Parser::ParseInfix, // NOT_EQ
+  NULL, // NOT
+  &Parser::ParseInfix, // LEFT_SHIFT
+  &Parser::ParseInfix, // RIGHT_SHIFT
+  NULL, // AND
+  NULL, // ANDAND
+  NULL, // PASSREF
+  NULL, // OR
+  NULL, // OROR
+  &Parser::ParseAssignExpr, // PLUS_EQ
+  &Parser::ParseAssignExpr, // MINUS_EQ
+  &Parser::ParseAssignExpr, // MULTI_EQ
+  &Parser::ParseAssignExpr, // DIVIDE_EQ
+  NULL, // STRING
+  NULL, // CHAR
+  NULL, // COUT
+  NULL, // CIN
+  NULL, // KEY_TRUE
+  NULL, // KEY_FALSE
+  NULL, // KEY_IF
+  NULL, // KEY_ELSE
+  NULL, // KEY_ELIF
+  NULL, // KEY_INT
+  NULL, // KEY_STRING
+  NULL, // KEY_FLOAT
+  NULL, // KEY_BOOL
+  NULL, // KEY_VOID
+  NULL, // KEY_RETURN
+  NULL, // KEY_DO
+  NULL, // KEY_WHILE
+  NULL // KEY_CHAR
+};
+
+static_assert( sizeof( kInfixFNs ) / sizeof( kInfixFNs[ 0 ] ) == TOKEN_TYPE_COUNT,
+               "kInfixFNs needs one entry per TokenType" );
+
+// Binding power of the infix operators, LOWEST for everything else
+constexpr BindingPower kPrecedences[] = {
+  LOWEST, // ILLEGAL
+  LOWEST, // EOFF
+  LOWEST, // IDENT
+  LOWEST, // FLOAT
+  LOWEST, // INT
+  SET, // ASSIGN
+  SUM, // PLUS
+  LOWEST, // PLUSPLUS
+  LOWEST, // MINUSMINUS
+  SUM, // MINUS
+  PRODUCT, // MULTIPLY
+  PRODUCT, // DIVIDE
+  LOWEST, // COMMA
+  LOWEST, // SEMICOLON
+  CALL, // LPAREN
+  LOWEST, // RPAREN
+  LOWEST, // LBRACE
+  LOWEST, // RBRACE
+  LOWEST, // LBRACKET
+  LOWEST, // RBRACKET
+  SHIFT, // MODULO
+  LESSGREATER, // LT
+  LESSGREATER, // GT
+  LESSGREATER, // LTEQ
+  LESSGREATER, // GTEQ
+  EQUAL, // EQ
+  EQUAL, // NOT_EQ
+  LOWEST, // NOT
+  SHIFT, // LEFT_SHIFT
+  SHIFT, // RIGHT_SHIFT
+  LOWEST, // AND
+  LOWEST, // ANDAND
+  LOWEST, // PASSREF
+  LOWEST, // OR
+  LOWEST, // OROR
+  SET, // PLUS_EQ
+  SET, // MINUS_EQ
+  SET, // MULTI_EQ
+  SET, // DIVIDE_EQ
+  LOWEST, // STRING
+  LOWEST, // CHAR
+  LOWEST, // COUT
+  LOWEST, // CIN
+  LOWEST, // KEY_TRUE
+  LOWEST, // KEY_FALSE
+  LOWEST, // KEY_IF
+  LOWEST, // KEY_ELSE
+  LOWEST, // KEY_ELIF
+  LOWEST, // KEY_INT
+  LOWEST, // KEY_STRING
+  LOWEST, // KEY_FLOAT
+  LOWEST, // KEY_BOOL
+  LOWEST, // KEY_VOID
+  LOWEST, // KEY_RETURN
+  LOWEST, // KEY_DO
+  LOWEST, // KEY_WHILE
+  LOWEST // KEY_CHAR
+};
+
+static_assert( sizeof( kPrecedences ) / sizeof( kPrecedences[ 0 ] ) == TOKEN_TYPE_COUNT,
+               "kPrecedences needs one entry per TokenType" );
+
+Token *Parser::Pop( ) {
+
+  Token *top = NULL;
+  if ( mToks.size() > 0 ) {
+    top = mToks[0];
+    mToks.erase( mToks.begin() );
+    mLast = top;
+  } // if
+
+  else *gOut << "Tokens list is empty \n";
+
+  return top;
+} // Parser::Pop() 
+
+bool Parser::Expect( Token* tok, TokenType tp ) {
+  if ( tok -> type == tp ) 
+    return true;
+  else {
+    Fail( tok, "Unexpected token : '" + tok -> value + "'\n" );
+    return false; 
+  } // else
+
+} // Parser::Expect()
+
+void Parser::Fail( Token *tok, const string &err ) {
+  if ( mErrs.empty() )
+    mErrTok = tok;
+  mErrs.push_back( err );
+} // Parser::Fail()
+
+// Names are checked once a statement is parsed, see ResolveFailed()
+void Parser::Name( Token *tok, bool declares ) {
+  NameTok name;
+  name.tok = tok;
+  name.declares = declares;
+  mNames.push_back( name );
+} // Parser::Name()
+
+// A statement that did not parse shows an undefined name used before
+// its error first, as the parser did when it checked the names itself
+void Parser::ResolveFailed( Resolver &resolver ) {
+  if ( mErrTok == NULL )
+    return;
+
+  if ( ! resolver.ResolveBefore( mNames, mErrTok ) )
+    mErrs.insert( mErrs.begin(), resolver.Error() );
+} // Parser::ResolveFailed()
+
+void Parser::NextToken( ) {
+  if ( mCurToken -> type != SEMICOLON ) {
+    mCurToken = mLexer -> ReadNextToken( );
+    if ( mCurToken -> type == EOFF ) 
+      Init();
+    else
+      mToks.push_back( mCurToken ); 
+  } // if
+} // Parser::NextToken()
+
+void Parser::Reset( ) { 
+  mCurToken->value = '\0'; 
+  mCurToken->type = EOFF;
+  mToks.clear();
+  mErrs.clear();
+  mErrTok = NULL;
+} // Parser::Reset()
+
+// Read lines until one has a token, at the end of the input the EOFF
+// token is left as the current token
+void Parser::Init( ) {
+  if ( mIn == NULL ) { // Replaying a body, the lexer stays at its end
+    mCurToken = mLexer -> ReadNextToken( ) ;
+    mToks.push_back( mCurToken );
+    return;
+  } // if
+
+  string str = GetLine( *mIn ); 
+  delete mLexer;
+  mLexer = new Lexer( str, ++mLine ) ;
+  mCurToken = mLexer->ReadNextToken( ) ;
+  while ( mCurToken -> type == EOFF && ! mIn -> eof( ) ) {
+    str = GetLine( *mIn ); 
+    delete mLexer;
+    mLexer = new Lexer( str, ++mLine ) ;
+    mCurToken = mLexer->ReadNextToken( ) ;
+  } // while
+
+  mToks.push_back( mCurToken );
+} // Parser::Init()
+
+bool Parser::Exhausted( ) {
+  return mCurToken -> type == EOFF && ( mIn == NULL || mIn -> eof( ) );
+} // Parser::Exhausted()
+
+vector<Expression *> Parser::ParseCallArgs( ) {
+  vector< Expression *> args;
+  if ( CurrentTokenIs( RPAREN ) ) 
+    return args;
+
+  Expression *expr = ParseExpression( LOWEST, false );
+  args.push_back( expr );
+  
+  while ( CurrentTokenIs( COMMA ) ) {
+    Pop();
+    NextToken();
+    expr = ParseExpression( LOWEST, false );
+    args.push_back( expr );
+  } // while
+
+  return args; 
+} // Parser::ParseCallArgs()
+
+Expression *Parser::ParseCallExpr( Expression *left, bool /* CinCout */ ) {
+  Token* lparen = Pop();
+  Expression *expr = NULL; 
+  NextToken();
+  vector < Expression* > args = ParseCallArgs( );
+
+  if ( !Expect( mToks[0], RPAREN ) )
+    return NULL;
+
+  Pop(); // Skip )
+  NextToken();
+  expr = new CallExpression( left, args ); 
+
+  return expr;
+} // Parser::ParseCallExpr()
+
+BindingPower Parser::BPLookUp( Token* tok ) {
+  return kPrecedences[ tok->type ];
+} // Parser::BPLookUp()
+
+
+bool Parser::CurrentTokenIs( TokenType tp ) {
+  Token* current = mToks[0];
+  if ( tp == current -> type )
+    return true;
+  return false;
+} // Parser::CurrentTokenIs()
+
+Expression *Parser::ParseBoolean( bool /* CinCout */ ) {
+  Token* current = mToks[0];
+  Expression *expr = new BooleanExpression( current, current -> value );
+  Pop();
+  NextToken();
+  return expr;
+} // Parser::ParseBoolean()
+
+Expression* Parser::ParseGroup( bool /* CinCout */ ) {
+  Pop();
+  NextToken();
+  Expression *expr = ParseExpression( LOWEST, false );
+  if ( !CurrentTokenIs( RPAREN ) ) {
+    Fail( mToks[0], "Unexpected token : '" + mToks[0] -> value + "'\n" );
+    return NULL; 
+  } // if
+
+  if ( expr == NULL )
+    return NULL;
+
+  Pop(); // Skip )
+  NextToken();
+  return expr;
+} // Parser::ParseGroup()
+
+
+Expression *Parser::ParseChar( bool /* CinCout */ ) {
+  string str = mToks[0] -> value;
+  char ch = str[0];
+  CharExpr *expr = new CharExpr( ch );
+  Pop();
+  NextToken();
+  return expr;
+} // Parser::ParseChar()
+
+
+Expression *Parser::ParseString( bool /* CinCout */ ) {
+  string str = mToks[0] -> value;
+  StringExpr *expr = new StringExpr( str );
+  Pop();
+  NextToken();
+  return expr;
+} // Parser::ParseString()
+
+// The lexer already computed the value of the literal
+Expression *Parser::ParseNumber( bool /* CinCout */ ) {
+  Expression *expr = NULL;
+  if ( mToks[0]->type == INT )
+    expr = new IntExpr( mToks[0], mToks[0]->integer ) ;
+  else
+    expr = new FloatExpr( mToks[0], mToks[0]->real ) ;
+
+  Pop();
+  NextToken();
+  return expr;
+
+} // Parser::ParseNumber()
+
+
+Expression *Parser::ParsePrefix( bool CinCout ) {
+  Token *op = Pop();
+  NextToken( ) ;
+
+  if ( mToks[0] -> type == ILLEGAL ) {
+    Fail( mToks[0], "Unrecognized token with first char : '" + mToks[0] -> value + "'\n" );
+    return NULL; 
+  } // if
+
+  Expression *right = ParseExpression( PREFIX, CinCout ) ;
+  if ( right == NULL  )
+    return NULL;
+
+
+  UnaryExpression *prefix = new UnaryExpression( op, right ) ;
+  return prefix;
+} // Parser::ParsePrefix()
+
+Expression *Parser::ParseInfix( Expression *left, bool CinCout ) {
+  BinExpr* infix = NULL;
+  Token *op = Pop(); 
+  BindingPower bp = BPLookUp( op );
+  NextToken();
+  Expression* right = ParseExpression( bp, CinCout );
+  if ( right != NULL ) 
+    infix = new BinExpr( left, op, right ); 
+
+  return infix;
+} // Parser::ParseInfix()
+
+Expression *Parser::ParseIdentifier( bool /* CinCout */ ) {
+  if ( CurrentTokenIs( PLUSPLUS ) || CurrentTokenIs( MINUSMINUS ) ) {
+    Token* op = Pop();
+    NextToken();
+
+    if ( !Expect( mToks[0], IDENT ) ) 
+      return NULL;
+
+
+    Name( mToks[0], false );
+    SymbolExpression *id = new SymbolExpression( mToks[0], mToks[0] -> value );
+    id -> SetSpan( mToks[0], mToks[0] );
+    UpdateExpression *upexpr = new UpdateExpression( op, id, true );
+    Pop();
+    NextToken();
+
+    return upexpr;
+  } // if
+
+  else {
+    Name( mToks[0], false );
+    SymbolExpression* id = new SymbolExpression( mToks[0], mToks[0] -> value ); 
+    id -> SetSpan( mToks[0], mToks[0] );
+    Pop();
+    NextToken();
+    
+    if ( mToks[0] -> type ==  PLUSPLUS || mToks[0] -> type == MINUSMINUS ) {
+      Token *op = Pop();
+      NextToken();
+      UpdateExpression *upexpr = new UpdateExpression( op, id, false ); 
+      return upexpr;
+    } // if
+    
+    else 
+      return id;
+  } // else if
+
+} // Parser::ParseIdentifier()
+
+vector <Parameter*> Parser::ParseParameter() {
+  vector <Parameter*> params;
+  bool pbr = false;
+  // Skip ( 
+  Pop();
+  NextToken();
+
+  if ( CurrentTokenIs( RPAREN ) )
+    return params;
+    
+  // Data type
+  Token *kind = Pop();
+  NextToken();
+  if ( CurrentTokenIs( PASSREF ) ) {
+    pbr = true;
+    Pop();
+    NextToken();
+  } // if
+  
+  // ID 
+  Token *id = Pop();
+  Name( id, true );
+  SymbolExpression *ident = new SymbolExpression( id, id -> value );
+  ident -> SetSpan( id, id );
+  Parameter *param = new Parameter( kind, ident, pbr ); 
+  param -> SetSpan( kind, id );
+  params.push_back( param );
+
+  NextToken();
+  while ( CurrentTokenIs( COMMA ) ) {
+    pbr = false;
+    // Skip comma
+    Pop();
+    NextToken();
+    // Data type
+    kind = Pop();
+    NextToken();
+
+    if ( CurrentTokenIs( PASSREF ) ) 
+      pbr = true;
+
+    // ID
+    id = Pop();
+    Name( id, true );
+    ident = new SymbolExpression( id, id -> value );
+    ident -> SetSpan( id, id );
+    param = new Parameter( kind, ident, pbr );
+    param -> SetSpan( kind, id );
+    params.push_back( param );
+
+    NextToken();
+  } // while
+
+  return params;
+} // Parser::ParseParameter()
+
+
+Expression *Parser::ParseExpression( BindingPower bp, bool CoutCin ) {
+  // At first enter
+  if ( mToks[0] -> type == ILLEGAL ) {
+    Fail( mToks[0], "Unrecognized token with first char : '" + mToks[0] -> value + "'\n" );
+    return NULL; 
+  } // if
+
+  PrefixFn prefix = kPrefixFNs[ mToks[0] -> type ];
+  if ( prefix == NULL ) {
+    Fail( mToks[0], "Unexpected token : '" + mToks[0] -> value + "'\n" );
+    return NULL;
+  } // if
+
+  Token *first = mToks[0];
+  Expression *left = ( this ->* prefix )( CoutCin );
+  if ( left == NULL )
+    return NULL;
+
+  left -> SetSpan( first, mLast );
+
+  if ( mToks[0] -> type == ILLEGAL ) {
+    Fail( mToks[0], "Unrecognized token with first char : '" + mToks[0] -> value + "'\n" );
+    return NULL;
+  } // if 
+
+  if ( mToks[0] -> type == LEFT_SHIFT && CoutCin ) 
+    return left;
+
+  while ( mToks[0] -> type != SEMICOLON && bp < BPLookUp( mToks[0] ) ) {
+    InfixFn infix = kInfixFNs[ mToks[0] -> type ];
+    if ( infix == NULL ) {
+      Fail( mToks[0], "Unexpected token : '" + mToks[0] -> value + "'\n" );
+      return NULL;
+    } // if
+      
+    left = ( this ->* infix )( left, CoutCin );
+    if ( left == NULL )
+      return NULL;
+
+    left -> SetSpan( first, mLast );
+
+    if ( mToks[0] -> type == ILLEGAL ) {
+      Fail( mToks[0], "Unrecognized token with first char : '" + mToks[0] -> value + "'\n" );
+      return NULL;
+    } // if
+
+    if ( mToks[0] -> type == LEFT_SHIFT && CoutCin ) 
+      return left;
+  } // while
+
+  return left;
+} // Parser::ParseExpression() 
+
+BlockStatement* Parser::ParseBlockStatement( ) {
+  if ( !Expect( mToks[0], LBRACE ) ) 
+    return NULL;
+  Token* brace = Pop();
+  BlockStatement* bstmt = new BlockStatement( brace );
+  NextToken();
+
+  if ( CurrentTokenIs( RBRACE ) ) {
+    bstmt -> SetSpan( brace, mToks[0] );
+    return bstmt;
+  } // if
+
+  while ( !CurrentTokenIs( RBRACE ) ) {
+    Statement *stmt = ParseCompound( );
+
+    if ( stmt == NULL )
+      return NULL;
+
+    bstmt -> Append( stmt );
+    mCurToken  = mLexer -> ReadNextToken();
+    if ( mCurToken -> type != EOFF )
+      mToks.push_back( mCurToken );
+    else 
+      Init();
+  } // while
+
+  bstmt -> SetSpan( brace, mToks[0] ); // The } is left to the caller
+  return bstmt;
+} // Parser::ParseBlockStatment();
+
+Statement* Parser::ParseExpressionStmt( ) {
+  ExpressionStatement *exprStmt = NULL;
+  Token *start = mToks[0]; 
+  Expression *expr = ParseExpression( LOWEST, false ); 
+  if ( expr == NULL  )
+    return NULL;
+
+  exprStmt = new ExpressionStatement( expr, start );
+
+  Token* end = Pop(); 
+  if ( !Expect( end, SEMICOLON ))
+    return NULL;
+
+  return exprStmt;
+} // Parser::ParseExpressionStmt()
+
+Expression *Parser::ParseAssignExpr( Expression* left, bool /* CinCout */ ) {
+  Token *op = Pop();
+  NextToken();
+  Expression *rhs = ParseExpression( LOWEST, false );
+  if ( rhs == NULL )
+    return NULL;
+
+  Expression *expr = new AssignmentExpr( op, left, rhs );
+  return expr;
+} // Parser::ParseAssignStmt()
+
+Statement *Parser::ParseReturnStmt( ) {
+  Statement *stmt = NULL;
+  Token* ret = Pop(); 
+  NextToken();
+  Expression *rhs = ParseExpression( LOWEST, false );
+  stmt = new ReturnStmt( ret, rhs ); 
+  Token* end = Pop();
+  if ( !Expect( end, SEMICOLON ) )
+    return NULL;
+
+  return stmt;
+} // Parser::ParseReturnStmt() 
+
+FunctionDeclaration *Parser::ParseFunction( FunctionDeclaration *func ) {
+  FunctionDeclaration *funcRes = func; 
+  vector < Parameter *> prms = ParseParameter();
+
+  if ( !Expect( mToks[0], RPAREN ) )
+    return NULL;
+
+  for ( size_t i = 0; i < prms.size(); ++i ) 
+    funcRes -> Append( prms[i] );
+
+  // Skip )
+  Pop();
+  NextToken();
+
+  BlockStatement* bstmt = NULL;
+  vector< Token * > body;
+  if ( mLazy ) {
+    if ( !SkipBody( body ) )
+      return NULL;
+  } // if
+
+  else {
+    bstmt = ParseBlockStatement( );
+    if ( bstmt == NULL )
+      return NULL;
+  } // else
+
+  Token *end = Pop();
+  if ( !Expect( end, RBRACE ) ) 
+    return NULL;
+
+  if ( mLazy )
+    funcRes -> Defer( body );
+  else
+    funcRes -> SetBlock( bstmt );
+  return funcRes;
+} // Parser::ParseFunction 
+
+// Take the tokens of a function body from its { up to the matching },
+// which is left as the current token. Brackets that do not pair up and
+// tokens the lexer did not recognize fail here, with the script. The
+// body is parsed by FunctionDeclaration::Body() when it is first called.
+bool Parser::SkipBody( vector< Token * > &body ) {
+  if ( !Expect( mToks[0], LBRACE ) ) 
+    return false;
+
+  vector< TokenType > closers; // Of the open brackets, innermost last
+  while ( true ) {
+    Token *tok = mToks[0];
+    if ( tok -> type == EOFF ) 
+      return Expect( tok, closers.back() );
+
+    if ( tok -> type == ILLEGAL ) {
+      Fail( tok, "Unrecognized token with first char : '" + tok -> value + "'\n" );
+      return false;
+    } // if
+
+    if ( tok -> type == RBRACE || tok -> type == RPAREN || tok -> type == RBRACKET ) {
+      if ( !Expect( tok, closers.back() ) )
+        return false;
+      closers.pop_back();
+    } // if
+
+    body.push_back( tok );
+    if ( tok -> type == LBRACE ) 
+      closers.push_back( RBRACE );
+    else if ( tok -> type == LPAREN )
+      closers.push_back( RPAREN );
+    else if ( tok -> type == LBRACKET )
+      closers.push_back( RBRACKET );
+    else if ( closers.empty() )
+      return true;
+
+    Pop();
+    if ( mToks.empty() ) {
+      mCurToken = mLexer -> ReadNextToken();
+      if ( mCurToken -> type != EOFF )
+        mToks.push_back( mCurToken );
+      else 
+        Init();
+    } // if
+  } // while
+} // Parser::SkipBody()
+
+// Parse the skipped body once. Its names are resolved in the closure and
+// the parameters the first time there is one. Without one ( when the AST
+// is written out or analysed ) the body is only parsed and is resolved by
+// the next call that has a closure.
+BlockStatement *FunctionDeclaration::Body( Environment *closure ) {
+  static mutex sLock; // Bodies of a program may be parsed from any thread
+
+  if ( mParsed.load( memory_order_acquire ) ) {
+    if ( mBlockStmt == NULL && closure != NULL ) {
+      *gOut << mBodyErr;
+      gBodyFailed = true;
+    } // if
+
+    return mBlockStmt;
+  } // if
+
+  lock_guard< mutex > hold( sLock );
+  if ( ! mParsed.load( memory_order_relaxed ) ) {
+    Resolver resolver( closure );
+    for ( size_t i = 0; i < mParams.size(); ++i )
+      resolver.Resolve( mParams[i] );
+
+    if ( mBlockStmt == NULL ) {
+      AstPool *saved = gAstPool;
+      size_t before = mPool != NULL ? mPool -> Bytes() : 0;
+      gAstPool = mPool;
+      Parser parser( &mBodyToks );
+      mBlockStmt = parser.ParseBlockStatement( );
+      if ( ! parser.Errors().empty() )
+        mBlockStmt = NULL; // Some statements fail without failing the block
+      gAstPool = saved;
+      if ( mPool != NULL && mPool -> Owner() != NULL )
+        mPool -> Owner() -> Grew( mPool, mPool -> Bytes() - before );
+      if ( mBlockStmt == NULL ) {
+        parser.ResolveFailed( resolver );
+        vector< string > errs = parser.Errors();
+        mBodyErr = errs.empty() ? "Invalid body of '" + mId -> Value() + "'\n" : errs[0];
+      } // if
+    } // if
+
+    if ( mBlockStmt != NULL && closure != NULL && ! resolver.Resolve( mBlockStmt ) ) {
+      mBodyErr = resolver.Error();
+      mBlockStmt = NULL;
+    } // if
+
+    if ( closure != NULL ) {
+      mBodyToks.clear();
+      mParsed.store( true, memory_order_release );
+    } // if
+  } // if
+
+  if ( mBlockStmt == NULL && closure != NULL ) {
+    *gOut << mBodyErr;
+    gBodyFailed = true;
+  } // if
+
+  return mBlockStmt;
+} // FunctionDeclaration::Body()
+
+// --check-bodies : parse and resolve in env the bodies of the functions
+// program declares that no call needed, their errors are printed as a
+// call would print them
+void GCheckBodies( Program *program, Environment *env ) {
+  for ( size_t i = 0; i < program -> mBody.size(); ++i ) {
+    FunctionDeclaration *decl = dynamic_cast< FunctionDeclaration * >( program -> mBody[ i ] );
+    if ( decl != NULL && decl -> Deferred() )
+      decl -> Body( env );
+  } // for
+} // GCheckBodies()
+
+Statement *Parser::ParseAssignStmt( ) {
+  DeclarationStatement *stmt = NULL;
+  Token *type = Pop();
+  stmt = new DeclarationStatement( type );
+
+  NextToken();
+  if ( !Expect( mToks[0], IDENT ) ) 
+    return stmt;
+  Token *id = Pop();
+  Name( id, true );
+  stmt -> Append( id ); 
+
+  NextToken();
+  while ( !CurrentTokenIs( SEMICOLON ) ) {
+    if ( !Expect( mToks[0], COMMA ) )
+      return NULL;
+    Pop();
+    NextToken(); 
+
+    if ( !Expect( mToks[0], IDENT ) )
+      return NULL;
+    id = Pop();
+    Name( id, true );
+    stmt -> Append( id ); 
+    NextToken();
+  } // while
+
+  Token* end = Pop();
+  if ( !Expect( end, SEMICOLON ) ) 
+    return NULL;
+
+  return stmt;
+} // Parser::ParseAssignStmt()
+
+Expression* Parser::ParseCoutExpr( bool /* CinCout */ ) { 
+  CoutExpr* ccout = new CoutExpr(); 
+  Pop(); // skip cout 
+  NextToken(); 
+  Token *shift =  Pop();
+  if ( !Expect( shift, LEFT_SHIFT ) )
+    return NULL; 
+
+  NextToken();
+  Expression *expr = ParseExpression( LOWEST, true );
+  if ( expr == NULL ) 
+    return NULL;
+
+  ccout -> Append( expr );
+  while ( CurrentTokenIs( LEFT_SHIFT ) ) {
+    Pop();
+    NextToken();
+    expr = ParseExpression( LOWEST, true );
+    if ( expr == NULL ) 
+      return NULL;
+
+    ccout -> Append( expr );
+  } // while
+
+  return ccout;
+} // Parser::ParseCoutExpr()
+
+Expression* Parser::ParseCinExpr( bool /* CinCout */ ) { 
+  CinExpr* ccin = new CinExpr(); 
+  Pop(); // skip cin 
+  NextToken(); 
+  do {
+    Token *shift = Pop();
+    if ( !Expect( shift, RIGHT_SHIFT ) )
+      return NULL; 
+
+    NextToken();
+    if ( !Expect( mToks[0], IDENT ) ) 
+      return NULL;
+
+    Name( mToks[0], false );
+    SymbolExpression *target = new SymbolExpression( mToks[0], mToks[0] -> value );
+    target -> SetSpan( mToks[0], mToks[0] );
+    ccin -> Append( target );
+    Pop();
+    NextToken();
+  } while ( CurrentTokenIs( RIGHT_SHIFT ) );
+
+  return ccin;
+} // Parser::ParseCinExpr()
+
+
+Statement *Parser::ParseLetStmt( ) {
+  DeclarationStatement *stmt = NULL;
+  Token *type = Pop();
+  stmt = new DeclarationStatement( type );
+
+  NextToken();
+  if ( !Expect( mToks[0], IDENT ) ) 
+    return stmt;
+  Token *id = Pop();
+  Name( id, true );
+  NextToken();
+
+  // [ is encounterd ;
+  if ( CurrentTokenIs( LBRACKET ) ) { 
+    Pop();
+    NextToken();
+    Expression *expr = ParseExpression( LOWEST, false );
+    Token *end = Pop();
+    if ( !Expect( end, RBRACKET ) )
+      return NULL;
+    DeclareArrayExpression *arr = new DeclareArrayExpression( id, id -> value, expr );
+    arr -> SetSpan( id, end );
+    stmt -> AppendArr( arr );
+  } // if
+  else 
+    stmt -> Append( id ); 
+  
+  NextToken();
+  if ( CurrentTokenIs( LPAREN ) ) {
+    SymbolExpression *ident = new SymbolExpression( id, id -> value );
+    ident -> SetSpan( id, id );
+    FunctionDeclaration *func = new FunctionDeclaration( type, ident );
+    func = ParseFunction(func);
+    return func;
+  } // if
+
+  while ( !CurrentTokenIs( SEMICOLON ) ) {
+    if ( !Expect( mToks[0], COMMA ) )
+      return NULL;
+    Pop();
+    NextToken(); 
+
+    if ( !Expect( mToks[0], IDENT ) )
+      return NULL;
+    id = Pop();
+    Name( id, true );
+    NextToken();
+
+    // [ is encounterd ;
+    if ( CurrentTokenIs( LBRACKET ) ) { 
+      Pop();
+      NextToken();
+      Expression *expr = ParseExpression( LOWEST, false );
+      Token *end = Pop();
+      if ( !Expect( end, RBRACKET ) )
+        return NULL;
+      DeclareArrayExpression *arr = new DeclareArrayExpression( id, id -> value, expr );
+      arr -> SetSpan( id, end );
+      stmt -> AppendArr( arr );
+    } // if
 
-void Program::Append( Statement *stmt ) { 
-  mBody.push_back( stmt ) ; 
-} // Program::Append()
+    else 
+      stmt -> Append( id );
 
-class ExpressionStatement : public Statement {
-  Token *mToken;
-  Expression *mExpr;
-  string mType;
+    NextToken();
+  } // while
 
-public:
-  ExpressionStatement( Expression *expr, Token *token ) {
-    mExpr = expr;
-    mToken = token;
-    mType = "Expression Statement";
-  } // ExpressionStatement()
+  Token* end = Pop();
+  if ( !Expect( end, SEMICOLON ) ) 
+    return NULL;
 
-  Expression *Expr( ) { 
-    return mExpr; 
-  } // Expr()
+  return stmt;
+} // Parser::ParseLetStmt()
 
-  string Type( ) { 
-    return mType; 
-  } // Type()
+Statement *Parser::ParseStatement( ) {
+  Statement* stmt = NULL;
+  Token *first = mToks[0];
+  mNames.clear();
 
-  string Value( ) { 
-    return ""; 
-  } // Value()
+  if ( mToks[0] -> type == KEY_STRING || mToks[0] -> type == KEY_VOID ||
+            mToks[0] -> type == KEY_INT || mToks[0] -> type == KEY_FLOAT || 
+            mToks[0] -> type == KEY_BOOL || mToks[0] -> type == KEY_CHAR )
+    stmt = ParseLetStmt( );
 
-  void Stmt( ) {
-  } // Stmt()
+  else if ( mToks[0] -> type == KEY_RETURN )
+    stmt = ParseReturnStmt( );
 
-  void Print( ) ;
+  else if ( mToks[0] -> type == LBRACE )
+    return ParseBlockStatement( ); // Its span ends at the }
   
-  Obj *Eval( Environment *env ) ;
-};
+  else
+    stmt = ParseExpressionStmt( );
 
-Obj *ExpressionStatement::Eval( Environment *env ) {
-  Obj *obj = mExpr->Eval( env ) ;
-  return obj;
-} // ExpressionStatement::Eval()
+  if ( stmt == NULL )
+    return NULL;
 
-void ExpressionStatement::Print( ) {
-  mExpr->Print( ) ;
-  cout << ";\n";
-} // ExpressionStatement::Print()
+  stmt -> SetSpan( first, mLast );
+  return stmt;
+} // Parser::ParseStatement()
 
-class NullStatement : public Statement {
-  string mType;
+Statement* Parser::ParseCompound( ) {
+  Statement* stmt = NULL;
+  Token *first = mToks[0];
+  if ( mToks[0] -> type == KEY_STRING ||  mToks[0] -> type == KEY_INT || 
+       mToks[0] -> type == KEY_FLOAT || mToks[0] -> type == KEY_BOOL || mToks[0] -> type == KEY_CHAR )
+    stmt = ParseAssignStmt( );
 
-public:
-  NullStatement( ) { 
-    mType = "Null Statement"; 
-  } // NullStatement()
+  else if ( mToks[0] -> type == KEY_RETURN )
+    stmt = ParseReturnStmt( );
 
-  string Value( ) { 
-    return ""; 
-  } // Value()
+  else
+    stmt = ParseExpressionStmt( );
 
-  void Stmt( ) {
-  } // Stmt()
+  if ( stmt == NULL )
+    return NULL;
 
-  string Type( ) ;
-  void Print( ) ;
-  Obj *Eval( Environment *env ) ;
-};
+  stmt -> SetSpan( first, mLast );
+  return stmt;
+} // Parser::ParseCompound()
 
-Obj *NullStatement::Eval( Environment *env ) {
-  Obj *obj = new Null( ) ;
-  return obj;
-} // NullStatement::Eval()
+Program *Parser::ParseProgram( ) {
+  // Needed object
+  Program *program = new Program( ) ;
+  Obj *obj = NULL;
+  Environment *env = new Environment( ) ;
+  // Input string
+  string input = "";
+  input = GetLine( *mIn ) ; 
+  ++mLine;
 
-string NullStatement::Type( ) { return mType; } // NullStatement::Type()
+  *gOut << "Program starts..." << "\n";
+  *gOut << "> ";
 
-void NullStatement::Print( ) { cout << ";\n"; } // NullStatement::Print()
+  Init( ) ;
+  while ( mCurToken->value != "quit" && ! Exhausted( ) ) {
 
+    while ( mCurToken-> type != EOFF  && mCurToken -> value != "quit" ) {
+      Statement *stmt = ParseStatement( );
+      Resolver resolver( env );
+      if ( stmt != NULL && ! resolver.Resolve( stmt ) ) {
+        mErrs.push_back( resolver.Error() );
+        stmt = NULL;
+      } // if
 
-// -------------------------- Parser ------------------------
+      if ( stmt != NULL ) {
+        // stmt -> Print();
+        program -> Append( stmt );
+        obj = stmt -> Eval( env );
+        if ( obj == NULL )
+          Reset();
 
-typedef enum {
-  LOWEST,
-  SET,
-  EQUAL,
-  LESSGREATER,
-  SUM,
-  SHIFT,
-  PRODUCT,
-  ANDBP,
-  ORBP,
-  PREFIX,
-  CALL,
-} BindingPower
-;
+        mCurToken = mLexer -> ReadNextToken();
+        if ( mCurToken -> type != EOFF )
+          mToks.push_back( mCurToken ); 
+      } // if
 
-typedef enum {
-  ASSIGNMENT_PARSER,
-  IDENTIFER_PARSER,
-  NUMBER_PARSER,
-  PREFIX_PARSER,
-  INFIX_PARSER,
-  GROUP_PARSER,
-  IF_PARSER,
-  ILLEGAL_PARSER,
-  CALL_PARSER,
-  STRING_PARSER,
-  CHAR_PARSER, 
-  BOOL_PARSER, 
-  COUT_PARSER
-} Handler
-;
+      else {
+        ResolveFailed( resolver );
+        if ( mErrs.size() > 0 )
+          *gOut << mErrs[0];
+        Reset();
+      } // else 
 
-class Parser {
-  Lexer *mLexer;
-  Token *mCurToken;
-  vector< string > mErrs;
-  map< TokenType, Handler > mPrefixFNs;
-  map< TokenType, Handler > mInfixFNs;
-  map< TokenType, Handler > mPostFixFNs;
-  map< TokenType, BindingPower > mPrecedences;
-  vector< Token* > mToks;
+      *gOut << "> ";
+    } // while
+    
+    if ( mCurToken -> value != "quit" ) 
+      Init( );
+  } // while
 
-public:
-  Parser( ) {
-    Mapper( ) ;
-    mCurToken = NULL;
-  } // Parser()
+  *gOut << "Program exits..." << "\n"; 
+  return program;
+} // Parser::ParseProgram()
 
-  void Init( ) ;
-  void Reset( ) ;
-  // Helper function
-  void Mapper( ) ;
-  void NextToken( ) ;
-  Token* Pop( ) ;
-  bool Expect( Token* tok, TokenType tp ) ;
-  bool CurrentTokenIs( TokenType type ) ;
-  BindingPower BPLookUp( Token* tok ) ;
-  vector< string > Errors( ) ;
+// Parse a whole script without evaluating it, function bodies are parsed
+// when they are first called. Each statement is resolved in scope as soon
+// as it is parsed, see Program::Resolve(), so the first error reported is
+// the first one of the script. NULL on it.
+Program *Parser::ParseScript( Environment *scope ) {
+  Program *program = new Program( ) ;
+  mLazy = true;
+  Init( ) ;
+  Token *first = mToks[0];
+  while ( ! Exhausted( ) ) {
+    Statement *stmt = ParseStatement( );
+    if ( stmt == NULL ) {
+      Resolver resolver( scope );
+      ResolveFailed( resolver );
+      return NULL;
+    } // if
 
-  // Parsing stmt
-  Statement *ParseExpressionStmt( Environment *env ) ;
-  Statement *ParseStatement( Environment *env ) ;
-  Statement *ParseLetStmt( Environment *env );
-  Statement *ParseReturnStmt( Environment *env );
-  Statement* ParseCompound( Environment *env ); 
-  Statement *ParseAssignStmt( Environment *env );
-  FunctionDeclaration *ParseFunction( Environment *env, FunctionDeclaration *fn ); 
-  Program *ParseProgram( ) ;
+    string err;
+    if ( ! GResolveStatement( stmt, scope, &err ) ) {
+      mErrs.push_back( err );
+      return NULL;
+    } // if
 
-  // Parse expression
-  BlockStatement *ParseBlockStatement( Environment* env ) ;
-  Expression *ParseIf( ) ;
-  Expression *ParseCoutExpr( Environment *evn );
-  Expression *ParseBoolean( Environment *env );
-  Expression *ParseGroup( Environment *env ) ;
-  Expression *ParseNumber( Environment *env ) ;
-  Expression *ParseString( Environment *env ) ;
-  Expression *ParseChar( Environment *env );
-  Expression *ParseIdentifier( Environment *env ) ;
-  Expression *ParseExpression( BindingPower bp, Environment *env, bool CinCout ) ;
-  Expression *ParseInfix( Expression *left, Environment *env, bool CinCout ) ;
-  Expression *ParsePrefix( Environment *env, bool CinCout ) ;
-  Expression *ParseAssignExpr( Expression* left, Environment *env ) ;
-  Expression *ParseCallExpr( Expression* left, Environment *env );
-  vector <Expression *> ParseCallArgs( Environment *env ); 
-  vector <Parameter *> ParseParameter( ); 
+    program -> Append( stmt );
+    mCurToken = mLexer -> ReadNextToken();
+    if ( mCurToken -> type != EOFF )
+      mToks.push_back( mCurToken ); 
+    else
+      Init( );
+  } // while
 
-  // Map register
-  Expression *PrefixExecutor( Environment *env, bool CinCout ) ;
-  Expression *InfixExecutor( Expression *left, Environment *env, bool CinCout ) ;
-  void RegisterPrefix( TokenType tp, Handler fn ) ;
-  void RegisterInfix( TokenType tp, Handler fn ) ;
+  if ( ! program -> mBody.empty() )
+    program -> SetSpan( first, mLast );
+  return program;
+} // Parser::ParseScript()
+
+vector< string > Parser::Errors( ) {
+  return mErrs;
+} // Parser::Errors()
+
+// A script that does not parse shows its first error, as the REPL does
+void GReportParseError( Parser &parser, ostream &out ) {
+  vector< string > errs = parser.Errors();
+  if ( ! errs.empty() )
+    out << errs[ 0 ];
+} // GReportParseError()
+
+// ---------------------------- Program cache -------------------
+// Parsed scripts keyed by their source text and the globals they were
+// parsed with. Every script the process parses to run goes through the
+// one cache, GProgramCache(), from any thread. Entries are kept in LRU
+// order and evicted once their total cost exceeds the limit, the cost
+// of an entry is its source plus the AST its pool owns, strings and
+// vectors of the nodes included. Function bodies parsed later into the
+// pool are charged to the entry then.
+
+// A parsed program and the pool owning its AST. The cache and whoever
+// runs the program share it, so an evicted program lives until its last
+// run is done with it.
+struct CachedProgram {
+  AstPool pool;
+  Program *program;
+
+  CachedProgram( ) {
+    program = NULL;
+  } // CachedProgram()
 };
 
-Token *Parser::Pop( ) {
-
-  Token *top = NULL;
-  if ( mToks.size() > 0 ) {
-    top = mToks[0];
-    mToks.erase( mToks.begin() );
-  } // if
-
-  else cout << "Tokens list is empty \n";
-
-  return top;
-} // Parser::Pop() 
+typedef shared_ptr< CachedProgram > ProgramRef;
 
-bool Parser::Expect( Token* tok, TokenType tp ) {
-  if ( tok -> type == tp ) 
-    return true;
-  else {
-    string str = "Unexpected token : '" + tok -> value + "'\n";
-    mErrs.push_back( str );
-    return false; 
-  } // else
+class ProgramCache : public PoolOwner {
+  struct Entry {
+    string source;
+    vector< string > globals;
+    ProgramRef program;
+    size_t cost;
+  };
 
-} // Parser::Expect()
+  typedef list< Entry > EntryList;
 
-void Parser::NextToken( ) {
-  if ( mCurToken -> type != SEMICOLON ) {
-    mCurToken = mLexer -> ReadNextToken( );
-    if ( mCurToken -> type == EOFF ) 
-      Init();
-    else
-      mToks.push_back( mCurToken ); 
-  } // if
-} // Parser::NextToken()
+  EntryList mLru; // Most recently used first
+  map< unsigned long long, EntryList::iterator > mIndex;
+  size_t mLimit;
+  size_t mBytes;
+  mutex mLock; // Guards all of the above
 
-void Parser::Reset( ) { 
-  mCurToken->value = '\0'; 
-  mCurToken->type = EOFF;
-  mToks.clear();
-  mErrs.clear();
-} // Parser::Reset()
+  static unsigned long long Hash( const string &source, const vector< string > &globals ) ;
+  void Evict( ) ;
 
-void Parser::Init( ) {
-  string str = GetLine(); 
-  mLexer = new Lexer( str ) ;
-  mCurToken = mLexer->ReadNextToken( ) ;
-  while ( mCurToken -> type == EOFF ) {
-    str = GetLine(); 
-    mLexer = new Lexer( str ) ;
-    mCurToken = mLexer->ReadNextToken( ) ;
-  } // while
+public:
+  ProgramCache( size_t limit ) {
+    mLimit = limit;
+    mBytes = 0;
+  } // ProgramCache()
+
+  void SetLimit( size_t limit ) ;
+  ProgramRef Get( const string &source, const vector< string > &globals, 
+                  vector< string > *errors ) ;
+  void Grew( AstPool *pool, size_t bytes ) ;
+};
 
-  mToks.push_back( mCurToken );
-} // Parser::Init()
+// FNV-1a over the source and the names, each name ends with a 0
+unsigned long long ProgramCache::Hash( const string &source, const vector< string > &globals ) {
+  unsigned long long hash = 14695981039346656037ULL;
+  for ( size_t i = 0; i < source.size(); ++i ) {
+    hash ^= ( unsigned char ) source[ i ];
+    hash *= 1099511628211ULL;
+  } // for
 
-// Mapping the function with token type
-void Parser::Mapper( ) {
-
-  // Register the binding power of operation
-  mPrecedences [ EQ ] = EQUAL;
-  mPrecedences [ NOT_EQ ] = EQUAL;
-  mPrecedences [ LT ] = LESSGREATER;
-  mPrecedences [ GT ] = LESSGREATER;
-  mPrecedences [ GTEQ ] = LESSGREATER;
-  mPrecedences [ LTEQ ] = LESSGREATER;
-  mPrecedences [ PLUS ] = SUM;
-  mPrecedences [ MINUS ] = SUM;
-  mPrecedences [ MULTIPLY ] = PRODUCT;
-  mPrecedences [ DIVIDE ] = PRODUCT;
-  mPrecedences [ MODULO ] = SHIFT;
-  mPrecedences [ ASSIGN ] = SET; 
-  mPrecedences [ DIVIDE_EQ ] = SET;
-  mPrecedences [ MULTI_EQ ] = SET;
-  mPrecedences [ PLUS_EQ ] = SET;
-  mPrecedences [ MINUS_EQ ] = SET;
-  mPrecedences [ LPAREN ] = CALL;
-  mPrecedences [ RIGHT_SHIFT ] = SHIFT;
-  mPrecedences [ LEFT_SHIFT ] = SHIFT;
-
-  // Mapping token type with their associated parser
-  RegisterPrefix( IDENT, IDENTIFER_PARSER ) ;
-  RegisterPrefix( COUT, COUT_PARSER );
-  RegisterPrefix( KEY_TRUE, BOOL_PARSER );
-  RegisterPrefix( KEY_FALSE, BOOL_PARSER ); 
-  RegisterPrefix( FLOAT, NUMBER_PARSER ) ;
-  RegisterPrefix( INT, NUMBER_PARSER ) ;
-  RegisterPrefix( MINUS, PREFIX_PARSER ) ;
-  RegisterPrefix( PLUS, PREFIX_PARSER ) ;
-  RegisterPrefix( KEY_IF, IF_PARSER ) ;
-  RegisterPrefix( LPAREN, GROUP_PARSER ) ;
-  RegisterPrefix( ILLEGAL, ILLEGAL_PARSER );
-  RegisterPrefix( PLUSPLUS, IDENTIFER_PARSER );
-  RegisterPrefix( MINUSMINUS, IDENTIFER_PARSER );
-  RegisterPrefix( STRING, STRING_PARSER );
-  RegisterPrefix( CHAR, CHAR_PARSER );
-
-  RegisterInfix( MINUS_EQ, ASSIGNMENT_PARSER );
-  RegisterInfix( DIVIDE_EQ, ASSIGNMENT_PARSER );
-  RegisterInfix( MULTI_EQ, ASSIGNMENT_PARSER );
-  RegisterInfix( PLUS_EQ, ASSIGNMENT_PARSER );
-  RegisterInfix( ASSIGN, ASSIGNMENT_PARSER );
-
-  RegisterInfix( MODULO, INFIX_PARSER );
-  RegisterInfix( LEFT_SHIFT, INFIX_PARSER );
-  RegisterInfix( RIGHT_SHIFT, INFIX_PARSER );
-  RegisterInfix( PLUS, INFIX_PARSER ) ;
-  RegisterInfix( MINUS, INFIX_PARSER ) ;
-  RegisterInfix( MULTIPLY, INFIX_PARSER ) ;
-  RegisterInfix( DIVIDE, INFIX_PARSER ) ;
-  RegisterInfix( LT, INFIX_PARSER ) ;
-  RegisterInfix( LTEQ, INFIX_PARSER ) ;
-  RegisterInfix( GT, INFIX_PARSER ) ;
-  RegisterInfix( GTEQ, INFIX_PARSER ) ;
-  RegisterInfix( EQ, INFIX_PARSER ) ;
-  RegisterInfix( NOT_EQ, INFIX_PARSER ) ;
-  RegisterInfix( ILLEGAL, ILLEGAL_PARSER );
-  RegisterInfix( LPAREN, CALL_PARSER );
-
-} // Parser::Mapper()
-
-Expression *Parser::PrefixExecutor( Environment *env, bool CinCout ) {
+  for ( size_t g = 0; g < globals.size(); ++g ) {
+    for ( size_t i = 0; i <= globals[ g ].size(); ++i ) {
+      hash ^= ( unsigned char ) globals[ g ].c_str()[ i ];
+      hash *= 1099511628211ULL;
+    } // for
+  } // for
 
-  Expression *expr = NULL;
-  Handler fn = mPrefixFNs [ mToks[0] -> type ];
+  return hash;
+} // ProgramCache::Hash()
 
-  if ( fn == IDENTIFER_PARSER ) {
-    expr = ParseIdentifier( env ) ;
-    return expr; 
+void ProgramCache::Evict( ) {
+  // The newest entry stays even when it alone is over the limit
+  while ( mBytes > mLimit && mLru.size() > 1 ) {
+    Entry &victim = mLru.back();
+    mIndex.erase( Hash( victim.source, victim.globals ) );
+    mBytes -= victim.cost;
+    mLru.pop_back();
+  } // while
+} // ProgramCache::Evict()
+
+void ProgramCache::SetLimit( size_t limit ) {
+  lock_guard< mutex > guard( mLock );
+  mLimit = limit;
+  Evict();
+} // ProgramCache::SetLimit()
+
+// Return the parsed program of source, parsing it on a miss. NULL with
+// the parse errors in errors if the source does not parse. The names of
+// globals, sorted, may be used without a declaration. The parse runs
+// outside the lock, two threads missing the same script both parse it
+// and the first to finish is kept.
+ProgramRef ProgramCache::Get( const string &source, const vector< string > &globals, 
+                              vector< string > *errors ) {
+  unsigned long long hash = Hash( source, globals );
+  {
+    lock_guard< mutex > guard( mLock );
+    map< unsigned long long, EntryList::iterator >::iterator found = mIndex.find( hash );
+    if ( found != mIndex.end() && found -> second -> source == source && 
+         found -> second -> globals == globals ) {
+      mLru.splice( mLru.begin(), mLru, found -> second );
+      return found -> second -> program;
+    } // if
+  }
+
+  ProgramRef parsed = make_shared< CachedProgram >();
+  AstPool *saved = gAstPool;
+  gAstPool = &parsed -> pool;
+  istringstream in( source );
+  Parser parser( &in );
+  Environment scope;
+  for ( size_t i = 0; i < globals.size(); ++i )
+    scope.Reserve( globals[ i ] );
+  parsed -> program = parser.ParseScript( &scope );
+  gAstPool = saved;
+
+  if ( parsed -> program == NULL ) {
+    *errors = parser.Errors();
+    return ProgramRef();
   } // if
 
-  else if ( fn == NUMBER_PARSER ) 
-    expr = ParseNumber( env ) ;
+  lock_guard< mutex > guard( mLock );
+  map< unsigned long long, EntryList::iterator >::iterator found = mIndex.find( hash );
+  if ( found != mIndex.end() ) {
+    EntryList::iterator it = found -> second;
+    if ( it -> source == source && it -> globals == globals ) {
+      mLru.splice( mLru.begin(), mLru, it );
+      return it -> program;
+    } // if
 
-  else if ( fn == PREFIX_PARSER ) {
-    expr = ParsePrefix( env, CinCout ) ;
-    return expr;
-  } // else if 
+    // Collision, the older program makes room for this one
+    mBytes -= it -> cost;
+    mLru.erase( it );
+    mIndex.erase( found );
+  } // if
 
-  else if ( fn == GROUP_PARSER )
-    expr = ParseGroup( env ); 
-  
-  else if ( fn == COUT_PARSER ) {
-    expr = ParseCoutExpr( env );
-    return expr;
-  } // else if
+  Entry entry;
+  entry.source = source;
+  entry.globals = globals;
+  entry.program = parsed;
+  entry.cost = parsed -> pool.Bytes() + GHeapBytes( source ) + GHeapBytes( globals );
+  for ( size_t i = 0; i < globals.size(); ++i )
+    entry.cost += GHeapBytes( globals[ i ] );
+  parsed -> pool.SetOwner( this );
+  mBytes += entry.cost;
+  mLru.push_front( entry );
+  mIndex[ hash ] = mLru.begin();
+  Evict();
+  return parsed;
+} // ProgramCache::Get()
+
+// A body of the program of pool was parsed. The program is running, so
+// its entry becomes the newest and is not the one evicted. Nothing to
+// charge once the entry is gone.
+void ProgramCache::Grew( AstPool *pool, size_t bytes ) {
+  lock_guard< mutex > guard( mLock );
+  for ( EntryList::iterator it = mLru.begin(); it != mLru.end(); ++it ) {
+    if ( &it -> program -> pool == pool ) {
+      it -> cost += bytes;
+      mBytes += bytes;
+      mLru.splice( mLru.begin(), mLru, it );
+      Evict();
+      return;
+    } // if
+  } // for
+} // ProgramCache::Grew()
 
-  else if ( fn == BOOL_PARSER )
-    expr = ParseBoolean( env );
+const size_t kCacheLimit = 64 * 1024 * 1024; // Bytes, --cache-limit
 
-  else if ( fn == STRING_PARSER )
-    expr = ParseString( env );
+// Never destroyed, programs it handed out may outlive main
+ProgramCache &GProgramCache( ) {
+  static ProgramCache *cache = new ProgramCache( kCacheLimit );
+  return *cache;
+} // GProgramCache()
 
-  else if ( fn == CHAR_PARSER )
-    expr = ParseChar( env );
+// A read-only mapping of a whole file, so workers loading the same image
+// share its pages
+class MappedFile {
+  const char *mData;
+  size_t mSize;
+  bool mOk;
 
-  else if ( fn == ILLEGAL_PARSER )
-    return NULL;
+public:
+  MappedFile( const char *path ) ;
+  ~MappedFile( ) ;
 
-  if ( expr != NULL ) {
-    Pop();
-    NextToken();
-  } // if
+  bool Ok( ) {
+    return mOk;
+  } // Ok()
 
-  return expr;
-} // Parser::PrefixExecutor()
+  const char *Data( ) {
+    return mData;
+  } // Data()
 
-vector<Expression *> Parser::ParseCallArgs( Environment *env ) {
-  vector< Expression *> args;
-  if ( CurrentTokenIs( RPAREN ) ) 
-    return args;
+  size_t Size( ) {
+    return mSize;
+  } // Size()
+};
 
-  Expression *expr = ParseExpression( LOWEST, env, false );
-  args.push_back( expr );
-  
-  while ( CurrentTokenIs( COMMA ) ) {
-    Pop();
-    NextToken();
-    expr = ParseExpression( LOWEST, env, false );
-    args.push_back( expr );
-  } // while
+MappedFile::MappedFile( const char *path ) {
+  mData = NULL;
+  mSize = 0;
+  mOk = false;
+  int fd = open( path, O_RDONLY );
+  if ( fd < 0 )
+    return;
+
+  struct stat st;
+  if ( fstat( fd, &st ) == 0 ) {
+    mSize = st.st_size;
+    mOk = true;
+    if ( mSize > 0 ) {
+      void *map = mmap( NULL, mSize, PROT_READ, MAP_SHARED, fd, 0 );
+      if ( map == MAP_FAILED )
+        mOk = false;
+      else
+        mData = ( const char * ) map;
+    } // if
+  } // if
 
-  return args; 
-} // Parser::ParseCallArgs()
+  close( fd );
+} // MappedFile::MappedFile()
 
-Expression *Parser::ParseCallExpr( Expression *left, Environment *env ) {
-  Token* lparen = Pop();
-  Expression *expr = NULL; 
-  NextToken();
-  vector < Expression* > args = ParseCallArgs( env );
+MappedFile::~MappedFile( ) {
+  if ( mData != NULL )
+    munmap( ( void * ) mData, mSize );
+} // MappedFile::~MappedFile()
 
-  if ( !Expect( mToks[0], RPAREN ) )
+Program *GParseFile( const char *path ) {
+  MappedFile src( path );
+  if ( ! src.Ok() ) {
+    cerr << "Cannot open " << path << endl;
     return NULL;
+  } // if
 
-  Pop(); // Skip )
-  NextToken();
-  Obj* function = env -> Get( left -> Value() );
-  expr = new CallExpression( function, args ); 
-
-  return expr;
-} // Parser::ParseCallExpr()
-
-Expression *Parser::InfixExecutor( Expression *left, Environment *env, bool CinCout ) {
-  Expression *expr = NULL;
-  Handler fn = mInfixFNs [ mToks[0] -> type ];
-  if ( fn == INFIX_PARSER )
-    expr = ParseInfix( left, env, CinCout ) ;
-
-  else if ( fn == ASSIGNMENT_PARSER ) 
-    expr = ParseAssignExpr( left, env );
-
-  else if ( fn == ILLEGAL_PARSER )
+  istringstream text( string( src.Data(), src.Size() ) );
+  Parser parser( &text );
+  Environment scope;
+  Program *program = parser.ParseScript( &scope );
+  if ( program == NULL ) {
+    GReportParseError( parser, *gOut );
     return NULL;
+  } // if
 
-  else if ( fn == CALL_PARSER )
-    expr = ParseCallExpr( left, env );
+  // Images and dumps hold every body, one that does not parse fails here
+  GCheckBodies( program, &scope );
+  return gBodyFailed ? NULL : program;
+} // GParseFile()
+
+// Parse the script in and write its AST image to out
+int GCompile( const char *in, const char *out ) {
+  Program *program = GParseFile( in );
+  if ( program == NULL )
+    return 1;
+
+  BinaryAstWriter image;
+  image.WriteHeader();
+  image.WriteNode( "program", program );
+  ofstream file( out, ios::out | ios::binary | ios::trunc );
+  file.write( image.Bytes().data(), image.Bytes().size() );
+  if ( ! file ) {
+    cerr << "Cannot write " << out << endl;
+    return 1;
+  } // if
 
-  return expr;
-} // Parser::InfixExecutor()
+  return 0;
+} // GCompile()
+
+// Write the AST of the script at path as JSON to stdout
+int GDumpJson( const char *path ) {
+  Program *program = GParseFile( path );
+  if ( program == NULL )
+    return 1;
+
+  JsonAstWriter json;
+  json.WriteNode( "program", program );
+  cout << json.Dump() << endl;
+  return 0;
+} // GDumpJson()
+
+// Run the programs in JSON AST files
+int GRunJson( int count, char **paths ) {
+  int status = 0;
+  for ( int i = 0; i < count ; ++i ) {
+    MappedFile file( paths[ i ] );
+    if ( ! file.Ok() ) {
+      cerr << "Cannot open " << paths[ i ] << endl;
+      status = 1;
+      continue;
+    } // if
 
-void Parser::RegisterPrefix( TokenType tp, Handler fn ) {
-  mPrefixFNs [ tp ] = fn;
-} // Parser::RegisterPrefix()
+    AstPool pool;
+    gAstPool = &pool;
+    Program *program = GLoadJson( string( file.Data(), file.Size() ) );
+    gAstPool = NULL;
+    if ( program == NULL ) {
+      cerr << "Invalid JSON AST " << paths[ i ] << endl;
+      status = 1;
+      continue;
+    } // if
 
-void Parser::RegisterInfix( TokenType tp, Handler fn ) {
-  mInfixFNs [ tp ] = fn;
-} // Parser::RegisterInfix()
+    Environment env;
+    program -> Eval( &env );
+  } // for
 
-BindingPower Parser::BPLookUp( Token* tok ) {
-  if ( mPrecedences.find( tok->type ) != mPrecedences.end( ) )
-    return mPrecedences [ tok->type ];
+  return status;
+} // GRunJson()
+
+// Run the script at path in globals, its AST lives in pool, which must
+// outlive the functions it declares. False if it can not be read, parsed
+// or run.
+bool GRunPrelude( const char *path, AstPool *pool, Environment *globals ) {
+  MappedFile file( path );
+  if ( ! file.Ok() ) {
+    cerr << "Cannot open " << path << endl;
+    return false;
+  } // if
 
-  return LOWEST;
-} // Parser::BPLookUp()
+  AstPool *savedPool = gAstPool;
+  gAstPool = pool;
+  istringstream text( string( file.Data(), file.Size() ) );
+  Parser parser( &text );
+  Environment scope;
+  Program *program = parser.ParseScript( &scope );
+  gAstPool = savedPool;
+  if ( program == NULL ) {
+    GReportParseError( parser, *gOut );
+    cerr << "Cannot parse " << path << endl;
+    return false;
+  } // if
 
+  if ( ! program -> mBody.empty() && program -> Eval( globals ) == NULL ) {
+    cerr << "Cannot run " << path << endl;
+    return false;
+  } // if
 
-bool Parser::CurrentTokenIs( TokenType tp ) {
-  Token* current = mToks[0];
-  if ( tp == current -> type )
-    return true;
-  return false;
-} // Parser::CurrentTokenIs()
+  return true;
+} // GRunPrelude()
+
+// --each-line : program runs once per line of stdin, with line and lineno
+// bound in env. Its globals carry over from one line to the next, only
+// the two bindings change.
+const size_t kEachLineSweep = 4096; // Objects made before the first sweep
+
+// The values of a line that the globals no longer reach are freed once
+// the heap doubled since the last sweep, so memory follows what the
+// script keeps and not the length of the input
+void GRunEachLine( Program *program, Environment *env ) {
+  RunHeap heap;
+  RunHeap *savedHeap = gRunHeap;
+  gRunHeap = &heap;
+  vector< const VarMap * > roots( 1, &env -> Vars() );
+  size_t kept = 0; // Held after the last sweep
+
+  const char *data;
+  size_t size;
+  int lineno = 0;
+  while ( gStdinReader.ReadLine( data, size ) ) {
+    env -> Set( "line", new String( "String", string( data, size ) ) );
+    env -> Set( "lineno", new Integer( ++lineno, "Integer" ) );
+    program -> Eval( env );
+    if ( heap.Size() >= 2 * kept + kEachLineSweep ) {
+      heap.Sweep( roots );
+      kept = heap.Size();
+    } // if
+  } // while
 
-Expression *Parser::ParseBoolean( Environment *env ) {
-  Token* current = mToks[0];
-  Expression *expr = new BooleanExpression( current, current -> value );
-  return expr;
-} // Parser::ParseBoolean()
+  gRunHeap = savedHeap;
+  heap.Release(); // env still holds the values of the last lines
+} // GRunEachLine()
+
+// ---------------------------- Columns -------------------
+// The input of --columns, a CSV file or a binary one :
+//   "PCOL", u32 column count, u64 row count,
+//   per column : u8 type ( 0 int, 1 float ), u32 name size, the name,
+//   then per column its rows as 32 bit values,
+// in the byte order of the machine. The first CSV line names the
+// columns, a column is int when all of its cells are.
+const char kColumnsMagic[ 4 ] = { 'P', 'C', 'O', 'L' };
+
+void GTrim( const char *&at, const char *&end ) {
+  while ( at < end && isspace( *at ) )
+    ++at;
+  while ( end > at && isspace( end[ -1 ] ) )
+    --end;
+} // GTrim()
+
+// A CSV cell, false if it is no number
+bool GParseCell( const char *at, const char *end, bool &isInt, int &i, float &f ) {
+  GTrim( at, end );
+  bool negative = at < end && *at == '-';
+  if ( at < end && ( *at == '-' || *at == '+' ) )
+    ++at;
+
+  DecimalScan scan;
+  bool dot = false;
+  bool digits = false;
+  long long whole = 0;
+  for ( const char *c = at; c < end; ++c ) {
+    if ( *c == '.' && ! dot )
+      dot = true;
+    else if ( ! isdigit( *c ) )
+      return false;
+    else {
+      digits = true;
+      scan.AddDigit( *c, dot );
+      whole = min( whole * 10 + ( *c - '0' ), ( long long ) INT_MAX + 1 );
+    } // else
+  } // for
 
-Expression* Parser::ParseGroup( Environment *env ) {
-  Pop();
-  NextToken();
-  Expression *expr = ParseExpression( LOWEST, env, false );
-  if ( !CurrentTokenIs( RPAREN ) ) {
-    string err = "Unexpected token : '" + mToks[0] -> value + "'\n";
-    mErrs.push_back( err ); 
-    return NULL; 
-  } // if
+  if ( ! digits )
+    return false;
 
-  if ( expr == NULL )
-    return NULL;
+  whole = negative ? -whole : whole;
+  isInt = ! dot && whole >= INT_MIN && whole <= INT_MAX;
+  i = ( int ) whole;
+  f = scan.ToFloat( string( at, end - at ) );
+  f = negative ? -f : f;
+  return true;
+} // GParseCell()
+
+bool GLoadCsv( const char *data, size_t size, ColumnSet *set, string &error ) {
+  const char *end = data + size;
+  vector< const char * > cells; // Start of each cell and the end of the last
+  for ( int line = 1; data < end; ++line ) {
+    const char *eol = ( const char * ) memchr( data, '\n', end - data );
+    if ( eol == NULL )
+      eol = end;
+    const char *stop = ( eol > data && eol[ -1 ] == '\r' ) ? eol - 1 : eol;
+    const char *start = data;
+    data = ( eol < end ) ? eol + 1 : end;
+    if ( stop == start )
+      continue; // Blank lines are skipped
+
+    cells.assign( 1, start );
+    for ( const char *at = start; at < stop; ++at )
+      if ( *at == ',' )
+        cells.push_back( at + 1 );
+    cells.push_back( stop + 1 );
+
+    size_t count = cells.size() - 1;
+    if ( set -> columns.empty() ) {
+      set -> columns.resize( count );
+      for ( size_t c = 0; c < count; ++c ) {
+        const char *at = cells[ c ], *last = cells[ c + 1 ] - 1;
+        GTrim( at, last );
+        set -> columns[ c ].name = string( at, last - at );
+        set -> columns[ c ].tag = VM_INT;
+      } // for
+
+      continue;
+    } // if
 
-  return expr;
-} // Parser::ParseGroup()
+    if ( count != set -> columns.size() ) {
+      error = "line " + to_string( line ) + " has " + to_string( count ) + 
+              " cells for " + to_string( set -> columns.size() ) + " columns";
+      return false;
+    } // if
 
+    for ( size_t c = 0; c < count; ++c ) {
+      bool isInt;
+      int i;
+      float f;
+      if ( ! GParseCell( cells[ c ], cells[ c + 1 ] - 1, isInt, i, f ) ) {
+        error = "line " + to_string( line ) + " : '" + 
+                string( cells[ c ], cells[ c + 1 ] - 1 ) + "' is not a number";
+        return false;
+      } // if
 
-Expression *Parser::ParseChar( Environment *env ) {
-  string str = mToks[0] -> value;
-  char ch = str[0];
-  CharExpr *expr = new CharExpr( ch );
-  return expr;
-} // Parser::ParseChar()
+      Column &column = set -> columns[ c ];
+      if ( column.tag == VM_INT && ! isInt ) {
+        column.tag = VM_FLOAT; // The ints so far become floats
+        column.floats.assign( column.ints.begin(), column.ints.end() );
+        column.ints.clear();
+      } // if
 
+      if ( column.tag == VM_INT )
+        column.ints.push_back( i );
+      else
+        column.floats.push_back( f );
+    } // for
 
-Expression *Parser::ParseString( Environment *env ) {
-  string str = mToks[0] -> value;
-  StringExpr *expr = new StringExpr( str );
-  return expr;
-} // Parser::ParseString()
+    set -> rows++;
+  } // for
 
-Expression *Parser::ParseNumber( Environment *env ) {
-  stringstream ss( mToks[0]->value ) ;
-  if ( mToks[0]->type == INT ) {
-    size_t num;
-    ss >> num;
-    IntExpr *integer = new IntExpr( mToks[0], num ) ;
-    return integer;
+  if ( set -> columns.empty() ) {
+    error = "no header line";
+    return false;
   } // if
 
-  float num = GStringToFloat( mToks[0]->value );
-  FloatExpr *fp = new FloatExpr( mToks[0], num ) ;
-  return fp;
-
-} // Parser::ParseNumber()
-
+  return true;
+} // GLoadCsv()
+
+// n bytes at at into out, false past the end
+bool GTake( const char *data, size_t size, size_t &at, void *out, size_t n ) {
+  if ( n > size - at )
+    return false;
+  memcpy( out, data + at, n );
+  at += n;
+  return true;
+} // GTake()
+
+bool GLoadColumns( const char *data, size_t size, ColumnSet *set, string &error ) {
+  if ( size < sizeof( kColumnsMagic ) || memcmp( data, kColumnsMagic, sizeof( kColumnsMagic ) ) != 0 )
+    return GLoadCsv( data, size, set, error );
+
+  size_t at = sizeof( kColumnsMagic );
+  unsigned int count = 0;
+  unsigned long long rows = 0;
+  error = "truncated column file";
+  if ( ! GTake( data, size, at, &count, 4 ) || ! GTake( data, size, at, &rows, 8 ) )
+    return false;
+  if ( rows > size / 4 || count > size )
+    return false;
+
+  set -> rows = rows;
+  set -> columns.resize( count );
+  for ( unsigned int c = 0; c < count; ++c ) {
+    unsigned char type = 0;
+    unsigned int length = 0;
+    if ( ! GTake( data, size, at, &type, 1 ) || ! GTake( data, size, at, &length, 4 ) || 
+         length > size - at )
+      return false;
+    set -> columns[ c ].tag = ( type == 0 ) ? VM_INT : VM_FLOAT;
+    set -> columns[ c ].name = string( data + at, length );
+    at += length;
+  } // for
 
-Expression *Parser::ParsePrefix( Environment *env, bool CinCout ) {
-  Token *op = Pop();
-  NextToken( ) ;
+  for ( unsigned int c = 0; c < count; ++c ) {
+    Column &column = set -> columns[ c ];
+    void *values = NULL;
+    if ( column.tag == VM_INT ) {
+      column.ints.resize( rows );
+      values = column.ints.data();
+    } // if
+    else {
+      column.floats.resize( rows );
+      values = column.floats.data();
+    } // else
 
-  if ( mToks[0] -> type == ILLEGAL ) {
-    string err = "Unrecognized token with first char : '" + mToks[0] -> value + "'\n";
-    mErrs.push_back( err ); 
-    return NULL; 
-  } // if
+    if ( ! GTake( data, size, at, values, rows * 4 ) )
+      return false;
+  } // for
 
-  Expression *right = ParseExpression( PREFIX, env, CinCout ) ;
-  if ( right == NULL  )
-    return NULL;
+  error = "";
+  return true;
+} // GLoadColumns()
+
+const size_t kColumnsSweep = 4096; // Objects made before the first sweep
+
+// --columns and Program::Evaluate : the statements of program but the
+// last run once in env, the last one once per row. Expressions the VM
+// compiles go through RunVector a batch at a time, other statements and
+// the batches it gives up on through the tree walker row by row, whose
+// messages go to errors. ok is false for the rows without a number. The
+// values of the rows the tree walker made are freed as GRunEachLine()
+// frees those of its lines.
+void GEvalColumns( Program *program, Environment *env, const ColumnSet &set, 
+                   vector< VmValue > *values, vector< char > *ok, ostream &errors ) {
+  values -> assign( set.rows, VmValue() );
+  ok -> assign( set.rows, false );
+  if ( program -> mBody.empty() )
+    return;
+
+  for ( size_t i = 0; i + 1 < program -> mBody.size(); ++i ) {
+    if ( program -> mBody[ i ] -> Eval( env ) == NULL )
+      return;
+  } // for
 
+  Statement *last = program -> mBody.back();
+  ExpressionStatement *stmt = dynamic_cast< ExpressionStatement * >( last );
+  BinExpr *expr = stmt != NULL ? dynamic_cast< BinExpr * >( stmt -> Expr() ) : NULL;
+  Bytecode *code = expr != NULL ? expr -> Code() : NULL;
+  VectorBinding binding;
+  if ( code != NULL && ! code -> BindColumns( set, env, &binding ) )
+    code = NULL;
+
+  VmVector batch;
+  Environment row;
+  row.SetOuter( env );
+  RunHeap heap;
+  RunHeap *savedHeap = gRunHeap;
+  gRunHeap = &heap;
+  vector< const VarMap * > roots;
+  roots.push_back( &env -> Vars() );
+  roots.push_back( &row.Vars() );
+  size_t kept = 0; // Held after the last sweep
+  for ( size_t begin = 0; begin < set.rows; begin += kVectorWidth ) {
+    int n = min( ( size_t ) kVectorWidth, set.rows - begin );
+    if ( code != NULL && code -> RunVector( binding, begin, n, &batch ) ) {
+      for ( int k = 0; k < n; ++k ) {
+        VmValue &v = ( *values )[ begin + k ];
+        v.tag = batch.tag;
+        v.i = batch.i[ k ];
+        v.f = batch.f[ k ];
+        ( *ok )[ begin + k ] = true;
+      } // for
+
+      continue;
+    } // if
 
-  UnaryExpression *prefix = new UnaryExpression( op, right ) ;
-  return prefix;
-} // Parser::ParsePrefix()
+    for ( size_t r = begin; r < begin + n; ++r ) {
+      if ( heap.Size() >= 2 * kept + kColumnsSweep ) {
+        heap.Sweep( roots );
+        kept = heap.Size();
+      } // if
 
-Expression *Parser::ParseInfix( Expression *left, Environment *env, bool CinCout ) {
-  BinExpr* infix = NULL;
-  Token *op = Pop(); 
-  BindingPower bp = BPLookUp( op );
-  NextToken();
-  Expression* right = ParseExpression( bp, env, CinCout );
-  if ( right != NULL ) 
-    infix = new BinExpr( left, op, right ); 
+      for ( size_t c = 0; c < set.columns.size(); ++c ) {
+        const Column &column = set.columns[ c ];
+        if ( column.tag == VM_INT )
+          row.Set( column.name, new Integer( column.ints[ r ], "Integer" ) );
+        else
+          row.Set( column.name, new Float( column.floats[ r ], "Float" ) );
+      } // for
+
+      ostringstream messages;
+      ostream *savedOut = gOut;
+      gOut = &messages;
+      Obj *result = last -> Eval( &row );
+      gOut = savedOut;
+
+      ObjKind kind = result != NULL ? result -> Kind() : NULL_KIND;
+      VmValue &v = ( *values )[ r ];
+      if ( kind == INT_KIND ) {
+        v.tag = VM_INT;
+        v.i = GIntOf( result );
+      } // if
+      else if ( kind == FLOAT_KIND ) {
+        v.tag = VM_FLOAT;
+        v.f = GFloatOf( result );
+      } // else if
+      else if ( kind == BOOL_KIND ) {
+        v.tag = VM_BOOL;
+        v.i = result -> Value() == "true";
+      } // else if
+      else {
+        errors << "row " << r + 1 << " : " << messages.str();
+        if ( result != NULL )
+          errors << "not a number\n";
+        continue;
+      } // else
+
+      ( *ok )[ r ] = true;
+    } // for
+  } // for
 
-  return infix;
-} // Parser::ParseInfix()
+  gRunHeap = savedHeap;
+  heap.Release(); // env still holds what the rows assigned
+} // GEvalColumns()
+
+// One line per row as cout would print the value, an empty one for the
+// rows without a value
+void GPrintColumnResults( const vector< VmValue > &values, const vector< char > &ok ) {
+  char buf[ kNumberChars ];
+  for ( size_t r = 0; r < values.size(); ++r ) {
+    int len = 0;
+    if ( ! ok[ r ] )
+      len = 0;
+    else if ( values[ r ].tag == VM_INT )
+      len = GFormatInt( values[ r ].i, buf );
+    else if ( values[ r ].tag == VM_FLOAT )
+      len = GFormatFixed3( GRound( values[ r ].f ), buf );
+    else {
+      const char *word = values[ r ].i != 0 ? "true" : "false";
+      len = strlen( word );
+      memcpy( buf, word, len );
+    } // else
+    buf[ len++ ] = '\n';
+    gOut -> write( buf, len );
+  } // for
+} // GPrintColumnResults()
+
+// ---------------------------- Interpreter -------------------
+// An embeddable interpreter : its own AST pool, globals and output
+// buffer. The thread_local context ( gAstPool, gOut ) points at them
+// while it runs, so interpreters on different threads share nothing
+// mutable. Scripts come from the program cache and are shared, the
+// functions they declare keep their AST through mPrograms.
+class Interpreter {
+  AstPool mPool; // AST images
+  vector< ProgramRef > mPrograms;
+  Environment mGlobals;
+  ostringstream mOut;
+  ostringstream mErrs;
+
+  Program *Load( const char *path, const char *data, size_t size ) ;
+  int Exec( Program *program ) ;
 
-Expression *Parser::ParseIdentifier( Environment *env ) {
-  if ( CurrentTokenIs( PLUSPLUS ) || CurrentTokenIs( MINUSMINUS ) ) {
-    Token* op = Pop();
-    NextToken();
+public:
+  // Starts with the globals of prelude when there is one
+  Interpreter( const EnvSnapshot *prelude = NULL ) {
+    if ( prelude != NULL )
+      mGlobals = Environment( *prelude );
+  } // Interpreter()
+
+  int Run( const string &source ) ;
+  int RunFile( const char *path ) ;
+
+  string Output( ) {
+    return mOut.str();
+  } // Output()
+
+  string Errors( ) {
+    return mErrs.str();
+  } // Errors()
+};
 
-    if ( !Expect( mToks[0], IDENT ) ) 
-      return NULL;
-    
-    if ( env -> VarExist( mToks[0]->value ) == false ) {
-      string err = "Undefined identifier : '" + mToks[0] -> value + "'\n";
-      mErrs.push_back( err ); 
+// Decode an AST image into the interpreter's pool, or take the parsed
+// script from the program cache
+Program *Interpreter::Load( const char *path, const char *data, size_t size ) {
+  if ( ! BinaryAstReader::IsImage( data, size ) ) {
+    vector< string > errors;
+    ProgramRef parsed = GProgramCache().Get( string( data, size ), mGlobals.Names(), &errors );
+    if ( parsed == NULL ) {
+      if ( ! errors.empty() )
+        mOut << errors[ 0 ];
       return NULL;
     } // if
 
+    mPrograms.push_back( parsed );
+    return parsed -> program;
+  } // if
 
-    SymbolExpression *id = new SymbolExpression( mToks[0], mToks[0] -> value );
-    UpdateExpression *upexpr = new UpdateExpression( op, id, true );
-    Pop();
-    NextToken();
-
-    return upexpr;
+  AstPool *savedPool = gAstPool;
+  gAstPool = &mPool;
+  Program *program = GLoadImage( data, size );
+  if ( program == NULL )
+    mErrs << "Invalid AST image " << path << endl;
+  gAstPool = savedPool;
+  return program;
+} // Interpreter::Load()
+
+// Evaluate program in the globals, writing to the output buffer
+int Interpreter::Exec( Program *program ) {
+  if ( program == NULL )
+    return 1;
+
+  ostream *savedOut = gOut;
+  InputReader *savedIn = gIn;
+  gOut = &mOut;
+  gIn = NULL;
+  program -> Eval( &mGlobals );
+  if ( gCheckBodies )
+    GCheckBodies( program, &mGlobals );
+  gOut = savedOut;
+  gIn = savedIn;
+  return 0;
+} // Interpreter::Exec()
+
+int Interpreter::Run( const string &source ) {
+  return Exec( Load( "<source>", source.data(), source.size() ) );
+} // Interpreter::Run()
+
+int Interpreter::RunFile( const char *path ) {
+  MappedFile file( path );
+  if ( ! file.Ok() ) {
+    mErrs << "Cannot open " << path << endl;
+    return 1;
   } // if
 
-  else {
-    SymbolExpression* id = new SymbolExpression( mToks[0], mToks[0] -> value ); 
-    
-    if ( env -> VarExist( mToks[0]->value ) == false ) {
-      string err = "Undefined identifier : '" + mToks[0] -> value + "'\n";
-      mErrs.push_back( err ); 
-      return NULL;
-    } // if
-    
-    Pop();
-    NextToken();
-    
-    if ( mToks[0] -> type ==  PLUSPLUS || mToks[0] -> type == MINUSMINUS ) {
-      Token *op = Pop();
-      NextToken();
-      UpdateExpression *upexpr = new UpdateExpression( op, id, false ); 
-      return upexpr;
-    } // if
-    
-    else 
-      return id;
-  } // else if
+  return Exec( Load( path, file.Data(), file.Size() ) );
+} // Interpreter::RunFile()
+
+// The scripts of a --jobs run, taken in order by the workers
+struct JobQueue {
+  char **paths;
+  int count;
+  const EnvSnapshot *prelude; // NULL without --prelude
+  atomic< int > next;
+  vector< string > outputs;
+  vector< string > errors;
+  vector< int > statuses;
+  mutex lock; // Guards stats
+  RuntimeStats stats;
+};
 
-} // Parser::ParseIdentifier()
+void GRunJobs( JobQueue *queue ) {
+  for ( int i = queue -> next++; i < queue -> count; i = queue -> next++ ) {
+    Interpreter interpreter( queue -> prelude );
+    queue -> statuses[ i ] = interpreter.RunFile( queue -> paths[ i ] );
+    queue -> outputs[ i ] = interpreter.Output();
+    queue -> errors[ i ] = interpreter.Errors();
+  } // for
 
-vector <Parameter*> Parser::ParseParameter() {
-  vector <Parameter*> params;
-  bool pbr = false;
-  // Skip ( 
-  Pop();
-  NextToken();
+  lock_guard< mutex > guard( queue -> lock );
+  queue -> stats.Add( gStats );
+} // GRunJobs()
+
+// Run independent scripts on jobs threads, each in its own Interpreter
+// forked from prelude if not NULL. Outputs are written in the order of
+// paths once all are done.
+int GRunBatch( int jobs, int count, char **paths, const EnvSnapshot *prelude ) {
+  JobQueue queue;
+  queue.paths = paths;
+  queue.count = count;
+  queue.prelude = prelude;
+  queue.next = 0;
+  queue.outputs.resize( count );
+  queue.errors.resize( count );
+  queue.statuses.resize( count );
+
+  vector< thread > workers;
+  for ( int i = 0; i < jobs && i < count; ++i )
+    workers.push_back( thread( GRunJobs, &queue ) );
+  for ( size_t i = 0; i < workers.size(); ++i )
+    workers[ i ].join();
+
+  int status = 0;
+  for ( int i = 0; i < count; ++i ) {
+    *gOut << queue.outputs[ i ];
+    cerr << queue.errors[ i ];
+    status = max( status, queue.statuses[ i ] );
+  } // for
 
-  if ( CurrentTokenIs( RPAREN ) )
-    return params;
-    
-  // Data type
-  Token *kind = Pop();
-  NextToken();
-  if ( CurrentTokenIs( PASSREF ) ) {
-    pbr = true;
-    Pop();
-    NextToken();
-  } // if
-  
-  // ID 
-  Token *id = Pop();
-  SymbolExpression *ident = new SymbolExpression( id, id -> value );
-  Parameter *param = new Parameter( kind, ident, pbr ); 
-  params.push_back( param );
+  gStats.Add( queue.stats );
+  return status;
+} // GRunBatch()
+
+// ---------------------------- Parallel statements -------------------
+// --parallel N : top level statements that touch disjoint names run at
+// the same time. EffectWriter walks a statement through Serialize to
+// find the names it reads and writes, calls add the effects of the
+// called function bodies. Statements that conflict are ordered as in the
+// program. Each statement writes to its own buffer and the buffers are
+// flushed in program order.
+struct Effects {
+  set< string > reads;
+  set< string > writes;
+  set< string > calls; // Functions called, resolved by EffectWriter::Take
+  bool barrier; // Unknown effects, runs after and before everything
+
+  Effects( ) {
+    barrier = false;
+  } // Effects()
+
+  void Merge( const Effects &other ) {
+    reads.insert( other.reads.begin(), other.reads.end() );
+    writes.insert( other.writes.begin(), other.writes.end() );
+    barrier = barrier || other.barrier;
+  } // Merge()
+};
 
-  NextToken();
-  while ( CurrentTokenIs( COMMA ) ) {
-    pbr = false;
-    // Skip comma
-    Pop();
-    NextToken();
-    // Data type
-    kind = Pop();
-    NextToken();
+class EffectWriter : public AstWriter {
+  struct Frame {
+    NodeKind kind;
+    const char *field; // Field of the parent holding the node
+  };
 
-    if ( CurrentTokenIs( PASSREF ) ) 
-      pbr = true;
+  vector< Frame > mFrames;
+  const char *mField; // Field of the next node
+  Effects mStmt;
+  string mFunction; // Function whose parameters and body are walked
+  vector< string > mLocals; // Its parameters and the names its open blocks declared
+  vector< size_t > mBlocks; // Size of mLocals when each open block began
+  map< string, Effects > mFunctions; // Body effects of the declared functions
 
-    // ID
-    id = Pop();
-    ident = new SymbolExpression( id, id -> value );
-    param = new Parameter( kind, ident, pbr );
-    params.push_back( param );
+  Effects &Target( ) {
+    return mFunction.empty() ? mStmt : mFunctions[ mFunction ];
+  } // Target()
 
-    NextToken();
+  bool Local( const string &name ) {
+    return find( mLocals.begin(), mLocals.end(), name ) != mLocals.end();
+  } // Local()
+
+  void Name( const string &name ) ;
+
+public:
+  EffectWriter( ) {
+    mField = NULL;
+  } // EffectWriter()
+
+  Effects Take( Statement *stmt ) ;
+
+  void BeginNode( NodeKind kind, const Span &span ) ;
+  void EndNode( ) ;
+  void WriteInt( const char * /* field */, long long /* v */ ) { } // WriteInt()
+  void WriteFloat( const char * /* field */, float /* v */ ) { } // WriteFloat()
+  void WriteString( const char *field, const string &str ) ;
+  void WriteToken( const char * /* field */, Token * /* tok */ ) { } // WriteToken()
+  void WriteNode( const char *field, Node *node ) ;
+  void BeginList( const char * /* field */, size_t /* count */ ) { } // BeginList()
+  void EndList( ) { } // EndList()
+};
+
+// The effects of stmt with the bodies of the functions it calls,
+// using the functions declared so far
+Effects EffectWriter::Take( Statement *stmt ) {
+  mStmt = Effects();
+  WriteNode( NULL, stmt );
+
+  Effects fx = mStmt;
+  set< string > seen;
+  vector< string > pending( mStmt.calls.begin(), mStmt.calls.end() );
+  while ( ! pending.empty() ) {
+    string name = pending.back();
+    pending.pop_back();
+    if ( ! seen.insert( name ).second )
+      continue;
+
+    map< string, Effects >::iterator body = mFunctions.find( name );
+    if ( body == mFunctions.end() ) {
+      fx.barrier = true; // A builtin
+      continue;
+    } // if
+
+    fx.Merge( body -> second );
+    pending.insert( pending.end(), body -> second.calls.begin(), body -> second.calls.end() );
   } // while
 
-  return params;
-} // Parser::ParseParameter()
+  return fx;
+} // EffectWriter::Take()
+
+void EffectWriter::WriteNode( const char *field, Node *node ) {
+  if ( node == NULL )
+    return;
+
+  mField = field;
+  node -> Serialize( this );
+} // EffectWriter::WriteNode()
+
+void EffectWriter::BeginNode( NodeKind kind, const Span & /* span */ ) {
+  Frame frame;
+  frame.kind = kind;
+  frame.field = mField;
+  if ( kind == FUNCTION_DECL_NODE && ! mFunction.empty() )
+    Target().barrier = true; // Nested functions are not tracked
+  if ( kind == CIN_NODE )
+    Target().barrier = true; // Input is consumed in program order
+  if ( kind == BLOCK_NODE )
+    mBlocks.push_back( mLocals.size() );
+  mFrames.push_back( frame );
+} // EffectWriter::BeginNode()
+
+// A name a block of a function declared is a global again after the
+// block, as it is when the block did not run
+void EffectWriter::EndNode( ) {
+  if ( mFrames.back().kind == BLOCK_NODE ) {
+    if ( mLocals.size() > mBlocks.back() )
+      mLocals.resize( mBlocks.back() );
+    mBlocks.pop_back();
+  } // if
 
+  if ( mFrames.back().kind == FUNCTION_DECL_NODE ) {
+    mFunction = "";
+    mLocals.clear();
+  } // if
 
-Expression *Parser::ParseExpression( BindingPower bp, Environment *env, bool CoutCin ) {
-  // At first enter
-  if ( mToks[0] -> type == ILLEGAL ) {
-    string err = "Unrecognized token with first char : '" + mToks[0] -> value + "'\n";
-    mErrs.push_back( err ); 
-    return NULL; 
+  mFrames.pop_back();
+} // EffectWriter::EndNode()
+
+void EffectWriter::WriteString( const char *field, const string &str ) {
+  if ( strcmp( field, "name" ) != 0 )
+    return;
+
+  if ( mFrames.back().kind == ARRAY_NODE )
+    Target().writes.insert( str );
+  else if ( mFrames.back().kind == SYMBOL_NODE )
+    Name( str );
+} // EffectWriter::WriteString()
+
+// A symbol, read or written depending on where it is
+void EffectWriter::Name( const string &name ) {
+  const char *field = mFrames.back().field == NULL ? "" : mFrames.back().field;
+  NodeKind parent = mFrames.size() > 1 ? mFrames[ mFrames.size() - 2 ].kind : NO_NODE;
+  if ( parent == FUNCTION_DECL_NODE && strcmp( field, "name" ) == 0 ) {
+    mStmt.writes.insert( name );
+    mFunction = name;
+    mFunctions[ name ] = Effects();
+    return;
   } // if
 
-  if ( mPrefixFNs.find( mToks[0] -> type ) == mPrefixFNs.end() ) {
-    string err = "Unexpected token : '" + mToks[0] -> value + "'\n";
-    mErrs.push_back( err ); 
-    return NULL;
+  // The frame of a call holds its parameters and what its body declares
+  if ( parent == PARAMETER_NODE || ( parent == DECLARATION_NODE && ! mFunction.empty() ) ) {
+    mLocals.push_back( name );
+    return;
   } // if
 
-  Expression *left = PrefixExecutor( env, CoutCin );
-  if ( left == NULL )
-    return NULL;
+  if ( Local( name ) )
+    return;
 
-  if ( mToks[0] -> type == ILLEGAL ) {
-    string err = "Unrecognized token with first char : '" + mToks[0] -> value + "'\n";
-    mErrs.push_back( err ); 
-    return NULL;
-  } // if 
+  if ( parent == CALL_NODE && strcmp( field, "callee" ) == 0 ) {
+    Target().reads.insert( name );
+    Target().calls.insert( name );
+  } // if
+  else if ( ( parent == ASSIGNMENT_NODE && strcmp( field, "name" ) == 0 ) ||
+            ( parent == UPDATE_NODE && strcmp( field, "id" ) == 0 ) || 
+            parent == DECLARATION_NODE || parent == CIN_NODE )
+    Target().writes.insert( name );
+  else
+    Target().reads.insert( name );
+} // EffectWriter::Name()
+
+// Runs the statements of a program as their dependencies allow, on a
+// pool of workers that steal from each other when their queue is empty
+class StatementScheduler {
+  struct Task {
+    Statement *stmt;
+    vector< int > next; // Statements waiting on this one
+    atomic< int > pending; // Statements this one waits on
+    ostringstream out;
+    Obj *result;
+  };
+
+  struct WorkQueue {
+    mutex lock;
+    deque< int > tasks; // The owner pops the back, thieves the front
+  };
 
-  if ( mToks[0] -> type == LEFT_SHIFT && CoutCin ) 
-    return left;
+  Environment *mEnv;
+  int mCount;
+  vector< Task > mTasks;
+  vector< WorkQueue > mQueues;
+  atomic< int > mDone;
+  atomic< int > mFailed; // First statement that failed, mCount if none
+  atomic< int > mQueued; // Tasks in the queues
+  mutex mIdleLock;
+  condition_variable mWake; // A task was queued or the last one is done
+  mutex mStatsLock;
+  RuntimeStats mStats; // Of the worker threads
+
+  void Depend( int before, int after ) ;
+  void Push( int worker, int task ) ;
+  bool Pop( int worker, int *task ) ;
+  void Work( int worker ) ;
+  void Fail( int task ) ;
 
-  while ( mToks[0] -> type != SEMICOLON && bp < BPLookUp( mToks[0] ) ) {
-    if ( mInfixFNs.find( mToks[0] -> type ) == mInfixFNs.end() ) {
-      string err = "Unexpected token : '" + mToks[0] -> value + "'\n";
-      mErrs.push_back( err ); 
-      return NULL;
-    } // if
-      
-    left = InfixExecutor( left, env, CoutCin );
-    if ( left == NULL )
-      return NULL;
-    
-    if ( mToks[0] -> type == ILLEGAL ) {
-      string err = "Unrecognized token with first char : '" + mToks[0] -> value + "'\n";
-      mErrs.push_back( err ); 
-      return NULL;
-    } // if
+public:
+  StatementScheduler( Program *program, Environment *env, int threads ) ;
+  Obj *Run( ) ;
+};
 
-    if ( mToks[0] -> type == LEFT_SHIFT && CoutCin ) 
-      return left;
-  } // while
+StatementScheduler::StatementScheduler( Program *program, Environment *env, int threads )
+  : mTasks( program -> mBody.size() ), mQueues( threads ) {
+  mEnv = env;
+  mCount = program -> mBody.size();
+  mDone = 0;
+  mFailed = mCount;
+  mQueued = 0;
+
+  // Who last wrote each name and who read it since
+  map< string, int > writer;
+  map< string, vector< int > > readers;
+  int barrier = -1;
+  vector< int > sinceBarrier;
+  EffectWriter analysis;
+  for ( int i = 0; i < mCount; ++i ) {
+    mTasks[ i ].stmt = program -> mBody[ i ];
+    mTasks[ i ].pending = 0;
+    mTasks[ i ].result = NULL;
+    Effects fx = analysis.Take( program -> mBody[ i ] );
+    if ( fx.barrier ) {
+      for ( size_t j = 0; j < sinceBarrier.size(); ++j )
+        Depend( sinceBarrier[ j ], i );
+      Depend( barrier, i );
+      barrier = i;
+      sinceBarrier.clear();
+      writer.clear();
+      readers.clear();
+      continue;
+    } // if
 
-  return left;
-} // Parser::ParseExpression() 
+    Depend( barrier, i );
+    for ( set< string >::iterator it = fx.reads.begin(); it != fx.reads.end(); ++it )
+      if ( writer.count( *it ) > 0 )
+        Depend( writer[ *it ], i );
+    for ( set< string >::iterator it = fx.writes.begin(); it != fx.writes.end(); ++it ) {
+      if ( writer.count( *it ) > 0 )
+        Depend( writer[ *it ], i );
+      vector< int > &before = readers[ *it ];
+      for ( size_t j = 0; j < before.size(); ++j )
+        Depend( before[ j ], i );
+    } // for
+
+    for ( set< string >::iterator it = fx.reads.begin(); it != fx.reads.end(); ++it )
+      readers[ *it ].push_back( i );
+    for ( set< string >::iterator it = fx.writes.begin(); it != fx.writes.end(); ++it ) {
+      writer[ *it ] = i;
+      readers[ *it ].clear();
+      // Declared up front, the workers then never change the shape of
+      // the global map
+      env -> Reserve( *it );
+    } // for
+
+    sinceBarrier.push_back( i );
+  } // for
+} // StatementScheduler::StatementScheduler()
 
-BlockStatement* Parser::ParseBlockStatement( Environment *env ) {
-  if ( !Expect( mToks[0], LBRACE ) ) 
-    return NULL;
-  Token* brace = Pop();
-  BlockStatement* bstmt = new BlockStatement( brace );
-  NextToken();
+void StatementScheduler::Depend( int before, int after ) {
+  if ( before < 0 || before == after )
+    return;
 
-  if ( CurrentTokenIs( RBRACE ) ) 
-    return bstmt;
+  vector< int > &next = mTasks[ before ].next;
+  if ( next.empty() || next.back() != after ) {
+    next.push_back( after );
+    ++mTasks[ after ].pending;
+  } // if
+} // StatementScheduler::Depend()
+
+void StatementScheduler::Push( int worker, int task ) {
+  {
+    lock_guard< mutex > guard( mQueues[ worker ].lock );
+    mQueues[ worker ].tasks.push_back( task );
+  }
+
+  lock_guard< mutex > idle( mIdleLock );
+  ++mQueued;
+  mWake.notify_one();
+} // StatementScheduler::Push()
+
+bool StatementScheduler::Pop( int worker, int *task ) {
+  {
+    lock_guard< mutex > guard( mQueues[ worker ].lock );
+    if ( ! mQueues[ worker ].tasks.empty() ) {
+      *task = mQueues[ worker ].tasks.back();
+      mQueues[ worker ].tasks.pop_back();
+      --mQueued;
+      return true;
+    } // if
+  }
+
+  for ( size_t i = 1; i < mQueues.size(); ++i ) {
+    WorkQueue &victim = mQueues[ ( worker + i ) % mQueues.size() ];
+    lock_guard< mutex > guard( victim.lock );
+    if ( ! victim.tasks.empty() ) {
+      *task = victim.tasks.front();
+      victim.tasks.pop_front();
+      --mQueued;
+      return true;
+    } // if
+  } // for
 
-  while ( !CurrentTokenIs( RBRACE ) ) {
-    Statement *stmt = ParseCompound(env);
+  return false;
+} // StatementScheduler::Pop()
+
+// Lower mFailed to task, the statements after it are not run any more
+void StatementScheduler::Fail( int task ) {
+  int failed = mFailed.load();
+  while ( task < failed && ! mFailed.compare_exchange_weak( failed, task ) )
+    ;
+} // StatementScheduler::Fail()
+
+// A statement after one that failed is skipped, Program::Eval would not
+// have reached it. It still releases the statements waiting on it.
+void StatementScheduler::Work( int worker ) {
+  while ( mDone < mCount ) {
+    int index = 0;
+    if ( ! Pop( worker, &index ) ) {
+      unique_lock< mutex > idle( mIdleLock );
+      while ( mQueued == 0 && mDone < mCount )
+        mWake.wait( idle );
+      continue;
+    } // if
 
-    if ( stmt == NULL )
-      return NULL;
+    Task &task = mTasks[ index ];
+    if ( index < mFailed ) {
+      ostream *savedOut = gOut;
+      gOut = &task.out;
+      gCurrentStmt = task.stmt;
+      task.result = task.stmt -> Eval( mEnv );
+      gCurrentStmt = NULL;
+      gOut = savedOut;
+      if ( task.result == NULL )
+        Fail( index );
+    } // if
 
-    bstmt -> Append( stmt );
-    mCurToken  = mLexer -> ReadNextToken();
-    if ( mCurToken -> type != EOFF )
-      mToks.push_back( mCurToken );
-    else 
-      Init();
+    for ( size_t i = 0; i < task.next.size(); ++i )
+      if ( --mTasks[ task.next[ i ] ].pending == 0 )
+        Push( worker, task.next[ i ] );
+    if ( ++mDone == mCount ) {
+      lock_guard< mutex > idle( mIdleLock );
+      mWake.notify_all();
+    } // if
   } // while
 
-  return bstmt;
-} // Parser::ParseBlockStatment();
+  if ( worker > 0 ) {
+    lock_guard< mutex > guard( mStatsLock );
+    mStats.Add( gStats );
+  } // if
+} // StatementScheduler::Work()
+
+// Same result and output as Program::Eval : the outputs up to the first
+// statement that fails
+Obj *StatementScheduler::Run( ) {
+  for ( int i = 0; i < mCount; ++i )
+    if ( mTasks[ i ].pending == 0 )
+      Push( i % mQueues.size(), i );
+
+  vector< thread > workers;
+  for ( size_t i = 1; i < mQueues.size(); ++i )
+    workers.push_back( thread( &StatementScheduler::Work, this, i ) );
+  Work( 0 );
+  for ( size_t i = 0; i < workers.size(); ++i )
+    workers[ i ].join();
+  gStats.Add( mStats );
 
-Statement* Parser::ParseExpressionStmt( Environment *env ) {
-  ExpressionStatement *exprStmt = NULL;
-  Token *start = mToks[0]; 
-  Expression *expr = ParseExpression( LOWEST, env, false ); 
-  if ( expr == NULL  )
-    return NULL;
+  Obj *result = NULL;
+  for ( int i = 0; i < mCount; ++i ) {
+    *gOut << mTasks[ i ].out.str();
+    result = mTasks[ i ].result;
+    if ( result == NULL )
+      break;
+  } // for
 
-  exprStmt = new ExpressionStatement( expr, start );
+  return result;
+} // StatementScheduler::Run()
+
+// Evaluate program on threads workers, in order on this one below two
+Obj *GEvalProgram( Program *program, Environment *env, int threads ) {
+  if ( threads < 2 )
+    return program -> Eval( env );
+
+  StatementScheduler scheduler( program, env, threads );
+  return scheduler.Run();
+} // GEvalProgram()
+
+} // namespace detail
+} // namespace interp
+
+// ---------------------------- Embedding API -------------------
+// include/interpreter.hpp, on top of the same parser and evaluator
+namespace interp {
+
+// Program alone names both the API class and the internal one, the API
+// class is spelled interp::Program
+using namespace detail;
+
+Value::Value( ) {
+  mKind = NONE;
+  mInt = 0;
+  mFloat = 0;
+} // Value::Value()
+
+Value::Value( int value ) {
+  mKind = INT;
+  mInt = value;
+  mFloat = value;
+} // Value::Value()
+
+Value::Value( double value ) {
+  mKind = FLOAT;
+  mInt = ( int ) value;
+  mFloat = value;
+} // Value::Value()
+
+Value::Value( bool value ) {
+  mKind = BOOL;
+  mInt = value;
+  mFloat = value;
+} // Value::Value()
+
+Value::Value( const char *value ) {
+  mKind = STRING;
+  mInt = 0;
+  mFloat = 0;
+  mString = value;
+} // Value::Value()
+
+Value::Value( const string &value ) {
+  mKind = STRING;
+  mInt = 0;
+  mFloat = 0;
+  mString = value;
+} // Value::Value()
+
+Value Value::Char( char value ) {
+  Value v;
+  v.mKind = CHAR;
+  v.mInt = value;
+  v.mString = string( 1, value );
+  return v;
+} // Value::Char()
+
+int Value::AsInt( ) const {
+  return mKind == FLOAT ? ( int ) mFloat : mInt;
+} // Value::AsInt()
+
+double Value::AsFloat( ) const {
+  return mKind == FLOAT ? mFloat : mInt;
+} // Value::AsFloat()
+
+bool Value::AsBool( ) const {
+  return mKind == FLOAT ? mFloat != 0 : mInt != 0;
+} // Value::AsBool()
+
+string Value::AsString( ) const {
+  if ( mKind == STRING || mKind == CHAR )
+    return mString;
+  if ( mKind == BOOL )
+    return mInt ? "true" : "false";
+  if ( mKind == NONE )
+    return "";
 
-  Token* end = Pop(); 
-  if ( !Expect( end, SEMICOLON ))
-    return NULL;
+  stringstream ss;
+  if ( mKind == FLOAT )
+    ss << mFloat;
+  else
+    ss << mInt;
+  return ss.str();
+} // Value::AsString()
+
+Obj *GObjOf( const Value &value ) {
+  switch ( value.GetKind() ) {
+    case Value::INT : return GMake( value.AsInt() );
+    case Value::FLOAT : return GMake( ( float ) value.AsFloat() );
+    case Value::BOOL : return GMake( value.AsBool() );
+    case Value::CHAR : return new detail::Char( value.AsString(), "Char" );
+    case Value::STRING : return GMake( value.AsString() );
+    default : return NULL;
+  } // switch
+} // GObjOf()
+
+Value GValueOf( Obj *obj ) {
+  if ( obj == NULL )
+    return Value();
+
+  switch ( obj -> Kind() ) {
+    case INT_KIND : return Value( GIntOf( obj ) );
+    case FLOAT_KIND : return Value( ( double ) GFloatOf( obj ) );
+    case BOOL_KIND : return Value( obj -> Value() == "true" );
+    case CHAR_KIND : return Value::Char( obj -> Value().empty() ? '\0' : obj -> Value()[ 0 ] );
+    case STRING_KIND : return Value( obj -> Value() );
+    default : return Value();
+  } // switch
+} // GValueOf()
+
+struct ProgramState {
+  ProgramRef parsed; // Shared with the program cache
+  detail::Program *program;
+  vector< string > errors;
+};
 
-  return exprStmt;
-} // Parser::ParseExpressionStmt()
+struct ColumnsState {
+  ColumnSet set;
+};
 
-Expression *Parser::ParseAssignExpr( Expression* left, Environment *env ) {
-  Token *op = Pop();
-  NextToken();
-  Expression *rhs = ParseExpression( LOWEST, env, false );
-  if ( rhs == NULL )
-    return NULL;
+struct ContextState {
+  RunHeap heap; // Objects and frames of the runs, freed last
+  Environment globals;
+  ostringstream out;
+  // Functions in the globals point into the programs that declared them
+  vector< shared_ptr< ProgramState > > programs;
+  shared_ptr< ContextState > prelude; // Closure of the snapshot functions
+  vector< weak_ptr< const VarMap > > frozen; // Snapshots taken by Freeze()
+};
 
-  Expression *expr = new AssignmentExpr( op, left, rhs );
-  return expr;
-} // Parser::ParseAssignStmt()
+// End of a run in state : free what neither its globals nor a snapshot
+// still alive reach
+void GSweep( ContextState *state ) {
+  vector< shared_ptr< const VarMap > > alive;
+  vector< const VarMap * > roots( 1, &state -> globals.Vars() );
+  size_t kept = 0;
+  for ( size_t i = 0; i < state -> frozen.size(); ++i ) {
+    shared_ptr< const VarMap > vars = state -> frozen[ i ].lock();
+    if ( vars == NULL )
+      continue;
+    alive.push_back( vars );
+    roots.push_back( vars.get() );
+    state -> frozen[ kept++ ] = state -> frozen[ i ];
+  } // for
 
-Statement *Parser::ParseReturnStmt( Environment *env ) {
-  Statement *stmt = NULL;
-  Token* ret = Pop(); 
-  NextToken();
-  Expression *rhs = ParseExpression( LOWEST, env, false );
-  stmt = new ReturnStmt( ret, rhs ); 
-  Token* end = Pop();
-  if ( !Expect( end, SEMICOLON ) )
-    return NULL;
+  state -> frozen.resize( kept );
+  state -> heap.Sweep( roots );
+} // GSweep()
 
-  return stmt;
-} // Parser::ParseReturnStmt() 
+struct SnapshotState {
+  EnvSnapshot globals;
+  shared_ptr< ContextState > source;
+};
 
-FunctionDeclaration *Parser::ParseFunction( Environment *env, FunctionDeclaration *func ) {
-  FunctionDeclaration *funcRes = func; 
-  Environment* innerEnv = new Environment(); 
-  innerEnv -> SetOuter( env );
-  vector < Parameter *> prms = ParseParameter();
+Snapshot::Snapshot( ) {
+} // Snapshot::Snapshot()
 
-  if ( !Expect( mToks[0], RPAREN ) )
-    return NULL;
+Context::Context( ) {
+  mState = make_shared< ContextState >();
+} // Context::Context()
 
-  for ( int i = 0; i < prms.size(); ++i ) { 
-    Obj* parameter_value = prms[i] -> Eval( innerEnv );
-    funcRes -> Append( prms[i] );
+Context::Context( const Snapshot &snapshot ) {
+  mState = make_shared< ContextState >();
+  if ( snapshot.mState != NULL ) {
+    mState -> globals = Environment( snapshot.mState -> globals );
+    mState -> programs = snapshot.mState -> source -> programs;
+    mState -> prelude = snapshot.mState -> source;
+  } // if
+} // Context::Context()
+
+Context::~Context( ) {
+} // Context::~Context()
+
+Snapshot Context::Freeze( ) const {
+  Snapshot snapshot;
+  snapshot.mState = make_shared< SnapshotState >();
+  snapshot.mState -> globals = mState -> globals.Snapshot();
+  snapshot.mState -> source = mState;
+  mState -> frozen.push_back( snapshot.mState -> globals.vars );
+  return snapshot;
+} // Context::Freeze()
+
+void Context::Set( const string &name, const Value &value ) {
+  RunHeap *savedHeap = gRunHeap;
+  gRunHeap = &mState -> heap;
+  mState -> globals.Set( name, GObjOf( value ) );
+  gRunHeap = savedHeap;
+} // Context::Set()
+
+Value Context::Get( const string &name ) const {
+  return GValueOf( mState -> globals.Get( name ) );
+} // Context::Get()
+
+string Context::Output( ) const {
+  return mState -> out.str();
+} // Context::Output()
+
+void Context::ClearOutput( ) {
+  mState -> out.str( "" );
+} // Context::ClearOutput()
+
+Columns::Columns( ) {
+  mState = make_shared< ColumnsState >();
+} // Columns::Columns()
+
+bool Columns::AddInt( const string &name, const vector< int > &rows ) {
+  ColumnSet &set = mState -> set;
+  if ( set.Find( name ) >= 0 || ( ! set.columns.empty() && rows.size() != set.rows ) )
+    return false;
+
+  Column column;
+  column.name = name;
+  column.tag = VM_INT;
+  column.ints = rows;
+  set.columns.push_back( column );
+  set.rows = rows.size();
+  return true;
+} // Columns::AddInt()
+
+bool Columns::AddFloat( const string &name, const vector< float > &rows ) {
+  ColumnSet &set = mState -> set;
+  if ( set.Find( name ) >= 0 || ( ! set.columns.empty() && rows.size() != set.rows ) )
+    return false;
+
+  Column column;
+  column.name = name;
+  column.tag = VM_FLOAT;
+  column.floats = rows;
+  set.columns.push_back( column );
+  set.rows = rows.size();
+  return true;
+} // Columns::AddFloat()
+
+size_t Columns::Rows( ) const {
+  return mState -> set.rows;
+} // Columns::Rows()
+
+interp::Program::Program( ) {
+} // Program::Program()
+
+bool interp::Program::Ok( ) const {
+  return mState != NULL && mState -> program != NULL;
+} // Program::Ok()
+
+vector< string > interp::Program::Errors( ) const {
+  if ( mState == NULL )
+    return vector< string >( 1, "Not compiled" );
+  return mState -> errors;
+} // Program::Errors()
+
+Value interp::Program::Run( Context &ctx ) const {
+  if ( ! Ok() )
+    return Value();
+
+  ContextState *state = ctx.mState.get();
+  if ( find( state -> programs.begin(), state -> programs.end(), mState ) == state -> programs.end() )
+    state -> programs.push_back( mState );
+
+  ostream *savedOut = gOut;
+  InputReader *savedIn = gIn;
+  RunHeap *savedHeap = gRunHeap;
+  gOut = &state -> out;
+  gIn = NULL;
+  gRunHeap = &state -> heap;
+  Value result = GValueOf( mState -> program -> Eval( &state -> globals ) );
+  gOut = savedOut;
+  gIn = savedIn;
+  gRunHeap = savedHeap;
+  GSweep( state );
+  return result;
+} // Program::Run()
+
+std::vector< Value > interp::Program::Evaluate( Context &ctx, const Columns &columns ) const {
+  vector< Value > results( columns.Rows() );
+  if ( ! Ok() )
+    return results;
+
+  ContextState *state = ctx.mState.get();
+  if ( find( state -> programs.begin(), state -> programs.end(), mState ) == state -> programs.end() )
+    state -> programs.push_back( mState );
+
+  vector< VmValue > values;
+  vector< char > ok;
+  ostream *savedOut = gOut;
+  InputReader *savedIn = gIn;
+  RunHeap *savedHeap = gRunHeap;
+  gOut = &state -> out;
+  gIn = NULL;
+  gRunHeap = &state -> heap;
+  GEvalColumns( mState -> program, &state -> globals, columns.mState -> set, 
+                &values, &ok, state -> out );
+  gOut = savedOut;
+  gIn = savedIn;
+  gRunHeap = savedHeap;
+  GSweep( state );
+
+  for ( size_t r = 0; r < values.size(); ++r ) {
+    if ( ! ok[ r ] )
+      continue;
+    if ( values[ r ].tag == VM_INT )
+      results[ r ] = Value( values[ r ].i );
+    else if ( values[ r ].tag == VM_FLOAT )
+      results[ r ] = Value( ( double ) values[ r ].f );
+    else
+      results[ r ] = Value( values[ r ].i != 0 );
   } // for
 
-  // Skip )
-  Pop();
-  NextToken();
+  return results;
+} // Program::Evaluate()
+
+// Programs compiled from the same source and globals share one AST
+interp::Program Compile( const string &source, const vector< string > &globals ) {
+  vector< string > names( globals );
+  sort( names.begin(), names.end() );
+  names.erase( unique( names.begin(), names.end() ), names.end() );
+
+  interp::Program compiled;
+  compiled.mState = make_shared< ProgramState >();
+  compiled.mState -> parsed = GProgramCache().Get( source, names, &compiled.mState -> errors );
+  if ( compiled.mState -> parsed == NULL ) {
+    compiled.mState -> program = NULL;
+    if ( compiled.mState -> errors.empty() )
+      compiled.mState -> errors.push_back( "Syntax error\n" );
+  } // if
+  else
+    compiled.mState -> program = compiled.mState -> parsed -> program;
+
+  return compiled;
+} // Compile()
+
+// The globals of snapshot are reserved as well, so scripts can use what a
+// prelude defined
+interp::Program Compile( const string &source, const Snapshot &snapshot,
+                         const vector< string > &globals ) {
+  vector< string > names( globals );
+  if ( snapshot.mState != NULL && snapshot.mState -> globals.vars != NULL ) {
+    const VarMap &vars = *snapshot.mState -> globals.vars;
+    for ( VarMap::const_iterator it = vars.begin(); it != vars.end(); ++it )
+      names.push_back( it -> first );
+  } // if
 
-  BlockStatement* bstmt = NULL;
-  bstmt = ParseBlockStatement( innerEnv );
-  if ( bstmt == NULL )
-    return NULL;
+  return Compile( source, names );
+} // Compile()
+
+} // namespace interp
+
+namespace interp {
+namespace detail {
+
+// ---------------------------- Script generator -------------------
+// Shape of a script written by --gen-script
+struct ScriptShape {
+  int statements;
+  int depth; // Binary operators per expression
+  int idents; // Numeric variables, and as many strings when they are used
+  int intWeight; // Literal mix, relative weights
+  int floatWeight;
+  int stringWeight;
+  int comments; // Percent of statements with a trailing comment
+  unsigned int seed;
+
+  ScriptShape( ) {
+    statements = 1000;
+    depth = 4;
+    idents = 16;
+    intWeight = 4;
+    floatWeight = 2;
+    stringWeight = 1;
+    comments = 10;
+    seed = 1;
+  } // ScriptShape()
+};
 
-  Token *end = Pop();
-  if ( !Expect( end, RBRACE ) ) 
-    return NULL;
+// xorshift32, so a seed gives the same script everywhere
+unsigned int GNextRandom( unsigned int &state ) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+} // GNextRandom()
 
-  funcRes -> SetEnv( innerEnv ); 
-  funcRes -> SetBlock( bstmt );
-  return funcRes;
-} // Parser::ParseFunction 
+// A numeric operand : a variable, or an int or float literal by the mix
+string GGenOperand( const ScriptShape &shape, unsigned int &rnd ) {
+  stringstream ss;
+  int pick = GNextRandom( rnd ) % ( shape.intWeight + shape.floatWeight + 2 );
+  if ( pick < 2 )
+    ss << "v" << GNextRandom( rnd ) % shape.idents;
+  else if ( pick < 2 + shape.intWeight )
+    ss << GNextRandom( rnd ) % 1000;
+  else
+    ss << GNextRandom( rnd ) % 100 << "." << GNextRandom( rnd ) % 100;
+  return ss.str();
+} // GGenOperand()
+
+// Division and modulo only take literal divisors, so no run divides by 0.
+// A modulo is parenthesized as % binds looser than * and / here.
+string GGenExpr( const ScriptShape &shape, unsigned int &rnd ) {
+  string expr = GGenOperand( shape, rnd );
+  for ( int i = 0; i < shape.depth; ++i ) {
+    stringstream ss;
+    switch ( GNextRandom( rnd ) % 5 ) {
+      case 0 : ss << "( " << expr << " + " << GGenOperand( shape, rnd ) << " )"; break;
+      case 1 : ss << "( " << expr << " - " << GGenOperand( shape, rnd ) << " )"; break;
+      case 2 : ss << expr << " * " << GGenOperand( shape, rnd ); break;
+      case 3 : ss << expr << " / " << GNextRandom( rnd ) % 9 + 1; break;
+      default : ss << "( ( " << expr << " ) % " << GNextRandom( rnd ) % 97 + 1 << " )";
+    } // switch
+
+    expr = ss.str();
+  } // for
 
-Statement *Parser::ParseAssignStmt( Environment *env ) {
-  DeclarationStatement *stmt = NULL;
-  Token *type = Pop();
-  stmt = new DeclarationStatement( type );
+  return expr;
+} // GGenExpr()
+
+void GGenerateScript( const ScriptShape &shape, ostream &out ) {
+  unsigned int rnd = shape.seed == 0 ? 1 : shape.seed;
+  out << "// Generated : " << shape.statements << " statements, depth "
+      << shape.depth << ", " << shape.idents << " identifiers\n";
+  for ( int i = 0; i < shape.idents; ++i ) {
+    out << ( i % 16 == 0 ? "int " : ", " ) << "v" << i;
+    if ( i % 16 == 15 || i + 1 == shape.idents )
+      out << ";\n";
+  } // for
 
-  NextToken();
-  if ( !Expect( mToks[0], IDENT ) ) 
-    return stmt;
-  Token *id = Pop();
-  stmt -> Append( id ); 
+  for ( int i = 0; shape.stringWeight > 0 && i < shape.idents; ++i ) {
+    out << ( i % 16 == 0 ? "string " : ", " ) << "s" << i;
+    if ( i % 16 == 15 || i + 1 == shape.idents )
+      out << ";\n";
+  } // for
 
-  NextToken();
-  while ( !CurrentTokenIs( SEMICOLON ) ) {
-    if ( !Expect( mToks[0], COMMA ) )
-      return NULL;
-    Pop();
-    NextToken(); 
+  int weights = shape.intWeight + shape.floatWeight + shape.stringWeight;
+  for ( int i = 0; i < shape.statements; ++i ) {
+    if ( ( int ) ( GNextRandom( rnd ) % weights ) < shape.stringWeight ) {
+      unsigned int id = GNextRandom( rnd ) % shape.idents;
+      out << "s" << id << " = s" << id << " + \"t" << i << "\";";
+    } // if
+    else
+      out << "v" << GNextRandom( rnd ) % shape.idents << " = " 
+          << GGenExpr( shape, rnd ) << ";";
 
-    if ( !Expect( mToks[0], IDENT ) )
-      return NULL;
-    id = Pop();
-    stmt -> Append( id ); 
-    NextToken();
-  } // while
+    if ( ( int ) ( GNextRandom( rnd ) % 100 ) < shape.comments )
+      out << " // statement " << i;
+    out << "\n";
+  } // for
+} // GGenerateScript()
+
+// parser --gen-script [--statements N] [--depth N] [--idents N]
+//                     [--mix INT:FLOAT:STRING] [--comments PERCENT]
+//                     [--seed N] [-o path]
+int GGenScript( int argc, char **argv ) {
+  ScriptShape shape;
+  const char *path = NULL;
+  for ( int i = 0; i < argc ; i += 2 ) {
+    if ( i + 1 >= argc ) {
+      cerr << "Missing value for " << argv[ i ] << endl;
+      return 2;
+    } // if
 
-  Token* end = Pop();
-  if ( !Expect( end, SEMICOLON ) ) 
-    return NULL;
+    const char *value = argv[ i + 1 ];
+    if ( strcmp( argv[ i ], "--statements" ) == 0 )
+      shape.statements = atoi( value );
+    else if ( strcmp( argv[ i ], "--depth" ) == 0 )
+      shape.depth = atoi( value );
+    else if ( strcmp( argv[ i ], "--idents" ) == 0 )
+      shape.idents = atoi( value );
+    else if ( strcmp( argv[ i ], "--mix" ) == 0 )
+      sscanf( value, "%d:%d:%d", &shape.intWeight, &shape.floatWeight, &shape.stringWeight );
+    else if ( strcmp( argv[ i ], "--comments" ) == 0 )
+      shape.comments = atoi( value );
+    else if ( strcmp( argv[ i ], "--seed" ) == 0 )
+      shape.seed = strtoul( value, NULL, 10 );
+    else if ( strcmp( argv[ i ], "-o" ) == 0 )
+      path = value;
+    else {
+      cerr << "Unknown option " << argv[ i ] << endl;
+      return 2;
+    } // else
+  } // for
 
-  return stmt;
-} // Parser::ParseAssignStmt()
+  if ( shape.idents < 1 || shape.depth < 0 || shape.intWeight < 0 || 
+       shape.floatWeight < 0 || shape.stringWeight < 0 || 
+       shape.intWeight + shape.floatWeight + shape.stringWeight == 0 ) {
+    cerr << "Invalid script shape" << endl;
+    return 2;
+  } // if
 
-Expression* Parser::ParseCoutExpr( Environment *env ) { 
-  CoutExpr* ccout = new CoutExpr(); 
-  Pop(); // skip cout 
-  NextToken(); 
-  Token *shift =  Pop();
-  if ( !Expect( shift, LEFT_SHIFT ) )
-    return NULL; 
+  if ( path == NULL ) {
+    GGenerateScript( shape, cout );
+    return 0;
+  } // if
 
-  NextToken();
-  Expression *expr = ParseExpression( LOWEST, env, true );
-  if ( expr == NULL ) 
-    return NULL;
+  ofstream file( path, ios::out | ios::trunc );
+  GGenerateScript( shape, file );
+  if ( ! file ) {
+    cerr << "Cannot write " << path << endl;
+    return 1;
+  } // if
 
-  ccout -> Append( expr );
-  while ( CurrentTokenIs( LEFT_SHIFT ) ) {
-    Pop();
-    NextToken();
-    expr = ParseExpression( LOWEST, env, true );
-    if ( expr == NULL ) 
-      return NULL;
+  return 0;
+} // GGenScript()
 
-    ccout -> Append( expr );
+// ---------------------------- Benchmarks -------------------
+// Swallows the output of the programs being timed. Buffered, so the
+// formatting still costs what it does in a normal run.
+class NullBuf : public streambuf {
+  char mBuf[ 4096 ];
+
+public:
+  NullBuf( ) {
+    setp( mBuf, mBuf + sizeof( mBuf ) );
+  } // NullBuf()
+
+protected:
+  int overflow( int ch ) {
+    setp( mBuf, mBuf + sizeof( mBuf ) );
+    return ch == EOF ? 0 : ch;
+  } // overflow()
+};
+
+// Front end only : lex source line by line, the way Parser::Init feeds
+// the lexer. Returns the tokens read.
+long GBenchLex( const string &source ) {
+  AstPool pool;
+  gAstPool = &pool;
+  long tokens = 0;
+  size_t start = 0;
+  while ( start < source.size() ) {
+    size_t end = source.find( '\n', start );
+    if ( end == string::npos )
+      end = source.size();
+
+    Lexer lexer( source.substr( start, end - start ) );
+    for ( Token *tok = lexer.ReadNextToken( ) ; tok -> type != EOFF ; tok = lexer.ReadNextToken( ) )
+      ++tokens;
+    start = end + 1;
   } // while
 
-  return ccout;
-} // Parser::ParseCoutExpr()
+  gAstPool = NULL;
+  return tokens;
+} // GBenchLex()
+
+// Front end only : parse source without evaluating it. Returns the
+// statements parsed, -1 if it does not parse.
+long GBenchParse( const string &source ) {
+  AstPool pool;
+  gAstPool = &pool;
+  istringstream text( source );
+  Parser parser( &text );
+  Environment scope;
+  Program *program = parser.ParseScript( &scope );
+  gAstPool = NULL;
+  return program == NULL ? -1 : program -> mBody.size();
+} // GBenchParse()
+
+// One run of a workload : parse it, then evaluate it on a fresh global
+// environment. Returns the statements run, -1 if it does not parse.
+long GBenchRun( const string &source ) {
+  AstPool pool;
+  gAstPool = &pool;
+  istringstream text( source );
+  Parser parser( &text );
+  Environment scope;
+  Program *program = parser.ParseScript( &scope );
+  gAstPool = NULL;
+  if ( program == NULL )
+    return -1;
+
+  Environment env;
+  program -> Eval( &env );
+  return program -> mBody.size();
+} // GBenchRun()
+
+// parser --bench[=lex|=parse] [--warmup N] [--trials N] script ...
+// Prints a JSON line per script : wall time of a run ( median, p99 ),
+// ops per second, and allocations per op when built with COUNT_ALLOCS
+// ( the parser_bench target ). An op is a top level statement run, a
+// token lexed for =lex, and a statement parsed for =parse.
+int GBench( const char *phase, long ( *run )( const string &source ), 
+            int argc, char **argv ) {
+  int warmup = 3;
+  int trials = 20;
+  int i = 0;
+  for ( ; i + 1 < argc && strncmp( argv[ i ], "--", 2 ) == 0 ; i += 2 ) {
+    if ( strcmp( argv[ i ], "--warmup" ) == 0 )
+      warmup = atoi( argv[ i + 1 ] );
+    else if ( strcmp( argv[ i ], "--trials" ) == 0 )
+      trials = atoi( argv[ i + 1 ] );
+    else
+      break;
+  } // for
 
+  if ( i >= argc || trials < 1 ) {
+    cerr << "Usage : parser --bench[=lex|=parse] [--warmup N] [--trials N] script ..." << endl;
+    return 2;
+  } // if
 
-Statement *Parser::ParseLetStmt( Environment *env ) {
-  DeclarationStatement *stmt = NULL;
-  Token *type = Pop();
-  stmt = new DeclarationStatement( type );
+  int status = 0;
+  for ( ; i < argc ; ++i ) {
+    MappedFile file( argv[ i ] );
+    if ( ! file.Ok() ) {
+      cerr << "Cannot open " << argv[ i ] << endl;
+      status = 1;
+      continue;
+    } // if
 
-  NextToken();
-  if ( !Expect( mToks[0], IDENT ) ) 
-    return stmt;
-  Token *id = Pop();
-  NextToken();
+    string source( file.Data(), file.Size() );
+    NullBuf sink;
+    ostream silent( &sink );
+    ostream *saved = gOut;
+    gOut = &silent;
+    long ops = 0;
+    for ( int n = 0; n < warmup && ops >= 0 ; ++n )
+      ops = run( source );
+
+    vector< double > times;
+# ifdef COUNT_ALLOCS
+    size_t allocs = 0;
+# endif
+    for ( int n = 0; n < trials && ops >= 0 ; ++n ) {
+# ifdef COUNT_ALLOCS
+      size_t before = gAllocs;
+# endif
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      ops = run( source );
+      chrono::duration< double > took = chrono::steady_clock::now() - start;
+      times.push_back( took.count() );
+# ifdef COUNT_ALLOCS
+      allocs += gAllocs - before;
+# endif
+    } // for
+
+    gOut = saved;
+    if ( ops < 0 ) {
+      cerr << "Cannot parse " << argv[ i ] << endl;
+      status = 1;
+      continue;
+    } // if
 
-  // [ is encounterd ;
-  if ( CurrentTokenIs( LBRACKET ) ) { 
-    Pop();
-    NextToken();
-    Expression *expr = ParseExpression( LOWEST, env, false );
-    Token *end = Pop();
-    if ( !Expect( end, RBRACKET ) )
-      return NULL;
-    DeclareArrayExpression *arr = new DeclareArrayExpression( id, id -> value, expr );
-    stmt -> AppendArr( arr );
-  } // if
-  else 
-    stmt -> Append( id ); 
-  
-  NextToken();
-  if ( CurrentTokenIs( LPAREN ) ) {
-    SymbolExpression *ident = new SymbolExpression( id, id -> value );
-    FunctionDeclaration *func = new FunctionDeclaration( type, ident );
-    func = ParseFunction(env, func);
-    return func;
-  } // if
+    sort( times.begin(), times.end() );
+    double median = times[ times.size() / 2 ];
+    double p99 = times[ ( times.size() * 99 + 99 ) / 100 - 1 ];
+    Json line;
+    line[ "bench" ] = argv[ i ];
+    line[ "phase" ] = phase;
+    line[ "trials" ] = trials;
+    line[ "ops" ] = ops;
+    line[ "median_ms" ] = median * 1e3;
+    line[ "p99_ms" ] = p99 * 1e3;
+    line[ "ops_per_sec" ] = median > 0 ? ops / median : 0;
+# ifdef COUNT_ALLOCS
+    line[ "allocs_per_op" ] = ops > 0 ? ( double ) allocs / trials / ops : 0;
+# else
+    line[ "allocs_per_op" ] = NULL;
+# endif
+    cout << line.dump() << endl;
+  } // for
 
-  while ( !CurrentTokenIs( SEMICOLON ) ) {
-    if ( !Expect( mToks[0], COMMA ) )
-      return NULL;
-    Pop();
-    NextToken(); 
+  return status;
+} // GBench()
+
+// Run program the way the options of main ask for
+void GRunMode( Program *program, Environment *env, bool eachLine, 
+               const ColumnSet *columns, int threads ) {
+  if ( eachLine )
+    GRunEachLine( program, env );
+  else if ( columns != NULL ) {
+    vector< VmValue > values;
+    vector< char > ok;
+    GEvalColumns( program, env, *columns, &values, &ok, cerr );
+    GPrintColumnResults( values, ok );
+  } // else if
+  else
+    GEvalProgram( program, env, threads );
 
-    if ( !Expect( mToks[0], IDENT ) )
-      return NULL;
-    id = Pop();
-    NextToken();
+  if ( gCheckBodies )
+    GCheckBodies( program, env );
+} // GRunMode()
 
-    // [ is encounterd ;
-    if ( CurrentTokenIs( LBRACKET ) ) { 
-      Pop();
-      NextToken();
-      Expression *expr = ParseExpression( LOWEST, env, false );
-      Token *end = Pop();
-      if ( !Expect( end, RBRACKET ) )
-        return NULL;
-      DeclareArrayExpression *arr = new DeclareArrayExpression( id, id -> value, expr );
-      stmt -> AppendArr( arr );
+} // namespace detail
+} // namespace interp
+
+// --------------- Main --------------------------
+// The libraries are built with INTERP_NO_MAIN
+# ifndef INTERP_NO_MAIN
+// parser                                   : interactive session on stdin
+// parser --compile script -o image         : write the AST image of script
+// parser --dump-ast=json script            : print the AST of script
+// parser --load-ast=json file ...          : run JSON ASTs
+// parser --bench [options] script ...      : time scripts, see GBench
+// parser --gen-script [options]            : write a synthetic script,
+//                                            see GGenScript
+// parser [--cache-limit BYTES] [--profile[=FOLDED]] [--stats|--no-stats]
+//        [--sample[=USEC]] [--jobs N | --parallel N] [--prelude FILE]
+//        [--output-buffer BYTES] [--each-line | --columns DATA] [--no-vm]
+//        [--check-bodies] file ...
+//                                          : run each file, AST images are
+//                                            decoded, scripts go through
+//                                            the program cache. --profile
+//                                            reports where the time went
+//                                            and can write folded stacks,
+//                                            --stats prints the counters,
+//                                            --sample the hottest
+//                                            statements. --jobs runs the
+//                                            files in parallel, each in
+//                                            its own Interpreter, --parallel
+//                                            the independent statements of
+//                                            each file. --prelude runs once
+//                                            and every file starts from a
+//                                            copy of its globals. Output is
+//                                            written in blocks of
+//                                            --output-buffer bytes. cin
+//                                            reads stdin, except under
+//                                            --jobs where scripts have no
+//                                            input. --each-line parses its
+//                                            one script once and runs it
+//                                            for every line of stdin, in
+//                                            line and lineno. --columns
+//                                            prints the last statement of
+//                                            its script for every row of
+//                                            DATA ( CSV or binary, see
+//                                            GLoadColumns ). --no-vm runs
+//                                            every expression on the tree
+//                                            walker. With no file
+//                                            --no-vm, --output-buffer and
+//                                            the reports apply to the
+//                                            interactive session, the
+//                                            other options are rejected.
+//                                            Function bodies are
+//                                            parsed on their first call,
+//                                            the exit status is 1 when one
+//                                            does not parse. --check-bodies
+//                                            also parses the bodies no
+//                                            call needed once the file ran
+using namespace interp::detail;
+
+// The --profile, --sample and --stats reports once the run ends, status
+// becomes 1 if the folded stacks can not be written
+int GReportAtExit( const char *folded, long sample, bool stats, int status ) {
+  if ( gProfiler != NULL ) {
+    gProfiler -> Report( cerr );
+    if ( folded != NULL && ! gProfiler -> WriteFolded( folded ) ) {
+      cerr << "Cannot write " << folded << endl;
+      status = 1;
     } // if
+  } // if
 
-    else 
-      stmt -> Append( id );
+  if ( sample > 0 ) {
+    GStopSampling();
+    GSampleReport( cerr );
+  } // if
 
-    NextToken();
-  } // while
+  if ( stats )
+    gStats.Print( cerr );
+  return status;
+} // GReportAtExit()
+
+int main( int argc, char **argv ) {
+  GFlushOnFatalSignals();
+  cerr.tie( &gStdoutTie );
+  if ( argc < 2 ) {
+    Parser *parser = new Parser( ) ;
+    parser->ParseProgram( ) ;
+    return 0;
+  } // if
 
-  Token* end = Pop();
-  if ( !Expect( end, SEMICOLON ) ) 
-    return NULL;
+  if ( strcmp( argv[ 1 ], "--compile" ) == 0 ) {
+    if ( argc != 5 || strcmp( argv[ 3 ], "-o" ) != 0 ) {
+      cerr << "Usage : " << argv[ 0 ] << " --compile script -o image" << endl;
+      return 2;
+    } // if
 
-  return stmt;
-} // Parser::ParseLetStmt()
+    return GCompile( argv[ 2 ], argv[ 4 ] );
+  } // if
 
-Statement *Parser::ParseStatement( Environment *env ) {
-  Statement* stmt = NULL;
+  if ( strcmp( argv[ 1 ], "--dump-ast=json" ) == 0 ) {
+    if ( argc != 3 ) {
+      cerr << "Usage : " << argv[ 0 ] << " --dump-ast=json script" << endl;
+      return 2;
+    } // if
 
-  if ( mToks[0] -> type == KEY_STRING || mToks[0] -> type == KEY_VOID ||
-            mToks[0] -> type == KEY_INT || mToks[0] -> type == KEY_FLOAT || 
-            mToks[0] -> type == KEY_BOOL || mToks[0] -> type == KEY_CHAR )
-    stmt = ParseLetStmt( env );
+    return GDumpJson( argv[ 2 ] );
+  } // if
 
-  else if ( mToks[0] -> type == KEY_RETURN )
-    stmt = ParseReturnStmt( env );
+  if ( strcmp( argv[ 1 ], "--load-ast=json" ) == 0 )
+    return GRunJson( argc - 2, argv + 2 );
+
+  if ( strcmp( argv[ 1 ], "--bench" ) == 0 )
+    return GBench( "run", GBenchRun, argc - 2, argv + 2 );
+
+  if ( strcmp( argv[ 1 ], "--bench=lex" ) == 0 )
+    return GBench( "lex", GBenchLex, argc - 2, argv + 2 );
+
+  if ( strcmp( argv[ 1 ], "--bench=parse" ) == 0 )
+    return GBench( "parse", GBenchParse, argc - 2, argv + 2 );
+
+  if ( strcmp( argv[ 1 ], "--gen-script" ) == 0 )
+    return GGenScript( argc - 2, argv + 2 );
+
+  size_t limit = kCacheLimit;
+  size_t outputBuffer = kOutputThreshold;
+  const char *folded = NULL;
+  bool stats = false;
+  long sample = 0; // Sampling interval in microseconds, 0 : off
+  int jobs = 0; // 0 : run in order on this thread
+  int threads = 1; // Workers for the statements of one program
+  const char *preludePath = NULL;
+  bool eachLine = false;
+  const char *columnsPath = NULL;
+  int i = 1;
+  for ( ; i < argc && strncmp( argv[ i ], "--", 2 ) == 0 ; ++i ) {
+    if ( strcmp( argv[ i ], "--cache-limit" ) == 0 && i + 1 < argc )
+      limit = strtoull( argv[ ++i ], NULL, 10 );
+    else if ( strcmp( argv[ i ], "--profile" ) == 0 )
+      gProfiler = new Profiler();
+    else if ( strncmp( argv[ i ], "--profile=", 10 ) == 0 ) {
+      gProfiler = new Profiler();
+      folded = argv[ i ] + 10;
+    } // else if
+    else if ( strcmp( argv[ i ], "--stats" ) == 0 )
+      stats = true;
+    else if ( strcmp( argv[ i ], "--no-stats" ) == 0 )
+      gStatsEnabled = false;
+    else if ( strcmp( argv[ i ], "--sample" ) == 0 )
+      sample = 1000;
+    else if ( strncmp( argv[ i ], "--sample=", 9 ) == 0 && atol( argv[ i ] + 9 ) > 0 )
+      sample = atol( argv[ i ] + 9 );
+    else if ( strcmp( argv[ i ], "--jobs" ) == 0 && i + 1 < argc && atoi( argv[ i + 1 ] ) > 0 )
+      jobs = atoi( argv[ ++i ] );
+    else if ( strcmp( argv[ i ], "--parallel" ) == 0 && i + 1 < argc && atoi( argv[ i + 1 ] ) > 0 )
+      threads = atoi( argv[ ++i ] );
+    else if ( strcmp( argv[ i ], "--prelude" ) == 0 && i + 1 < argc )
+      preludePath = argv[ ++i ];
+    else if ( strcmp( argv[ i ], "--output-buffer" ) == 0 && i + 1 < argc )
+      outputBuffer = strtoull( argv[ ++i ], NULL, 10 );
+    else if ( strcmp( argv[ i ], "--each-line" ) == 0 )
+      eachLine = true;
+    else if ( strcmp( argv[ i ], "--columns" ) == 0 && i + 1 < argc )
+      columnsPath = argv[ ++i ];
+    else if ( strcmp( argv[ i ], "--no-vm" ) == 0 )
+      gUseVm = false;
+    else if ( strcmp( argv[ i ], "--check-bodies" ) == 0 )
+      gCheckBodies = true;
+    else {
+      cerr << "Unknown option " << argv[ i ] << endl;
+      return 2;
+    } // else
+  } // for
 
-  else if ( mToks[0] -> type == LBRACE )
-    stmt = ParseBlockStatement( env );
-  
-  else
-    stmt = ParseExpressionStmt( env );
+  gStdoutSink.SetThreshold( outputBuffer );
 
-  if ( stmt == NULL )
-    return NULL;
+  // Options alone, the interactive session runs with them and reports
+  // as a run of files does. The options for files have nothing to run on
+  if ( i == argc && ( jobs > 0 || threads > 1 || preludePath != NULL || eachLine ||
+                      columnsPath != NULL || gCheckBodies ) ) {
+    cerr << "--jobs, --parallel, --prelude, --each-line, --columns and "
+         << "--check-bodies need a file" << endl;
+    return 2;
+  } // if
 
-  return stmt;
-} // Parser::ParseStatement()
+  if ( i == argc ) {
+    if ( sample > 0 && ! GStartSampling( sample ) ) {
+      cerr << "Cannot start the sampling timer" << endl;
+      return 1;
+    } // if
 
-Statement* Parser::ParseCompound( Environment *env ) {
-  Statement* stmt = NULL;
-  if ( mToks[0] -> type == KEY_STRING ||  mToks[0] -> type == KEY_INT || 
-       mToks[0] -> type == KEY_FLOAT || mToks[0] -> type == KEY_BOOL || mToks[0] -> type == KEY_CHAR )
-    stmt = ParseAssignStmt( env );
+    Parser *parser = new Parser( ) ;
+    parser->ParseProgram( ) ;
+    return GReportAtExit( folded, sample, stats, 0 );
+  } // if
 
-  else if ( mToks[0] -> type == KEY_RETURN )
-    stmt = ParseReturnStmt( env );
+  // The profilers follow a single thread
+  if ( ( jobs > 0 || threads > 1 ) && ( gProfiler != NULL || sample > 0 ) ) {
+    cerr << "--profile and --sample need a run without --jobs or --parallel" << endl;
+    return 2;
+  } // if
 
-  else
-    stmt = ParseExpressionStmt( env );
+  if ( jobs > 0 && threads > 1 ) {
+    cerr << "--jobs and --parallel do not mix" << endl;
+    return 2;
+  } // if
 
-  if ( stmt == NULL )
-    return NULL;
+  if ( eachLine && ( jobs > 0 || threads > 1 || argc - i != 1 ) ) {
+    cerr << "--each-line runs one script, without --jobs or --parallel" << endl;
+    return 2;
+  } // if
 
-  return stmt;
-} // Parser::ParseCompound()
+  if ( columnsPath != NULL && ( jobs > 0 || threads > 1 || eachLine || argc - i != 1 ) ) {
+    cerr << "--columns runs one script, without --jobs, --parallel or --each-line" << endl;
+    return 2;
+  } // if
 
-Program *Parser::ParseProgram( ) {
-  // Needed object
-  Program *program = new Program( ) ;
-  Obj *obj = NULL;
-  Environment *env = new Environment( ) ;
-  // Input string
-  string input = "";
-  input = GetLine( ) ; 
+  ColumnSet columns;
+  if ( columnsPath != NULL ) {
+    MappedFile file( columnsPath );
+    string error;
+    if ( ! file.Ok() || ! GLoadColumns( file.Data(), file.Size(), &columns, error ) ) {
+      cerr << "Cannot load " << columnsPath << ( error.empty() ? "" : " : " ) << error << endl;
+      return 1;
+    } // if
+  } // if
 
-  cout << "Program starts..." << endl;
-  cout << "> ";
+  // Every file starts from a fork of the globals the prelude left, the
+  // functions it declares live in preludePool
+  AstPool preludePool;
+  Environment prelude;
+  EnvSnapshot snapshot;
+  if ( preludePath != NULL ) {
+    if ( ! GRunPrelude( preludePath, &preludePool, &prelude ) )
+      return 1;
+    snapshot = prelude.Snapshot();
+  } // if
 
-  Init( ) ;
-  while ( mCurToken->value != "quit" ) {
+  if ( jobs > 0 ) {
+    int status = GRunBatch( jobs, argc - i, argv + i, 
+                            preludePath != NULL ? &snapshot : NULL );
+    if ( stats )
+      gStats.Print( cerr );
+    return gBodyFailed ? max( status, 1 ) : status;
+  } // if
 
-    while ( mCurToken-> type != EOFF  && mCurToken -> value != "quit" ) {
-      Statement *stmt = ParseStatement( env );
-      if ( stmt != NULL ) {
-        // stmt -> Print();
-        program -> Append( stmt );
-        obj = program -> Eval( env );
-        if ( obj == NULL )
-          Reset();
+  if ( sample > 0 && ! GStartSampling( sample ) ) {
+    cerr << "Cannot start the sampling timer" << endl;
+    return 1;
+  } // if
 
-        mCurToken = mLexer -> ReadNextToken();
-        if ( mCurToken -> type != EOFF )
-          mToks.push_back( mCurToken ); 
+  GProgramCache().SetLimit( limit );
+  int status = 0;
+  for ( ; i < argc ; ++i ) {
+    MappedFile file( argv[ i ] );
+    if ( ! file.Ok() ) {
+      cerr << "Cannot open " << argv[ i ] << endl;
+      status = 1;
+      continue;
+    } // if
+
+    if ( BinaryAstReader::IsImage( file.Data(), file.Size() ) ) {
+      AstPool pool;
+      gAstPool = &pool;
+      Program *program = GLoadImage( file.Data(), file.Size() );
+      gAstPool = NULL;
+      if ( program == NULL ) {
+        cerr << "Invalid AST image " << argv[ i ] << endl;
+        status = 1;
+        continue;
       } // if
 
-      else {
-        if ( mErrs.size() > 0 )
-          cout << mErrs[0];
-        Reset();
-      } // else 
+      Environment env( snapshot );
+      GRunMode( program, &env, eachLine, columnsPath != NULL ? &columns : NULL, threads );
+      continue;
+    } // if
 
-      cout << "> ";
-    } // while
-    
-    if ( mCurToken -> value != "quit" ) 
-      Init( );
-  } // while
+    // The script is parsed knowing the names --each-line and --columns bind
+    Environment env( snapshot );
+    if ( eachLine ) {
+      env.Set( "line", new String( "String", "" ) );
+      env.Set( "lineno", new Integer( 0, "Integer" ) );
+    } // if
 
-  cout << "Program exits..." << endl; 
-  return program;
-} // Parser::ParseProgram()
+    for ( size_t c = 0; c < columns.columns.size(); ++c ) {
+      if ( columns.columns[ c ].tag == VM_INT )
+        env.Set( columns.columns[ c ].name, new Integer( 0, "Integer" ) );
+      else
+        env.Set( columns.columns[ c ].name, new Float( 0, "Float" ) );
+    } // for
+
+    vector< string > errors;
+    ProgramRef program = GProgramCache().Get( string( file.Data(), file.Size() ), 
+                                              env.Names(), &errors );
+    if ( program == NULL ) {
+      if ( ! errors.empty() )
+        *gOut << errors[ 0 ];
+      status = 1;
+      continue;
+    } // if
 
-// --------------- Main --------------------------
-int main( ) {
-  Parser *parser = new Parser( ) ;
-  Program *program = parser->ParseProgram( ) ;
+    GRunMode( program -> program, &env, eachLine, columnsPath != NULL ? &columns : NULL, threads );
+  } // for
+
+  status = GReportAtExit( folded, sample, stats, status );
+  return gBodyFailed ? 1 : status;
 } // main()
+# endif
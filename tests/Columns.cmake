@@ -0,0 +1,23 @@
+# The values the tree walker makes for the rows of --columns are swept
+# without losing the globals : PARSER runs SCRIPT over ROWS generated
+# rows a,b in WORK, row n has to give n + 3 + n % 7.
+set(input ${WORK}/columns_sweep.csv)
+set(rows "a,b\n")
+set(expected "")
+foreach(n RANGE 1 ${ROWS})
+  math(EXPR b "${n} % 7")
+  math(EXPR value "${n} + 3 + ${b}")
+  string(APPEND rows "${n},${b}\n")
+  string(APPEND expected "${value}\n")
+endforeach()
+file(WRITE ${input} "${rows}")
+
+execute_process(COMMAND ${PARSER} --columns ${input} ${SCRIPT}
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE status)
+if(NOT status STREQUAL "0")
+  message(FATAL_ERROR "--columns over ${ROWS} rows gave ${status}")
+endif()
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "--columns over ${ROWS} rows lost the globals")
+endif()
@@ -0,0 +1,37 @@
+# Damaged ASTs are rejected, never run : PARSER compiles SCRIPT to an
+# image in WORK, then has to refuse every truncation of it with status 1.
+# The JSON form of SCRIPT with the right operands renamed away has to be
+# refused the same way.
+set(image ${WORK}/damaged_ast.img)
+set(truncated ${WORK}/damaged_ast.part)
+execute_process(COMMAND ${PARSER} --compile ${SCRIPT} -o ${image}
+  RESULT_VARIABLE status)
+if(NOT status STREQUAL "0")
+  message(FATAL_ERROR "Cannot compile ${SCRIPT}")
+endif()
+
+file(READ ${image} bytes HEX)
+string(LENGTH "${bytes}" size)
+math(EXPR last "${size} / 2 - 1")
+foreach(n RANGE 1 ${last})
+  execute_process(COMMAND head -c ${n} ${image} OUTPUT_FILE ${truncated})
+  execute_process(COMMAND ${PARSER} ${truncated}
+    OUTPUT_QUIET ERROR_QUIET RESULT_VARIABLE status)
+  if(NOT status STREQUAL "1")
+    message(FATAL_ERROR "The first ${n} bytes of the image gave ${status}")
+  endif()
+endforeach()
+
+execute_process(COMMAND ${PARSER} --dump-ast=json ${SCRIPT}
+  OUTPUT_VARIABLE json RESULT_VARIABLE status)
+if(NOT status STREQUAL "0")
+  message(FATAL_ERROR "Cannot dump ${SCRIPT}")
+endif()
+
+string(REPLACE "\"right\"" "\"missing\"" json "${json}")
+file(WRITE ${WORK}/damaged_ast.json "${json}")
+execute_process(COMMAND ${PARSER} --load-ast=json ${WORK}/damaged_ast.json
+  OUTPUT_QUIET ERROR_QUIET RESULT_VARIABLE status)
+if(NOT status STREQUAL "1")
+  message(FATAL_ERROR "A JSON AST without right operands gave ${status}")
+endif()
@@ -0,0 +1,24 @@
+# The values the globals keep survive the sweeps of --each-line : PARSER
+# runs SCRIPT with the globals of PRELUDE over LINES generated lines in
+# WORK, each line has to print the line before it.
+set(input ${WORK}/each_line_sweep.txt)
+set(lines "")
+set(expected "")
+foreach(n RANGE 1 ${LINES})
+  string(APPEND lines "${n};\n")
+  if(n LESS LINES)
+    string(APPEND expected "${n};")
+  endif()
+endforeach()
+file(WRITE ${input} "${lines}")
+
+execute_process(COMMAND ${PARSER} --prelude ${PRELUDE} --each-line ${SCRIPT}
+  INPUT_FILE ${input}
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE status)
+if(NOT status STREQUAL "0")
+  message(FATAL_ERROR "--each-line over ${LINES} lines gave ${status}")
+endif()
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "--each-line over ${LINES} lines lost the previous lines")
+endif()
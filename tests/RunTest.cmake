@@ -0,0 +1,31 @@
+# Runs one interpreter test : PARSER with the arguments ARGS ( separated
+# by | ), stdin from INPUT when it is set. What it prints on stdout has to
+# match the file EXPECTED and, when STATUS is set, its exit status too.
+# With MERGE set stderr is part of what has to match, in the order the
+# two were written.
+string(REPLACE "|" ";" args "${ARGS}")
+set(errors errors)
+if(MERGE)
+  set(errors output)
+endif()
+if(DEFINED INPUT)
+  execute_process(COMMAND ${PARSER} ${args}
+    INPUT_FILE ${INPUT}
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE ${errors}
+    RESULT_VARIABLE status)
+else()
+  execute_process(COMMAND ${PARSER} ${args}
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE ${errors}
+    RESULT_VARIABLE status)
+endif()
+
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "Output of ${args} :\n${output}\nexpected :\n${expected}")
+endif()
+
+if(DEFINED STATUS AND NOT status STREQUAL STATUS)
+  message(FATAL_ERROR "${args} exited with ${status}, expected ${STATUS}")
+endif()
@@ -0,0 +1,143 @@
+// Tests of the embedding API of include/interpreter.hpp, linked against
+// libinterp.a. Prints the checks that fail and exits with 1 if any did.
+# include <cstdio>
+# include <cstring>
+# include <string>
+# include <vector>
+
+# include "interpreter.hpp"
+
+using namespace std;
+
+int gFailures = 0;
+
+void GCheck( bool ok, const char *what, int line ) {
+  if ( ! ok ) {
+    printf( "embed.cpp:%d: failed: %s\n", line, what );
+    ++gFailures;
+  } // if
+} // GCheck()
+
+# define CHECK( expr ) GCheck( ( expr ), #expr, __LINE__ )
+
+// Resident set size in bytes, 0 if it can not be read
+size_t GResidentBytes( ) {
+  FILE *file = fopen( "/proc/self/statm", "r" );
+  if ( file == NULL )
+    return 0;
+
+  unsigned long size = 0, resident = 0;
+  if ( fscanf( file, "%lu %lu", &size, &resident ) != 2 )
+    resident = 0;
+  fclose( file );
+  return resident * 4096;
+} // GResidentBytes()
+
+// The objects and call frames of a run are freed when it ends, only what
+// the globals hold stays
+void TestRunsStayFlat( ) {
+  interp::Program program = interp::Compile(
+    "int Twice( int v ) { return v * 2 ; }\n"
+    "string s ;\n"
+    "s = \"a long string that lives on the heap\" ;\n"
+    "x = Twice( x ) - x + 1 ;\n", { "x" } );
+  CHECK( program.Ok() );
+
+  interp::Context ctx;
+  ctx.Set( "x", 0 );
+  for ( int i = 0; i < 2000; ++i )
+    program.Run( ctx );
+  CHECK( ctx.Get( "x" ).AsInt() == 2000 );
+
+  size_t before = GResidentBytes();
+  for ( int i = 0; i < 50000; ++i )
+    program.Run( ctx );
+  size_t after = GResidentBytes();
+  CHECK( ctx.Get( "x" ).AsInt() == 52000 );
+  CHECK( before > 0 && after < before + 512 * 1024 );
+} // TestRunsStayFlat()
+
+// A function from a snapshot still runs after the context it came from
+// ran again and dropped it from its own globals
+void TestSnapshotKeepsItsObjects( ) {
+  interp::Context prelude;
+  interp::Compile( "int Base( int v ) { return v + 100 ; }" ).Run( prelude );
+  interp::Snapshot ready = prelude.Freeze();
+  interp::Compile( "int Base( int v ) { return v ; }" ).Run( prelude );
+
+  interp::Context request( ready );
+  interp::Program call = interp::Compile( "r = Base( 1 ) ;", { "r", "Base" } );
+  call.Run( request );
+  CHECK( request.Get( "r" ).AsInt() == 101 );
+
+  call.Run( prelude );
+  CHECK( prelude.Get( "r" ).AsInt() == 1 );
+} // TestSnapshotKeepsItsObjects()
+
+// Names a prelude defined resolve in scripts compiled against its snapshot
+void TestCompileAgainstSnapshot( ) {
+  interp::Context prelude;
+  interp::Compile( "int base ; base = 20 ; int Add( int v ) { return v + base ; }" ).Run( prelude );
+  interp::Snapshot ready = prelude.Freeze();
+
+  CHECK( ! interp::Compile( "reply = Add( base ) ;", { "reply" } ).Ok() );
+  interp::Program handler = interp::Compile( "reply = Add( base ) ;", ready, { "reply" } );
+  CHECK( handler.Ok() );
+
+  interp::Context request( ready );
+  handler.Run( request );
+  CHECK( request.Get( "reply" ).AsInt() == 40 );
+} // TestCompileAgainstSnapshot()
+
+// Contexts forked from one snapshot keep their writes to themselves, and
+// the context that was frozen does not see them either
+void TestForksAreIsolated( ) {
+  interp::Context prelude;
+  interp::Compile( "int base ; base = 1 ;" ).Run( prelude );
+  interp::Snapshot ready = prelude.Freeze();
+  interp::Program bump = interp::Compile( "base = base + 10 ;", ready );
+
+  interp::Context first( ready ), second( ready );
+  bump.Run( first );
+  bump.Run( first );
+  bump.Run( second );
+  CHECK( first.Get( "base" ).AsInt() == 21 );
+  CHECK( second.Get( "base" ).AsInt() == 11 );
+  CHECK( prelude.Get( "base" ).AsInt() == 1 );
+
+  bump.Run( prelude );
+  CHECK( prelude.Get( "base" ).AsInt() == 11 );
+  interp::Context third( ready );
+  CHECK( third.Get( "base" ).AsInt() == 1 );
+} // TestForksAreIsolated()
+
+// One compiled call site, run in contexts whose F differs and after F
+// is redefined, calls the F of the context it runs in
+void TestCallSiteFollowsItsContext( ) {
+  interp::Program call = interp::Compile( "r = F( 1 ) ;", { "r", "F" } );
+  interp::Context one, two;
+  interp::Compile( "int F( int v ) { return v + 1 ; }", { "F" } ).Run( one );
+  interp::Compile( "int F( int v ) { return v + 2 ; }", { "F" } ).Run( two );
+
+  for ( int i = 0; i < 3; ++i ) {
+    call.Run( one );
+    CHECK( one.Get( "r" ).AsInt() == 2 );
+    call.Run( two );
+    CHECK( two.Get( "r" ).AsInt() == 3 );
+  } // for
+
+  interp::Compile( "int F( int v ) { return v + 10 ; }", { "F" } ).Run( one );
+  call.Run( one );
+  CHECK( one.Get( "r" ).AsInt() == 11 );
+  call.Run( two );
+  CHECK( two.Get( "r" ).AsInt() == 3 );
+} // TestCallSiteFollowsItsContext()
+
+int main( ) {
+  TestRunsStayFlat();
+  TestSnapshotKeepsItsObjects();
+  TestCompileAgainstSnapshot();
+  TestForksAreIsolated();
+  TestCallSiteFollowsItsContext();
+  return gFailures == 0 ? 0 : 1;
+} // main()